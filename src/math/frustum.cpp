@@ -21,6 +21,36 @@ namespace math
     _planes[FRONT] = column_3 + column_2;
   }
 
+  std::array<vector_3d, 8> frustum::corners() const
+  {
+    std::array<vector_3d, 8> result;
+    std::size_t i (0);
+
+    for (SIDES x : {LEFT, RIGHT})
+    {
+      for (SIDES y : {BOTTOM, TOP})
+      {
+        for (SIDES z : {FRONT, BACK})
+        {
+          plane const& a (_planes[x]);
+          plane const& b (_planes[y]);
+          plane const& c (_planes[z]);
+
+          // n * p + d = 0 for all three planes
+          vector_3d const bc (b.normal() % c.normal());
+          vector_3d const ca (c.normal() % a.normal());
+          vector_3d const ab (a.normal() % b.normal());
+          float const determinant (a.normal() * bc);
+
+          result[i++] = (bc * a.distance() + ca * b.distance() + ab * c.distance())
+                      * (-1.0f / determinant);
+        }
+      }
+    }
+
+    return result;
+  }
+
   bool frustum::contains (const vector_3d& point) const
   {
     for (auto const& plane : _planes)
@@ -60,6 +60,10 @@ namespace math
   public:
     frustum (matrix_4x4 const& matrix);
 
+    //! \brief The eight points where three of the planes meet, e.g. to
+    //! bound the frustum. Not finite for degenerate matrices.
+    std::array<vector_3d, 8> corners() const;
+
     bool contains (const vector_3d& point) const;
     bool intersects ( const vector_3d& v1
                     , const vector_3d& v2
@@ -32,6 +32,10 @@ namespace math
       return _origin + _direction * distance;
     }
 
+    vector_3d const& origin() const { return _origin; }
+    //! \note normalized
+    vector_3d const& direction() const { return _direction; }
+
   private:
     vector_3d _origin;
     vector_3d _direction;
@@ -2,30 +2,42 @@
 
 #include <noggit/AsyncLoader.h>
 #include <noggit/AsyncObject.h>
+#include <noggit/Log.h>
 
-#include <list>
+#include <algorithm>
+#include <exception>
 
-namespace
+AsyncLoader* AsyncLoader::getInstance()
 {
-  bool isFinished(AsyncObject* object)
-  {
-    return object->finishedLoading();
-  }
+  static AsyncLoader instance;
+  return &instance;
 }
 
 void AsyncLoader::process()
 {
-  while (true)
+  while (AsyncObject* object = nextObjectToLoad())
   {
-    AsyncObject* object = nextObjectToLoad();
-    if (object)
+    try
     {
       object->finishLoading();
     }
-    else
+    catch (std::exception const& e)
     {
-      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      LogError << "failed loading in the background: " << e.what() << std::endl;
     }
+    catch (...)
+    {
+      LogError << "failed loading in the background: unknown error" << std::endl;
+    }
+
+    // even if loading failed, so removeObject() doesn't wait forever
+    {
+      boost::mutex::scoped_lock lock(m_loadingMutex);
+      m_inProgress.erase(std::find(m_inProgress.begin(), m_inProgress.end(), object));
+      object->_loading = isQueued(object);
+    }
+
+    m_loadingFinished.notify_all();
   }
 }
 
@@ -33,34 +45,94 @@ AsyncObject* AsyncLoader::nextObjectToLoad()
 {
   boost::mutex::scoped_lock lock(m_loadingMutex);
 
-  m_objects.remove_if(isFinished);
+  while (true)
+  {
+    m_queueChanged.wait (lock, [this] { return m_stopped || !m_objects.empty(); });
+
+    if (m_stopped)
+    {
+      return nullptr;
+    }
 
-  std::list<AsyncObject*>::iterator it = m_objects.begin();
+    std::pop_heap(m_objects.begin(), m_objects.end());
+    AsyncObject* object = m_objects.back().object;
+    m_objects.pop_back();
 
-  if (it == m_objects.end())
-  {
-    return nullptr;
-  }
-  else
-  {
-    return *it;
+    // an object is claimed by taking it out of the queue while holding the
+    // lock, so no two workers can ever pick up the same one, even if it was
+    // queued more than once
+    if (isInProgress(object))
+    {
+      continue;
+    }
+    if (!object->finishedLoading())
+    {
+      m_inProgress.push_back(object);
+      return object;
+    }
+
+    object->_loading = isQueued(object);
   }
 }
 
-void AsyncLoader::addObject(AsyncObject* _pObject)
+bool AsyncLoader::isInProgress(AsyncObject* _pObject) const
 {
-  boost::mutex::scoped_lock lock(m_loadingMutex);
-  m_objects.push_back(_pObject);
+  return std::find(m_inProgress.begin(), m_inProgress.end(), _pObject) != m_inProgress.end();
+}
+
+bool AsyncLoader::isQueued(AsyncObject* _pObject) const
+{
+  return std::any_of ( m_objects.begin(), m_objects.end()
+                     , [_pObject] (queued_object const& queued)
+                       {
+                         return queued.object == _pObject;
+                       }
+                     );
+}
+
+void AsyncLoader::addObject(AsyncObject* _pObject, float priority)
+{
+  {
+    boost::mutex::scoped_lock lock(m_loadingMutex);
+    m_objects.push_back({priority, m_nextSequence++, _pObject});
+    _pObject->_loading = true;
+    std::push_heap(m_objects.begin(), m_objects.end());
+  }
+
+  // only idle workers wait for this, so waking one is enough
+  m_queueChanged.notify_one();
 }
 
 void AsyncLoader::removeObject(AsyncObject* _pObject)
 {
   boost::mutex::scoped_lock lock(m_loadingMutex);
-  m_objects.remove(_pObject);
+
+  auto const end
+    ( std::remove_if ( m_objects.begin(), m_objects.end()
+                     , [_pObject] (queued_object const& queued)
+                       {
+                         return queued.object == _pObject;
+                       }
+                     )
+    );
+
+  if (end != m_objects.end())
+  {
+    m_objects.erase(end, m_objects.end());
+    std::make_heap(m_objects.begin(), m_objects.end());
+  }
+
+  m_loadingFinished.wait (lock, [this, _pObject] { return !isInProgress(_pObject); });
+  _pObject->_loading = false;
 }
 
 void AsyncLoader::start(int _numThreads)
 {
+  {
+    boost::mutex::scoped_lock lock(m_loadingMutex);
+    m_stopped = false;
+  }
+
   for (int i = 0; i < _numThreads; ++i)
   {
     m_threads.add_thread(new boost::thread(&AsyncLoader::process, this));
@@ -75,7 +147,12 @@ AsyncLoader::~AsyncLoader()
 
 void AsyncLoader::stop()
 {
-  m_threads.interrupt_all();
+  {
+    boost::mutex::scoped_lock lock(m_loadingMutex);
+    m_stopped = true;
+  }
+
+  m_queueChanged.notify_all();
 }
 
 void AsyncLoader::join()
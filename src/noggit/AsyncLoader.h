@@ -4,28 +4,60 @@
 
 #include <boost/thread.hpp>
 
-#include <list>
+#include <cstddef>
+#include <vector>
 
 class AsyncObject;
 
 class AsyncLoader
 {
 public:
+  //! \brief the loader shared by everything that streams data in the background
+  static AsyncLoader* getInstance();
+
   ~AsyncLoader();
 
   void process();
 
-  AsyncObject* nextObjectToLoad();
-
-  void addObject(AsyncObject* _pObject);
+  //! \note lower priorities are loaded first, e.g. the distance to the camera
+  void addObject(AsyncObject* _pObject, float priority = 0.f);
+  //! \note blocks until a worker currently loading the object is done with it
   void removeObject(AsyncObject* _pObject);
 
   void start(int _numThreads = 1);
   void stop();
 
   void join();
+
 private:
-  std::list<AsyncObject*> m_objects;
+  struct queued_object
+  {
+    float priority;
+    std::size_t sequence;
+    AsyncObject* object;
+
+    // std::*_heap keep the "largest" element in front
+    bool operator< (queued_object const& other) const
+    {
+      return priority != other.priority ? priority > other.priority
+                                        : sequence > other.sequence;
+    }
+  };
+
+  //! \note blocks until there is work, returns nullptr when stopped
+  AsyncObject* nextObjectToLoad();
+  bool isInProgress(AsyncObject* _pObject) const;
+  bool isQueued(AsyncObject* _pObject) const;
+
+  std::vector<queued_object> m_objects;
+  std::vector<AsyncObject*> m_inProgress;
+  std::size_t m_nextSequence = 0;
+  bool m_stopped = false;
+
   boost::thread_group m_threads;
   boost::mutex m_loadingMutex;
+  //! \brief workers wait for objects being queued or the loader stopping
+  boost::condition_variable m_queueChanged;
+  //! \brief removeObject() waits for a worker to be done with the object
+  boost::condition_variable m_loadingFinished;
 };
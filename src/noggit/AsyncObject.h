@@ -2,10 +2,12 @@
 
 #pragma once
 
+#include <atomic>
+
 class AsyncObject
 {
 protected:
-  bool finished;
+  std::atomic<bool> finished {false};
 public:
   virtual ~AsyncObject() {}
 
@@ -14,4 +16,15 @@ public:
     return finished;
   }
   virtual void finishLoading() = 0;
+
+  //! \brief Queued on or being loaded by an AsyncLoader right now.
+  bool loading() const
+  {
+    return _loading;
+  }
+
+private:
+  friend class AsyncLoader;
+
+  std::atomic<bool> _loading {false};
 };
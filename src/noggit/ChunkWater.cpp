@@ -12,21 +12,23 @@ ChunkWater::ChunkWater(float x, float z)
 {
 }
 
-void ChunkWater::fromFile(MPQFile &f, size_t basePos)
+chunk_water_data ChunkWater::read(MPQFile &f, size_t basePos)
 {
+  chunk_water_data data;
+
   MH2O_Header header;
   f.read(&header, sizeof(MH2O_Header));
-  if (!header.nLayers) return;
+  if (!header.nLayers) return data;
 
   //render
   if (header.ofsRenderMask)
   {
     f.seek(basePos + header.ofsRenderMask + sizeof(MH2O_Render));
-    f.read(&Render, sizeof(MH2O_Render));
+    f.read(&data.render, sizeof(MH2O_Render));
   }
   else
   {
-    memset(&Render.mask, 255, 8);
+    memset(&data.render.mask, 255, 8);
   }
 
   for (std::size_t k = 0; k < header.nLayers; ++k)
@@ -83,7 +85,21 @@ void ChunkWater::fromFile(MPQFile &f, size_t basePos)
       }
     }
 
-    _layers.emplace_back(math::vector_3d(xbase, 0.0f, zbase), info, heightmask, infoMask);
+    data.layers.push_back({info, heightmask, infoMask});
+  }
+
+  return data;
+}
+
+void ChunkWater::load(chunk_water_data const& data)
+{
+  if (data.layers.empty()) return;
+
+  Render = data.render;
+
+  for (chunk_water_data::layer const& layer : data.layers)
+  {
+    _layers.emplace_back(math::vector_3d(xbase, 0.0f, zbase), layer.info, layer.heightmask, layer.infomask);
   }
 
   update_layers();
@@ -6,6 +6,7 @@
 #include <noggit/MapHeaders.h>
 #include <noggit/liquid_layer.hpp>
 
+#include <cstdint>
 #include <vector>
 #include <set>
 
@@ -13,12 +14,29 @@ class MPQFile;
 class sExtendableArray;
 class MapChunk;
 
+//! \brief A chunk's MH2O entry as read from the file, without any
+//! liquid_layer, so it can be read on a loader thread.
+struct chunk_water_data
+{
+  struct layer
+  {
+    MH2O_Information info;
+    MH2O_HeightMask heightmask;
+    std::uint64_t infomask;
+  };
+
+  MH2O_Render render;
+  std::vector<layer> layers;
+};
+
 class ChunkWater
 {
 public:
   ChunkWater(float x, float z);
 
-  void fromFile(MPQFile &f, size_t basePos);
+  static chunk_water_data read(MPQFile &f, size_t basePos);
+  //! \note creates the layers' buffers and textures, needs the GL context
+  void load(chunk_water_data const& data);
   void save(sExtendableArray& adt, int base_pos, int& header_pos, int& current_pos);
 
   void draw ( opengl::scoped::use_program& water_shader
@@ -4,9 +4,12 @@
 #include <noggit/Log.h>
 #include <noggit/MPQ.h>
 #include <noggit/Project.h>
+#include <noggit/mpq_file_key.hpp>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/thread.hpp>
 
 #include <algorithm>
@@ -17,7 +20,9 @@
 #include <list>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace
@@ -25,34 +30,306 @@ namespace
   typedef std::pair<std::string, std::unique_ptr<MPQArchive>> ArchiveEntry;
   typedef std::list<ArchiveEntry> ArchivesMap;
   ArchivesMap _openArchives;
+  // only (un)loading archives takes this exclusively, reading files shares it
+  boost::shared_mutex gArchivesMutex;
+
+  // owning archive of every file in the archives' hash tables. guarded by
+  // gArchivesMutex. archives loaded later override earlier ones.
+  std::unordered_map<noggit::mpq::file_key, MPQArchive*> gArchiveIndex;
+  // archives whose hash table could not be read, these are still probed
+  std::unordered_set<MPQArchive const*> gUnindexedArchives;
+
+  // files below the project path, built on first use and again whenever the
+  // project path changes. files saved through MPQFile are added right away,
+  // files other programs add to the project path are only seen after the next
+  // rebuild, i.e. once the project path is changed or noggit restarted.
+  std::unordered_set<noggit::mpq::file_key> gDiskIndex;
+  // the project path gDiskIndex was built for
+  std::string gDiskIndexRoot;
+  boost::shared_mutex gDiskIndexMutex;
 
-  boost::mutex gListfileLoadingMutex;
-  boost::mutex gMPQFileMutex;
   std::string modmpqpath = "";//this will be the path to modders archive (with 'myworld' file inside)
+
+  // pre-cond: gArchivesMutex is held exclusively
+  void indexArchive(MPQArchive* archive)
+  {
+    std::vector<noggit::mpq::file_key> keys;
+
+    if (!archive->fileKeys(keys))
+    {
+      LogDebug << "Could not read the hash table of " << archive->mpqname << ", probing it instead\n";
+      gUnindexedArchives.emplace(archive);
+      return;
+    }
+
+    for (noggit::mpq::file_key key : keys)
+    {
+      gArchiveIndex[key] = archive;
+    }
+  }
+
+  // pre-cond: gArchivesMutex is held exclusively
+  void reindexArchives()
+  {
+    gArchiveIndex.clear();
+    gUnindexedArchives.clear();
+
+    for (ArchiveEntry const& entry : _openArchives)
+    {
+      indexArchive(entry.second.get());
+    }
+  }
+
+  // pre-cond: gArchivesMutex is held
+  MPQArchive* resolveArchive(const std::string& filename)
+  {
+    auto const it(gArchiveIndex.find(noggit::mpq::make_file_key(filename)));
+    MPQArchive* indexed(it == gArchiveIndex.end() ? nullptr : it->second);
+
+    if (gUnindexedArchives.empty())
+    {
+      return indexed;
+    }
+
+    for (ArchivesMap::reverse_iterator entry = _openArchives.rbegin(); entry != _openArchives.rend(); ++entry)
+    {
+      MPQArchive* archive(entry->second.get());
+
+      if (archive == indexed)
+      {
+        break;
+      }
+      if (gUnindexedArchives.count(archive) && archive->hasFile(filename))
+      {
+        return archive;
+      }
+    }
+
+    return indexed;
+  }
+
+  // the key of a file below the project path, false if it is not below it
+  bool projectFileKey(const std::string& diskPath, noggit::mpq::file_key* key)
+  {
+    std::string const root(Project::getInstance()->getPath());
+
+    if (root.empty() || diskPath.compare(0, root.size(), root) != 0)
+    {
+      return false;
+    }
+
+    char const* begin(diskPath.data() + root.size());
+    char const* end(diskPath.data() + diskPath.size());
+
+    while (begin != end && (*begin == '/' || *begin == '\\'))
+    {
+      ++begin;
+    }
+
+    *key = noggit::mpq::make_file_key(begin, end);
+    return true;
+  }
+
+  // pre-cond: gDiskIndexMutex is not held
+  void updateDiskIndex()
+  {
+    std::string const root(Project::getInstance()->getPath());
+
+    {
+      boost::shared_lock<boost::shared_mutex> lock(gDiskIndexMutex);
+      if (gDiskIndexRoot == root)
+      {
+        return;
+      }
+    }
+
+    std::unordered_set<noggit::mpq::file_key> files;
+    boost::system::error_code ec;
+
+    if (!root.empty() && boost::filesystem::is_directory(root, ec))
+    {
+      for ( boost::filesystem::recursive_directory_iterator it(root, ec), end
+          ; !ec && it != end
+          ; it.increment(ec)
+          )
+      {
+        noggit::mpq::file_key key;
+        if (boost::filesystem::is_regular_file(it->status()) && projectFileKey(it->path().string(), &key))
+        {
+          files.emplace(key);
+        }
+      }
+    }
+
+    boost::unique_lock<boost::shared_mutex> lock(gDiskIndexMutex);
+    if (gDiskIndexRoot != root)
+    {
+      gDiskIndex = std::move(files);
+      gDiskIndexRoot = root;
+
+      LogDebug << "Indexed " << gDiskIndex.size() << " files in project path " << root << "\n";
+    }
+  }
 }
 
-std::unordered_set<std::string> gListfile;
+noggit::mpq::listfile gListfile;
 
 void MPQArchive::loadMPQ (AsyncLoader* loader, const std::string& filename, bool doListfile)
 {
-  _openArchives.emplace_back (filename, std::make_unique<MPQArchive> (filename, doListfile));
+  auto archive (std::make_unique<MPQArchive> (filename, doListfile));
+
+  // an archive failing to open is reported once and never asked for files
+  if (archive->_openFailed)
+  {
+    return;
+  }
+
+  boost::unique_lock<boost::shared_mutex> lock(gArchivesMutex);
+  _openArchives.emplace_back (filename, std::move (archive));
+  indexArchive(_openArchives.back().second.get());
   loader->addObject(_openArchives.back().second.get());
 }
 
 MPQArchive::MPQArchive(const std::string& filename, bool doListfile)
-  : _archiveHandle(nullptr)
+  : _openFailed(false)
+  , _mappingFailed(false)
+  , mpqname(filename)
 {
-  if (!SFileOpenArchive(filename.c_str(), 0, MPQ_OPEN_NO_LISTFILE | STREAM_FLAG_READ_ONLY, &_archiveHandle))
+  if (!acquireHandle())
   {
-    LogError << "Error opening archive: " << filename << "\n";
+    _openFailed = true;
     return;
   }
-  else
+
+  LogDebug << "Opened archive " << filename << "\n";
+
+  finished = !doListfile;
+}
+
+MPQArchive::handle_lease::handle_lease(MPQArchive const* archive, HANDLE handle)
+  : _archive(archive)
+  , _handle(handle)
+{}
+
+MPQArchive::handle_lease::handle_lease(handle_lease&& other)
+  : _archive(other._archive)
+  , _handle(other._handle)
+{
+  other._handle = nullptr;
+}
+
+MPQArchive::handle_lease::~handle_lease()
+{
+  if (_handle)
+  {
+    _archive->releaseHandle(_handle);
+  }
+}
+
+MPQArchive::handle_lease MPQArchive::acquireHandle() const
+{
   {
-    LogDebug << "Opened archive " << filename << "\n";
+    boost::mutex::scoped_lock lock(_handlesMutex);
+
+    if (!_idleHandles.empty())
+    {
+      HANDLE const handle(_idleHandles.back());
+      _idleHandles.pop_back();
+      return handle_lease(this, handle);
+    }
   }
 
-  finished = !doListfile;
+  HANDLE handle(nullptr);
+  if (_openFailed)
+  {
+    return handle_lease(this, handle);
+  }
+
+  if (!SFileOpenArchive(mpqname.c_str(), 0, MPQ_OPEN_NO_LISTFILE | STREAM_FLAG_READ_ONLY, &handle))
+  {
+    LogError << "Error opening archive: " << mpqname << "\n";
+    handle = nullptr;
+  }
+
+  return handle_lease(this, handle);
+}
+
+void MPQArchive::releaseHandle(HANDLE handle) const
+{
+  std::size_t const maxIdleHandles(std::max(1u, boost::thread::hardware_concurrency()));
+
+  {
+    boost::mutex::scoped_lock lock(_handlesMutex);
+
+    if (_idleHandles.size() < maxIdleHandles)
+    {
+      _idleHandles.push_back(handle);
+      return;
+    }
+  }
+
+  SFileCloseArchive(handle);
+}
+
+std::shared_ptr<boost::interprocess::mapped_region const> MPQArchive::mapping() const
+{
+  boost::mutex::scoped_lock lock(_mappingMutex);
+
+  if (!_mapping && !_mappingFailed)
+  {
+    try
+    {
+      boost::interprocess::file_mapping const file(mpqname.c_str(), boost::interprocess::read_only);
+      _mapping = std::make_shared<boost::interprocess::mapped_region const>(file, boost::interprocess::read_only);
+    }
+    catch (boost::interprocess::interprocess_exception const& ex)
+    {
+      // e.g. not enough address space for huge archives in 32 bit builds
+      LogDebug << "Could not map archive " << mpqname << ", reading it through StormLib only: " << ex.what() << "\n";
+      _mappingFailed = true;
+    }
+  }
+
+  return _mapping;
+}
+
+std::shared_ptr<boost::interprocess::mapped_region const>
+  MPQArchive::mapPlainFile(handle_lease const& archiveHandle, HANDLE fileHandle, char const** data, size_t* size) const
+{
+  DWORD flags(0);
+  DWORD fileSize(0);
+  DWORD compressedSize(0);
+  ULONGLONG byteOffset(0);
+  ULONGLONG headerOffset(0);
+
+  if ( !SFileGetFileInfo(fileHandle, SFileInfoFlags, &flags, sizeof(flags), nullptr)
+    || !SFileGetFileInfo(fileHandle, SFileInfoFileSize, &fileSize, sizeof(fileSize), nullptr)
+    || !SFileGetFileInfo(fileHandle, SFileInfoCompressedSize, &compressedSize, sizeof(compressedSize), nullptr)
+    || !SFileGetFileInfo(fileHandle, SFileInfoByteOffset, &byteOffset, sizeof(byteOffset), nullptr)
+    || !SFileGetFileInfo(archiveHandle.get(), SFileMpqHeaderOffset, &headerOffset, sizeof(headerOffset), nullptr)
+     )
+  {
+    return nullptr;
+  }
+
+  DWORD const notPlain(MPQ_FILE_COMPRESS_MASK | MPQ_FILE_ENCRYPTED | MPQ_FILE_PATCH_FILE | MPQ_FILE_DELETE_MARKER);
+  if ((flags & notPlain) || fileSize == 0 || fileSize != compressedSize)
+  {
+    return nullptr;
+  }
+
+  auto region(mapping());
+  ULONGLONG const offset(headerOffset + byteOffset);
+
+  if (!region || offset + fileSize > region->get_size())
+  {
+    return nullptr;
+  }
+
+  *data = static_cast<char const*>(region->get_address()) + offset;
+  *size = fileSize;
+
+  return region;
 }
 
 void MPQArchive::finishLoading()
@@ -60,12 +337,17 @@ void MPQArchive::finishLoading()
   if (finished)
     return;
 
-  HANDLE fh;
+  // only guards against a synchronous allFinishLoading() loading the same
+  // archive as a loader thread, different archives are loaded in parallel
+  boost::mutex::scoped_lock lock(_listfileMutex);
 
-  boost::mutex::scoped_lock lock2(gMPQFileMutex);
-  boost::mutex::scoped_lock lock(gListfileLoadingMutex);
+  if (finished)
+    return;
 
-  if (SFileOpenFileEx(_archiveHandle, "(listfile)", 0, &fh))
+  handle_lease const archiveHandle(acquireHandle());
+  HANDLE fh;
+
+  if (openFile(archiveHandle, "(listfile)", &fh))
   {
     size_t filesize = SFileGetFileSize(fh, nullptr); //last nullptr for newer version of StormLib
 
@@ -73,28 +355,7 @@ void MPQArchive::finishLoading()
     SFileReadFile(fh, readbuffer.data(), filesize, nullptr, nullptr); //last nullptrs for newer version of StormLib
     SFileCloseFile(fh);
 
-    std::string current;
-    for (char c : readbuffer)
-    {
-      if (c == '\r')
-      {
-        continue;
-      }
-      if (c == '\n')
-      {
-        gListfile.emplace (noggit::mpq::normalized_filename (current));
-        current.resize (0);
-      }
-      else
-      {
-        current += c;
-      }
-    }
-
-    if (!current.empty())
-    {
-      gListfile.emplace (noggit::mpq::normalized_filename (current));
-    }
+    gListfile.add (std::move (readbuffer));
   }
 
   finished = true;
@@ -107,12 +368,16 @@ void MPQArchive::finishLoading()
 
 MPQArchive::~MPQArchive()
 {
-  if (_archiveHandle)
-    SFileCloseArchive(_archiveHandle);
+  for (HANDLE handle : _idleHandles)
+  {
+    SFileCloseArchive(handle);
+  }
 }
 
 bool MPQArchive::allFinishedLoading()
 {
+  boost::shared_lock<boost::shared_mutex> lock(gArchivesMutex);
+
   bool allFinished = true;
   for (ArchivesMap::const_iterator it = _openArchives.begin(); it != _openArchives.end(); ++it)
   {
@@ -123,6 +388,8 @@ bool MPQArchive::allFinishedLoading()
 
 void MPQArchive::allFinishLoading()
 {
+  boost::shared_lock<boost::shared_mutex> lock(gArchivesMutex);
+
   for (ArchivesMap::iterator it = _openArchives.begin(); it != _openArchives.end(); ++it)
   {
     it->second->finishLoading();
@@ -131,40 +398,79 @@ void MPQArchive::allFinishLoading()
 
 void MPQArchive::unloadAllMPQs()
 {
+  boost::unique_lock<boost::shared_mutex> lock(gArchivesMutex);
   _openArchives.clear();
+  reindexArchives();
 }
 
 bool MPQArchive::hasFile(const std::string& filename) const
 {
-  return SFileHasFile(_archiveHandle, filename.c_str());
+  handle_lease const handle(acquireHandle());
+  return handle && SFileHasFile(handle.get(), filename.c_str());
 }
 
 void MPQArchive::unloadMPQ(const std::string& filename)
 {
+  boost::unique_lock<boost::shared_mutex> lock(gArchivesMutex);
+
   for (ArchivesMap::iterator it = _openArchives.begin(); it != _openArchives.end(); ++it)
   {
     if (it->first == filename)
     {
       _openArchives.erase(it);
+      break;
+    }
+  }
+
+  reindexArchives();
+}
+
+bool MPQArchive::fileKeys(std::vector<noggit::mpq::file_key>& keys) const
+{
+  handle_lease const handle(acquireHandle());
+  DWORD hashTableSize(0);
+
+  if ( !handle
+    || !SFileGetFileInfo(handle.get(), SFileMpqHashTableSize, &hashTableSize, sizeof(hashTableSize), nullptr)
+     )
+  {
+    return false;
+  }
+
+  std::vector<TMPQHash> hashTable(hashTableSize);
+
+  if (!SFileGetFileInfo(handle.get(), SFileMpqHashTable, hashTable.data(), hashTable.size() * sizeof(TMPQHash), nullptr))
+  {
+    return false;
+  }
+
+  for (TMPQHash const& entry : hashTable)
+  {
+    // SFileHasFile only looks at locale neutral entries, so do we
+    if (entry.dwBlockIndex < HASH_ENTRY_DELETED && entry.lcLocale == 0)
+    {
+      keys.push_back(noggit::mpq::make_file_key(entry.dwName1, entry.dwName2));
     }
   }
+
+  return true;
 }
 
-bool MPQArchive::openFile(const std::string& filename, HANDLE* fileHandle) const
+bool MPQArchive::openFile(handle_lease const& archiveHandle, const std::string& filename, HANDLE* fileHandle) const
 {
   assert(fileHandle);
-  return SFileOpenFileEx(_archiveHandle, filename.c_str(), 0, fileHandle);
+  return archiveHandle && SFileOpenFileEx(archiveHandle.get(), filename.c_str(), 0, fileHandle);
 }
 /*
 * basic constructor to save the file to project path
 */
 MPQFile::MPQFile(const std::string& pFilename)
   : eof(true)
+  , data(nullptr)
+  , size(0)
   , pointer(0)
   , External(false)
 {
-  boost::mutex::scoped_lock lock(gMPQFileMutex);
-
   if (pFilename.empty())
     throw std::runtime_error("MPQFile: filename empty");
   if (!exists(pFilename))
@@ -172,49 +478,26 @@ MPQFile::MPQFile(const std::string& pFilename)
 
   fname = getDiskPath(pFilename);
 
-  std::ifstream input(fname.c_str(), std::ios_base::binary | std::ios_base::in);
-  if (input.is_open())
+  if (readFromDisk())
   {
     External = true;
     eof = false;
-
-    input.seekg(0, std::ios::end);
-    buffer.resize (input.tellg());
-    input.seekg(0, std::ios::beg);
-
-    input.read(buffer.data(), buffer.size());
-
-    input.close();
     return;
   }
 
-  std::string filename(getMPQPath(pFilename));
-
-  for (ArchivesMap::reverse_iterator i = _openArchives.rbegin(); i != _openArchives.rend(); ++i)
-  {
-    HANDLE fileHandle;
-
-    if (!i->second->openFile(filename, &fileHandle))
-      continue;
-
-    eof = false;
-    buffer.resize (SFileGetFileSize(fileHandle, nullptr));
-    SFileReadFile(fileHandle, buffer.data(), buffer.size(), nullptr, nullptr); //last nullptrs for newer version of StormLib
-    SFileCloseFile(fileHandle);
-
-    return;
-  }
+  eof = !readFromArchives(getMPQPath(pFilename));
 }
 /*
 * Alternate constructor to save the file to an outside path
 */
 MPQFile::MPQFile(const std::string& pFilename, const std::string& alternateSavePath)
   : eof(true)
+  , data(nullptr)
+  , size(0)
   , pointer(0)
   , External(false)
 {
   LogDebug << "MPGFILE 1 alternateSavePath: " << alternateSavePath << std::endl;
-  boost::mutex::scoped_lock lock(gMPQFileMutex);
 
   if (pFilename.empty())
     throw std::runtime_error("MPQFile: filename empty");
@@ -227,43 +510,110 @@ MPQFile::MPQFile(const std::string& pFilename, const std::string& alternateSaveP
   fname = getAlternateDiskPath(pFilename, alternateSavePath);
 
 
-  std::ifstream input(fname.c_str(), std::ios_base::binary | std::ios_base::in);
-  if (input.is_open())
+  if (readFromDisk())
   {
     External = true;
     eof = false;
+    return;
+  }
 
-    input.seekg(0, std::ios::end);
-    buffer.resize (input.tellg());
-    input.seekg(0, std::ios::beg);
+  eof = !readFromArchives(getMPQPath(pFilename));
+}
 
-    input.read(buffer.data(), buffer.size());
+MPQFile::~MPQFile()
+{
+  close();
+}
 
-    input.close();
-    return;
+bool MPQFile::readFromDisk()
+{
+  if (!boost::filesystem::is_regular_file(fname))
+  {
+    return false;
   }
 
-  std::string filename(getMPQPath(pFilename));
+  if (boost::filesystem::file_size(fname) == 0)
+  {
+    useBuffer();
+    return true;
+  }
 
-  for (ArchivesMap::reverse_iterator i = _openArchives.rbegin(); i != _openArchives.rend(); ++i)
+  try
   {
-    HANDLE fileHandle;
+    boost::interprocess::file_mapping const file(fname.c_str(), boost::interprocess::read_only);
+    auto region(std::make_shared<boost::interprocess::mapped_region const>(file, boost::interprocess::read_only));
 
-    if (!i->second->openFile(filename, &fileHandle))
-      continue;
+    data = static_cast<char const*>(region->get_address());
+    size = region->get_size();
+    mapping = std::move(region);
 
-    eof = false;
+    return true;
+  }
+  catch (boost::interprocess::interprocess_exception const&)
+  {
+    // fall back to reading the file into memory below
+  }
+
+  std::ifstream input(fname.c_str(), std::ios_base::binary | std::ios_base::in);
+  if (!input.is_open())
+  {
+    return false;
+  }
+
+  input.seekg(0, std::ios::end);
+  buffer.resize (input.tellg());
+  input.seekg(0, std::ios::beg);
+
+  input.read(buffer.data(), buffer.size());
+
+  useBuffer();
+  return true;
+}
+
+bool MPQFile::readFromArchives(const std::string& mpqPath)
+{
+  boost::shared_lock<boost::shared_mutex> lock(gArchivesMutex);
+
+  MPQArchive* archive(resolveArchive(mpqPath));
+
+  if (!archive)
+  {
+    return false;
+  }
+
+  MPQArchive::handle_lease const archiveHandle(archive->acquireHandle());
+  HANDLE fileHandle;
+
+  if (!archive->openFile(archiveHandle, mpqPath, &fileHandle))
+  {
+    return false;
+  }
+
+  mapping = archive->mapPlainFile(archiveHandle, fileHandle, &data, &size);
+
+  if (!mapping)
+  {
     buffer.resize (SFileGetFileSize(fileHandle, nullptr));
     SFileReadFile(fileHandle, buffer.data(), buffer.size(), nullptr, nullptr); //last nullptrs for newer version of StormLib
-    SFileCloseFile(fileHandle);
-
-    return;
+    useBuffer();
   }
+
+  SFileCloseFile(fileHandle);
+
+  return true;
 }
 
-MPQFile::~MPQFile()
+void MPQFile::useBuffer()
 {
-  close();
+  mapping.reset();
+  data = buffer.data();
+  size = buffer.size();
+}
+
+void MPQFile::setBuffer(std::vector<char>&& vec)
+{
+  buffer = std::move(vec);
+  useBuffer();
 }
 
 std::string MPQFile::getDiskPath(const std::string &pFilename)
@@ -322,19 +672,16 @@ bool MPQFile::exists(const std::string& pFilename)
 
 bool MPQFile::existsOnDisk(const std::string &pFilename)
 {
-  std::string filename(getDiskPath(pFilename));
-  return boost::filesystem::exists(filename);
+  updateDiskIndex();
+
+  boost::shared_lock<boost::shared_mutex> lock(gDiskIndexMutex);
+  return gDiskIndex.count(noggit::mpq::make_file_key(pFilename));
 }
 
 bool MPQFile::existsInMPQ(const std::string &pFilename)
 {
-  std::string filename(getMPQPath(pFilename));
-
-  for (ArchivesMap::reverse_iterator it = _openArchives.rbegin(); it != _openArchives.rend(); ++it)
-    if (it->second->hasFile(filename))
-      return true;
-
-  return false;
+  boost::shared_lock<boost::shared_mutex> lock(gArchivesMutex);
+  return resolveArchive(pFilename) != nullptr;
 }
 
 void MPQFile::save(std::string const& filename)  //save to MPQ
@@ -384,12 +731,12 @@ size_t MPQFile::read(void* dest, size_t bytes)
     return 0;
 
   size_t rpos = pointer + bytes;
-  if (rpos > buffer.size()) {
-    bytes = buffer.size() - pointer;
+  if (rpos > size) {
+    bytes = size - pointer;
     eof = true;
   }
 
-  memcpy(dest, &(buffer[pointer]), bytes);
+  memcpy(dest, data + pointer, bytes);
 
   pointer = rpos;
 
@@ -404,13 +751,13 @@ bool MPQFile::isEof() const
 void MPQFile::seek(size_t offset)
 {
   pointer = offset;
-  eof = (pointer >= buffer.size());
+  eof = (pointer >= size);
 }
 
 void MPQFile::seekRelative(size_t offset)
 {
   pointer += offset;
-  eof = (pointer >= buffer.size());
+  eof = (pointer >= size);
 }
 
 void MPQFile::close()
@@ -420,7 +767,7 @@ void MPQFile::close()
 
 size_t MPQFile::getSize() const
 {
-  return buffer.size();
+  return size;
 }
 
 size_t MPQFile::getPos() const
@@ -430,12 +777,12 @@ size_t MPQFile::getPos() const
 
 char const* MPQFile::getBuffer() const
 {
-  return buffer.data();
+  return data;
 }
 
 char const* MPQFile::getPointer() const
 {
-  return buffer.data() + pointer;
+  return data + pointer;
 }
 
 void MPQFile::SaveFile()
@@ -459,6 +806,13 @@ void MPQFile::SaveFile()
     LogError << "Is \"" << lDirectoryName << "\" really a location I can write to? Saving failed." << std::endl;
   }
 
+  // never write a file from a mapping of itself, the write truncates it
+  if (mapping)
+  {
+    buffer.assign(data, data + size);
+    useBuffer();
+  }
+
   std::ofstream output(lFilename.c_str(), std::ios_base::binary | std::ios_base::out);
   if (output.is_open())
   {
@@ -469,6 +823,15 @@ void MPQFile::SaveFile()
 
     External = true;
 
+    noggit::mpq::file_key key;
+    if (projectFileKey(lFilename, &key))
+    {
+      updateDiskIndex();
+
+      boost::unique_lock<boost::shared_mutex> lock(gDiskIndexMutex);
+      gDiskIndex.emplace(key);
+    }
+
     //! \todo Enable again. After fixing it.
     //save(lFilename.c_str());
   }
@@ -478,15 +841,21 @@ namespace noggit
 {
   namespace mpq
   {
-    std::string normalized_filename (std::string filename)
+    void normalize_filename (boost::string_ref filename, std::string& normalized)
     {
-      std::transform (filename.begin(), filename.end(), filename.begin(), ::tolower);
-      std::transform ( filename.begin(), filename.end(), filename.begin()
+      normalized.assign (filename.begin(), filename.end());
+      std::transform ( normalized.begin(), normalized.end(), normalized.begin()
                      , [] (char c)
                        {
+                         c = ::tolower (c);
                          return c == '\\' ? '/' : c;
                        }
                      );
+    }
+
+    std::string normalized_filename (std::string filename)
+    {
+      normalize_filename (filename, filename);
       return filename;
     }
   }
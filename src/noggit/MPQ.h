@@ -3,23 +3,87 @@
 #pragma once
 
 #include <noggit/AsyncObject.h>
+#include <noggit/mpq_file_key.hpp>
+#include <noggit/mpq_listfile.hpp>
 
 #include <StormLib.h>
 
+#include <boost/thread.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <memory>
 #include <set>
 #include <string>
-#include <unordered_set>
 #include <vector>
 
 class AsyncLoader;
 class MPQArchive;
 class MPQFile;
 
-extern std::unordered_set<std::string> gListfile;
+namespace boost
+{
+  namespace interprocess
+  {
+    class mapped_region;
+  }
+}
+
+extern noggit::mpq::listfile gListfile;
 
 class MPQArchive : public AsyncObject
 {
-  HANDLE _archiveHandle;
+public:
+  //! \brief Exclusive use of one of the archive's StormLib handles, which
+  //! must not be shared between threads. Returned to the archive's pool when
+  //! destroyed.
+  class handle_lease
+  {
+  public:
+    handle_lease(MPQArchive const* archive, HANDLE handle);
+    handle_lease(handle_lease&&);
+    ~handle_lease();
+
+    handle_lease(handle_lease const&) = delete;
+    handle_lease& operator=(handle_lease const&) = delete;
+    handle_lease& operator=(handle_lease&&) = delete;
+
+    HANDLE get() const { return _handle; }
+    explicit operator bool() const { return _handle != nullptr; }
+
+  private:
+    MPQArchive const* _archive;
+    HANDLE _handle;
+  };
+
+private:
+  //! \brief A handle nobody else uses, opening a new one if all are taken.
+  //! \note Handles are pooled per archive instead of per thread, so
+  //! short-lived threads don't leave handles, and their copies of the hash
+  //! and block tables, behind.
+  handle_lease acquireHandle() const;
+  void releaseHandle(HANDLE handle) const;
+
+  //! \brief Handles not in use, at most one per hardware thread is kept.
+  mutable std::vector<HANDLE> _idleHandles;
+  mutable boost::mutex _handlesMutex;
+  //! \brief The archive couldn't be opened, so it isn't tried again.
+  bool _openFailed;
+
+  //! \brief Read-only mapping of the whole archive, created on first use.
+  std::shared_ptr<boost::interprocess::mapped_region const> mapping() const;
+
+  //! \brief Points data into the archive mapping if the file is stored as a
+  //! single plain block, i.e. neither compressed nor encrypted.
+  //! \return the mapping to keep alive while data is in use, nullptr if the
+  //! file has to be read through StormLib
+  std::shared_ptr<boost::interprocess::mapped_region const>
+    mapPlainFile(handle_lease const& archiveHandle, HANDLE fileHandle, char const** data, size_t* size) const;
+
+  mutable std::shared_ptr<boost::interprocess::mapped_region const> _mapping;
+  mutable bool _mappingFailed;
+  mutable boost::mutex _mappingMutex;
+
+  boost::mutex _listfileMutex;
 
 public:
   MPQArchive(const std::string& filename, bool doListfile);
@@ -28,7 +92,11 @@ public:
   std::string mpqname;
 
   bool hasFile(const std::string& filename) const;
-  bool openFile(const std::string& filename, HANDLE* fileHandle) const;
+  //! \brief Keys of all files in the archive's hash table.
+  //! \return false if the hash table could not be read
+  bool fileKeys(std::vector<noggit::mpq::file_key>& keys) const;
+  //! \note fileHandle is only valid while archiveHandle is held
+  bool openFile(handle_lease const& archiveHandle, const std::string& filename, HANDLE* fileHandle) const;
 
   void finishLoading();
 
@@ -47,6 +115,11 @@ class MPQFile
 {
   bool eof;
   std::vector<char> buffer;
+  //! \note loose files and plain archive blocks are not copied into buffer
+  //! but read in place from a read-only mapping which is kept alive here.
+  std::shared_ptr<boost::interprocess::mapped_region const> mapping;
+  char const* data;
+  size_t size;
   size_t pointer;
 
   // disable copying
@@ -79,13 +152,14 @@ public:
   template<typename T>
   const T* get(size_t offset) const
   {
-    return reinterpret_cast<T const*>(buffer.data() + offset);
+    return reinterpret_cast<T const*>(data + offset);
   }
 
   void setBuffer (std::vector<char> const& vec)
   {
-    buffer = vec;
+    setBuffer (std::vector<char> (vec));
   }
+  void setBuffer (std::vector<char>&& vec);
 
   void SaveFile();
 
@@ -96,6 +170,10 @@ public:
   friend class MPQArchive;
 
 private:
+  bool readFromDisk();
+  bool readFromArchives(const std::string& mpqPath);
+  void useBuffer();
+
   static std::string getDiskPath(const std::string& pFilename);
   static std::string getAlternateDiskPath(const std::string& pFilename, const std::string& pDiscpath);
   static std::string getMPQPath(const std::string& pFilename);
@@ -106,5 +184,8 @@ namespace noggit
   namespace mpq
   {
     std::string normalized_filename (std::string filename);
+    //! \brief Same as normalized_filename(), but reusing the output's
+    //! buffer so repeated calls don't allocate.
+    void normalize_filename (boost::string_ref filename, std::string& normalized);
   }
 }
@@ -11,6 +11,7 @@
 #include <noggit/Misc.h>
 #include <noggit/World.h>
 #include <noggit/alphamap.hpp>
+#include <noggit/terrain_blur.hpp>
 #include <noggit/texture_set.hpp>
 #include <noggit/tool_enums.hpp>
 #include <noggit/ui/TexturingGUI.h>
@@ -21,51 +22,10 @@
 #include <iostream>
 #include <map>
 
-namespace
-{
-  GLuint Contour = 0;
-  float CoordGen[4];
-}
-static const int CONTOUR_WIDTH = 128;
-
 static const float texDetail = 8.0f;
 
 static const float TEX_RANGE = 1.0f;
 
-namespace
-{
-  void GenerateContourMap()
-  {
-    unsigned char CTexture[CONTOUR_WIDTH * 4];
-
-    CoordGen[0] = 0.0f;
-    CoordGen[1] = 0.25f;
-    CoordGen[2] = 0.0f;
-    CoordGen[3] = 0.0f;
-
-    for (int i = 0; i<(CONTOUR_WIDTH * 4); ++i)
-      CTexture[i] = 0;
-    CTexture[3 + CONTOUR_WIDTH / 2] = 0xff;
-    CTexture[7 + CONTOUR_WIDTH / 2] = 0xff;
-    CTexture[11 + CONTOUR_WIDTH / 2] = 0xff;
-
-    opengl::scoped::bool_setter<GL_TEXTURE_2D, GL_TRUE> const texture_2d;
-    gl.genTextures(1, &Contour);
-    gl.bindTexture(GL_TEXTURE_2D, Contour);
-
-    gl.texImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, CONTOUR_WIDTH, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, CTexture);
-    gl.generateMipmap (GL_TEXTURE_2D);
-
-    opengl::scoped::bool_setter<GL_TEXTURE_GEN_S, GL_TRUE> const texture_gen_s;
-    gl.texGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
-    gl.texGenfv(GL_S, GL_OBJECT_PLANE, CoordGen);
-
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  }
-}
-
 MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha)
   : mt(maintile)
   , use_big_alphamap(bigAlpha)
@@ -140,6 +100,8 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha)
     // use absolute y pos in vertices
     ybase = 0.0f;
     header.ypos = 0.0f;
+
+    _height_tree.update (mVertices);
   }
   // - MCNR ----------------------------------------------
   {
@@ -165,7 +127,7 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha)
 
     assert(fourcc == 'MCLY');
 
-    _texture_set.initTextures(f, mt, size);
+    _texture_set.initTextures(f, size);
   }
   // - MCSH ----------------------------------------------
   if(header.ofsShadow && header.sizeShadow)
@@ -178,24 +140,8 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha)
 
     // shadow map 64 x 64
     f->read(mShadowMap, 0x200);
-    f->seekRelative(-0x200);
 
-    unsigned char sbuf[64 * 64], *p, c[8];
-    p = sbuf;
-    for (int j = 0; j<64; ++j) {
-      f->read(c, 8);
-      for (int i = 0; i<8; ++i) {
-        for (int b = 0x01; b != 0x100; b <<= 1) {
-          *p++ = (c[i] & b) ? 85 : 0;
-        }
-      }
-    }
-    shadow.bind();
-    gl.texImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 64, 64, 0, GL_ALPHA, GL_UNSIGNED_BYTE, sbuf);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    _has_shadow_texture = true;
   }
   // - MCAL ----------------------------------------------
   {
@@ -229,11 +175,6 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha)
     }
   }
 
-  // create vertex buffers
-  gl.bufferData<GL_ARRAY_BUFFER> (vertices, sizeof(mVertices), mVertices, GL_STATIC_DRAW);
-  gl.bufferData<GL_ARRAY_BUFFER> (normals, sizeof(mNormals), mNormals, GL_STATIC_DRAW);
-  gl.bufferData<GL_ARRAY_BUFFER> (mccvEntry, sizeof(mccv), mccv, GL_STATIC_DRAW);
-
   initStrip();
 
   vcenter = (vmin + vmax) * 0.5f;
@@ -264,16 +205,7 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha)
     for (size_t i = 0; i < 512; ++i)
       mShadowMap[i] = 0;
 
-    unsigned char sbuf[64 * 64];
-    for (size_t j = 0; j < 4096; ++j)
-      sbuf[j] = 0;
-
-    shadow.bind();
-    gl.texImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 64, 64, 0, GL_ALPHA, GL_UNSIGNED_BYTE, sbuf);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    _has_shadow_texture = true;
   }
 
   float ShadowAmount;
@@ -284,12 +216,53 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha)
 
     mFakeShadows[j].w = ShadowAmount;
   }
+}
+
+void MapChunk::upload()
+{
+  _texture_set.loadTextures(mt);
 
-  gl.genBuffers(1, &minimap);
-  gl.genBuffers(1, &minishadows);
+  _buffers = std::make_unique<opengl::scoped::buffers<6>>();
+  vertices = (*_buffers)[0];
+  normals = (*_buffers)[1];
+  indices = (*_buffers)[2];
+  mccvEntry = (*_buffers)[3];
+  minimap = (*_buffers)[4];
+  minishadows = (*_buffers)[5];
 
+  gl.bufferData<GL_ARRAY_BUFFER> (vertices, sizeof(mVertices), mVertices, GL_STATIC_DRAW);
+  gl.bufferData<GL_ARRAY_BUFFER> (normals, sizeof(mNormals), mNormals, GL_STATIC_DRAW);
+  gl.bufferData<GL_ARRAY_BUFFER> (mccvEntry, sizeof(mccv), mccv, GL_STATIC_DRAW);
   gl.bufferData<GL_ARRAY_BUFFER> (minimap, sizeof(mMinimap), mMinimap, GL_STATIC_DRAW);
   gl.bufferData<GL_ARRAY_BUFFER> (minishadows, sizeof(mFakeShadows), mFakeShadows, GL_STATIC_DRAW);
+
+  upload_indices();
+
+  if (_has_shadow_texture)
+  {
+    unsigned char sbuf[64 * 64], *p;
+    p = sbuf;
+    for (int j = 0; j<64; ++j) {
+      for (int i = 0; i<8; ++i) {
+        for (int b = 0x01; b != 0x100; b <<= 1) {
+          *p++ = (mShadowMap[j * 8 + i] & b) ? 85 : 0;
+        }
+      }
+    }
+
+    shadow.bind();
+    gl.texImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 64, 64, 0, GL_ALPHA, GL_UNSIGNED_BYTE, sbuf);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+}
+
+void MapChunk::upload_indices()
+{
+  opengl::scoped::buffer_binder<GL_ELEMENT_ARRAY_BUFFER> const _ (indices);
+  gl.bufferData (GL_ELEMENT_ARRAY_BUFFER, strip_with_holes.size() * sizeof (StripType), strip_with_holes.data(), GL_STATIC_DRAW);
 }
 
 
@@ -432,8 +405,11 @@ void MapChunk::initStrip()
     }
   }
 
-  opengl::scoped::buffer_binder<GL_ELEMENT_ARRAY_BUFFER> const _ (indices);
-  gl.bufferData (GL_ELEMENT_ARRAY_BUFFER, strip_with_holes.size() * sizeof (StripType), strip_with_holes.data(), GL_STATIC_DRAW);
+  // the holes changed after the chunk was uploaded
+  if (_buffers)
+  {
+    upload_indices();
+  }
 
   for (int i = 0; i < 32; ++i)
   {
@@ -471,6 +447,18 @@ void MapChunk::initStrip()
 }
 
 bool MapChunk::GetVertex(float x, float z, math::vector_3d *V)
+{
+  math::vector_3d* vertex (vertex_at(x, z));
+
+  if (vertex)
+  {
+    *V = *vertex;
+  }
+
+  return vertex;
+}
+
+math::vector_3d* MapChunk::vertex_at(float x, float z)
 {
   float xdiff, zdiff;
 
@@ -480,10 +468,9 @@ bool MapChunk::GetVertex(float x, float z, math::vector_3d *V)
   const int row = static_cast<int>(zdiff / (UNITSIZE * 0.5f) + 0.5f);
   const int column = static_cast<int>((xdiff - UNITSIZE * 0.5f * (row % 2)) / UNITSIZE + 0.5f);
   if ((row < 0) || (column < 0) || (row > 16) || (column >((row % 2) ? 8 : 9)))
-    return false;
+    return nullptr;
 
-  *V = mVertices[17 * (row / 2) + ((row % 2) ? 9 : 0) + column];
-  return true;
+  return &mVertices[17 * (row / 2) + ((row % 2) ? 9 : 0) + column];
 }
 
 float MapChunk::getHeight(int x, int z)
@@ -514,6 +501,8 @@ void MapChunk::clearHeight()
   vmin.y = 0.0f;
   vmax.y = 0.0f;
 
+  _height_tree.update (mVertices);
+
   gl.bufferData<GL_ARRAY_BUFFER>
     (vertices, sizeof(mVertices), mVertices, GL_STATIC_DRAW);
 
@@ -584,243 +573,147 @@ void MapChunk::drawLines ( opengl::scoped::use_program& line_shader
   }
 }
 
-void MapChunk::drawContour()
-{
-  gl.color4f(1, 1, 1, 1);
-  opengl::scoped::texture_setter<0, GL_TRUE> const texture;
-  opengl::scoped::bool_setter<GL_BLEND, GL_TRUE> const blend;
-  gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  opengl::scoped::bool_setter<GL_ALPHA_TEST, GL_FALSE> const alpha_test;
-  if (Contour == 0)
-    GenerateContourMap();
-  gl.bindTexture(GL_TEXTURE_2D, Contour);
-
-  opengl::scoped::bool_setter<GL_TEXTURE_GEN_S, GL_TRUE> const texture_gen_s;
-  gl.texGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
-  gl.texGenfv(GL_S, GL_OBJECT_PLANE, CoordGen);
-
-  gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
-}
-
-void MapChunk::draw ( math::frustum const& frustum
-                    , const float& cull_distance
-                    , const math::vector_3d& camera
+void MapChunk::draw ( opengl::scoped::use_program& terrain_shader
+                    , std::array<blp_texture*, 4>& bound_textures
                     , bool show_unpaintable_chunks
-                    , bool draw_contour
                     , bool draw_paintability_overlay
                     , bool draw_chunk_flag_overlay
                     , bool draw_areaid_overlay
-                    , bool draw_wireframe_overlay
-                    , int cursor_type
                     , std::map<int, misc::random_color>& area_id_colors
-                    , math::vector_4d shadow_color
-                    , boost::optional<selection_type> selection
                     , int animtime
                     )
 {
-  if (!is_visible (cull_distance, frustum, camera))
-    return;
-
   bool cantPaint = noggit::ui::selected_texture::get()
                  && !canPaintTexture(*noggit::ui::selected_texture::get())
                  && show_unpaintable_chunks
                  && draw_paintability_overlay;
 
-  if (cantPaint)
-  {
-    gl.color4f(1, 0, 0, 1);
-  }
-
-  // setup vertex buffers
-  gl.vertexPointer (vertices, 3, GL_FLOAT, 0, 0);
-  gl.normalPointer (normals, GL_FLOAT, 0, 0);
-
-  opengl::scoped::buffer_binder<GL_ELEMENT_ARRAY_BUFFER> const index_buffer (indices);
-
-  if (hasMCCV)
+  for (size_t i = 0; i < _texture_set.num(); ++i)
   {
-    gl.colorPointer (mccvEntry, 3, GL_FLOAT, 0, 0);
-    gl.enableClientState(GL_COLOR_ARRAY);
-  }
+    blp_texture* texture = _texture_set.layer_texture(i);
 
-  // ASSUME: texture coordinates set up already
-
-  // first pass: base texture
-
-  if (_texture_set.num() == 0U)
-  {
-    opengl::texture::set_active_texture (0);
-    opengl::texture::disable_texture();
-
-    opengl::texture::set_active_texture (1);
-    opengl::texture::disable_texture();
-
-    gl.color3f(1.0f, 1.0f, 1.0f);
-  }
-  else
-  {
-    _texture_set.bindTexture(0, 0);
-
-    opengl::texture::set_active_texture (1);
-    opengl::texture::disable_texture();
-  }
-
-  //! \todo: increase textures brightness when FLAG_GLOW is set (also in 2D mode)
-
-  gl.enable(GL_LIGHTING);
-  _texture_set.startAnim (0, animtime);
-  gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
-  _texture_set.stopAnim (0);
-
-  if (_texture_set.num() > 1U) {
-    //gl.depthFunc(GL_EQUAL); // GL_LEQUAL is fine too...?
-    gl.depthMask(GL_FALSE);
+    if (texture != bound_textures[i])
+    {
+      opengl::texture::set_active_texture (i);
+      texture->bind();
+      bound_textures[i] = texture;
+    }
   }
 
-  // additional passes: if required
-  for (size_t i = 1; i < _texture_set.num(); ++i)
-  {
-    // this time, use blending:
-    _texture_set.bindTexture(i, 0);
-    _texture_set.bindAlphamap(i - 1, 1);
+  _texture_set.bind_alphamaps (4);
 
-    _texture_set.startAnim (i, animtime);
-    gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
-    _texture_set.stopAnim (i);
-  }
+  opengl::texture::set_active_texture (5);
+  shadow.bind();
 
-  if (_texture_set.num() > 1U)
-  {
-    //gl.depthFunc(GL_LEQUAL);
-    gl.depthMask(GL_TRUE);
-  }
+  terrain_shader.attrib ("position", vertices, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  terrain_shader.attrib ("normal", normals, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
   if (hasMCCV)
-    gl.disableClientState(GL_COLOR_ARRAY);
-
-  if (cantPaint)
   {
-    gl.color4f(1, 1, 1, 1);
-  }
-
-  // shadow map
-  opengl::texture::set_active_texture (0);
-  opengl::texture::disable_texture();
-  gl.disable(GL_LIGHTING);
-
-  gl.color4fv (shadow_color);
-
-  //gl.color4f(1,1,1,1);
-
-  opengl::texture::enable_texture (1);
-  shadow.bind();
+    terrain_shader.attrib ("mccv", mccvEntry, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  }
+
+  terrain_shader.uniform ("layer_count", static_cast<GLint> (_texture_set.num()));
+  terrain_shader.uniform ("layer_offsets", _texture_set.animation_offsets (animtime));
+  terrain_shader.uniform ("has_mccv", static_cast<GLint> (hasMCCV));
+  terrain_shader.uniform ("cant_paint", static_cast<GLint> (cantPaint));
+
+  // draw chunk white if impassible flag is set
+  terrain_shader.uniform
+    ( "impassable_overlay"
+    , draw_chunk_flag_overlay && (Flags & FLAG_IMPASS)
+      ? math::vector_4d (1.f, 1.f, 1.f, 0.6f)
+      : math::vector_4d (0.f, 0.f, 0.f, 0.f)
+    );
+  // draw chunks in color depending on AreaID and list color from environment
+  terrain_shader.uniform
+    ( "areaid_overlay"
+    , draw_areaid_overlay
+      ? math::vector_4d (area_id_colors[areaID])
+      : math::vector_4d (0.f, 0.f, 0.f, 0.f)
+    );
 
+  opengl::scoped::buffer_binder<GL_ELEMENT_ARRAY_BUFFER> const index_buffer (indices);
   gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
+}
 
-  opengl::texture::disable_texture();
-  gl.disable(GL_LIGHTING);
-
-  if (draw_contour)
-  {
-    drawContour();
-  }
-
-  if (draw_chunk_flag_overlay)
-  {
-    // draw chunk white if impassible flag is set
-    if (Flags & FLAG_IMPASS)
-    {
-      gl.color4f(1, 1, 1, 0.6f);
-      gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
-    }
-  }
-
-  if (draw_areaid_overlay)
-  {
-    // draw chunks in color depending on AreaID and list color from environment
-    gl.color4fv (area_id_colors[areaID]);
-    gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
-  }
-
-  if (cursor_type == 3 && selection)
-  {
-    selected_chunk_type const* chunk (nullptr);
-    if ((chunk = boost::get<selected_chunk_type> (&*selection)) && chunk->chunk == this)
-    {
-      gl.color4f(1.0f, 1.0f, 0.0f, 1.0f);
-
-      opengl::scoped::bool_setter<GL_CULL_FACE, GL_FALSE> const cull_face;
-      opengl::scoped::depth_mask_setter<GL_FALSE> const depth_mask;
-      opengl::scoped::bool_setter<GL_DEPTH_TEST, GL_FALSE> const depth_test;
-
-      gl.begin(GL_TRIANGLES);
-      gl.vertex3fv(mVertices[strip_without_holes[chunk->triangle + 0]]);
-      gl.vertex3fv(mVertices[strip_without_holes[chunk->triangle + 1]]);
-      gl.vertex3fv(mVertices[strip_without_holes[chunk->triangle + 2]]);
-      gl.end();
-    }
-  }
-
-  if (draw_wireframe_overlay)
-  {
-    opengl::scoped::bool_setter<GL_LIGHTING, GL_FALSE> const lighting;
-    opengl::texture::disable_texture();
+void MapChunk::draw_selected_triangle (int triangle)
+{
+  gl.color4f(1.0f, 1.0f, 0.0f, 1.0f);
 
-    {
-      opengl::scoped::bool_setter<GL_POLYGON_OFFSET_LINE, GL_TRUE> const polygon_offset_line;
-      gl.polygonMode(GL_FRONT_AND_BACK, GL_LINE);
-      gl.lineWidth(1);
-      gl.polygonOffset(-1, -1);
-      gl.color4f(1, 1, 1, 0.2f);
-      gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
-    }
-    {
-      opengl::scoped::bool_setter<GL_POLYGON_OFFSET_POINT, GL_TRUE> const polygon_offset_point;
-      gl.polygonMode(GL_FRONT_AND_BACK, GL_POINT);
-      gl.pointSize(2);
-      gl.polygonOffset(-1, -1);
-      gl.color4f(1, 1, 1, 0.5f);
-      gl.drawElements (GL_TRIANGLES, strip_with_holes.size(), GL_UNSIGNED_SHORT, nullptr);
-    }
+  opengl::scoped::bool_setter<GL_CULL_FACE, GL_FALSE> const cull_face;
+  opengl::scoped::depth_mask_setter<GL_FALSE> const depth_mask;
+  opengl::scoped::bool_setter<GL_DEPTH_TEST, GL_FALSE> const depth_test;
+  opengl::scoped::bool_setter<GL_LIGHTING, GL_FALSE> const lighting;
 
-    gl.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
-  }
+  gl.begin(GL_TRIANGLES);
+  gl.vertex3fv(mVertices[strip_without_holes[triangle + 0]]);
+  gl.vertex3fv(mVertices[strip_without_holes[triangle + 1]]);
+  gl.vertex3fv(mVertices[strip_without_holes[triangle + 2]]);
+  gl.end();
 
-  gl.enable(GL_LIGHTING);
   gl.color4f(1.0f, 1.0f, 1.0f, 1.0f);
 }
 
-void MapChunk::intersect (math::ray const& ray, selection_result* results)
+bool MapChunk::intersect (math::ray const& ray, selection_result* results)
 {
-  if (!ray.intersect_bounds (vmin, vmax))
-  {
-    return;
-  }
+  int triangle (-1);
+  float triangle_distance (std::numeric_limits<float>::max());
+
+  auto const distance
+    ( _height_tree.intersect
+        ( ray
+        , vmin
+        , UNITSIZE
+        , [&] (int row, int column) -> boost::optional<float>
+          {
+            // initStrip adds the four triangles of a cell column by column
+            int const first ((column * 8 + row) * 12);
+            boost::optional<float> nearest;
+
+            for (int i (first); i < first + 12; i += 3)
+            {
+              auto const hit
+                ( ray.intersect_triangle ( mVertices[strip_without_holes[i + 0]]
+                                         , mVertices[strip_without_holes[i + 1]]
+                                         , mVertices[strip_without_holes[i + 2]]
+                                         )
+                );
+
+              if (hit && (!nearest || *hit < *nearest))
+              {
+                nearest = hit;
+
+                if (*hit < triangle_distance)
+                {
+                  triangle = i;
+                  triangle_distance = *hit;
+                }
+              }
+            }
+
+            return nearest;
+          }
+        )
+    );
 
-  for (int i (0); i < strip_without_holes.size(); i += 3)
+  if (!distance)
   {
-    if ( auto distance = ray.intersect_triangle ( mVertices[strip_without_holes[i + 0]]
-                                                , mVertices[strip_without_holes[i + 1]]
-                                                , mVertices[strip_without_holes[i + 2]]
-                                                )
-       )
-    {
-      results->emplace_back
-        (*distance, selected_chunk_type (this, i, ray.position (*distance)));
-    }
+    return false;
   }
+
+  results->emplace_back
+    (*distance, selected_chunk_type (this, triangle, ray.position (*distance)));
+
+  return true;
 }
 
 void MapChunk::updateVerticesData()
 {
-  vmin.y = std::numeric_limits<float>::max();
-  vmax.y = std::numeric_limits<float>::lowest();
+  _height_tree.update (mVertices);
 
-  for (int i(0); i < mapbufsize; ++i)
-  {
-    vmin.y = std::min(vmin.y, mVertices[i].y);
-    vmax.y = std::max(vmax.y, mVertices[i].y);
-  }
+  vmin.y = _height_tree.min_height();
+  vmax.y = _height_tree.max_height();
 
   gl.bufferData<GL_ARRAY_BUFFER>(vertices, sizeof(mVertices), mVertices, GL_STATIC_DRAW);
 }
@@ -1055,9 +948,14 @@ bool MapChunk::blurTerrain ( math::vector_3d const& pos
                            , float remain
                            , float radius
                            , int BrushType
-                           , std::function<boost::optional<float> (float, float)> height
+                           , noggit::terrain_blur const& blur
                            )
 {
+  if (BrushType == eFlattenType_Origin)
+  {
+    return false;
+  }
+
   bool changed (false);
 
   for (int i (0); i < mapbufsize; ++i)
@@ -1069,39 +967,13 @@ bool MapChunk::blurTerrain ( math::vector_3d const& pos
       continue;
     }
 
-    int Rad = (int)(radius / UNITSIZE);
-    float TotalHeight = 0;
-    float TotalWeight = 0;
-    for (int j = -Rad * 2; j <= Rad * 2; ++j)
-    {
-      float tz = pos.z + j * UNITSIZE / 2;
-      for (int k = -Rad; k <= Rad; ++k)
-      {
-        float tx = pos.x + k*UNITSIZE + (j % 2) * UNITSIZE / 2.0f;
-        float dist2 = misc::dist (tx, tz, mVertices[i].x, mVertices[i].z);
-        if (dist2 > radius)
-          continue;
-        auto h (height (tx, tz));
-        if (h)
-        {
-          TotalHeight += (1.0f - dist2 / radius) * h.get();
-          TotalWeight += (1.0f - dist2 / radius);
-        }
-      }
-    }
-
-	if (BrushType == eFlattenType_Origin)
-	{
-		continue;
-	}
-
     mVertices[i].y = math::interpolation::linear
       ( BrushType == eFlattenType_Flat ? remain
       : BrushType == eFlattenType_Linear ? remain * (1.f - dist / radius)
       : BrushType == eFlattenType_Smooth ? pow (remain, 1.f + dist / radius)
       : throw std::logic_error ("bad brush type")
       , mVertices[i].y
-      , TotalHeight / TotalWeight
+      , blur.average (mVertices[i])
       );
 
     changed = true;
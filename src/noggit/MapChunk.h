@@ -8,12 +8,15 @@
 #include <noggit/Selection.h>
 #include <noggit/TextureManager.h>
 #include <noggit/WMOInstance.h>
+#include <noggit/terrain_picking.hpp>
 #include <noggit/texture_set.hpp>
 #include <opengl/scoped.hpp>
 #include <opengl/texture.hpp>
 #include <noggit/Misc.h>
 
+#include <array>
 #include <map>
+#include <memory>
 
 class MPQFile;
 namespace math
@@ -21,6 +24,10 @@ namespace math
   class frustum;
   struct vector_4d;
 }
+namespace noggit
+{
+  class terrain_blur;
+}
 class Brush;
 class Alphamap;
 class ChunkWater;
@@ -40,25 +47,35 @@ private:
 
   unsigned char mShadowMap[8 * 64];
   opengl::texture shadow;
+  bool _has_shadow_texture = false;
 
   std::vector<StripType> strip_with_holes;
   std::vector<StripType> strip_without_holes;
   StripType LineStrip[32];
   StripType HoleStrip[128];
 
+  noggit::terrain_picking::chunk_height_tree _height_tree;
+
   math::vector_3d mNormals[mapbufsize];
   math::vector_3d mMinimap[mapbufsize];
   math::vector_4d mFakeShadows[mapbufsize];
   math::vector_3d mccv[mapbufsize];
 
   void initStrip();
+  void upload_indices();
 
   int indexNoLoD(int x, int y);
   int indexLoD(int x, int y);
 
 public:
+  //! \brief Parse the chunk. Doesn't touch GL or the TextureManager, so
+  //! it may run on a loader thread.
   MapChunk(MapTile* mt, MPQFile* f, bool bigAlpha);
 
+  //! \brief Create the buffers and textures and acquire the layers'
+  //! textures. Needs the GL context and has to be called before drawing.
+  void upload();
+
   MapTile *mt;
   math::vector_3d vmin, vmax, vcenter;
   int px, py;
@@ -72,13 +89,14 @@ public:
 
   TextureSet _texture_set;
 
-  opengl::scoped::buffers<4> _buffers;
-  GLuint const& vertices = _buffers[0];
-  GLuint const& normals = _buffers[1];
-  GLuint const& indices = _buffers[2];
-  GLuint const& mccvEntry = _buffers[3];
-
-  GLuint minimap, minishadows;
+  //! \note created by upload()
+  std::unique_ptr<opengl::scoped::buffers<6>> _buffers;
+  GLuint vertices = 0;
+  GLuint normals = 0;
+  GLuint indices = 0;
+  GLuint mccvEntry = 0;
+  GLuint minimap = 0;
+  GLuint minishadows = 0;
 
   math::vector_3d mVertices[mapbufsize];
 
@@ -87,25 +105,27 @@ public:
                   , const math::vector_3d& camera
                   ) const;
 
-  void draw ( math::frustum const& frustum
-            , const float& cull_distance
-            , const math::vector_3d& camera
+  //! \brief Draw all layers, the shadow and the overlays in a single
+  //! pass with the terrain program set up by World::draw.
+  //! \note The layers are bound to the texture units 0 to 3, the packed
+  //! alphamaps to 4 and the shadow to 5. bound_textures holds the layers
+  //! bound by the previous chunk, which are not bound again.
+  void draw ( opengl::scoped::use_program& terrain_shader
+            , std::array<blp_texture*, 4>& bound_textures
             , bool show_unpaintable_chunks
-            , bool draw_contour
             , bool draw_paintability_overlay
             , bool draw_chunk_flag_overlay
             , bool draw_areaid_overlay
-            , bool draw_wireframe_overlay
-            , int cursor_type
             , std::map<int, misc::random_color>& area_id_colors
-            , math::vector_4d shadow_color
-            , boost::optional<selection_type> selection
             , int animtime
             );
   //! \todo only this function should be public, all others should be called from it
 
-  void drawContour();
-  void intersect (math::ray const&, selection_result*);
+  //! \note fixed function, call outside of the terrain program
+  void draw_selected_triangle (int triangle);
+  //! \brief Add the nearest hit of the ray with the chunk's triangles.
+  //! \return whether the ray hits the chunk
+  bool intersect (math::ray const&, selection_result*);
   void drawLines ( opengl::scoped::use_program&
                  , math::frustum const& frustum
                  , const float& cull_distance
@@ -124,7 +144,7 @@ public:
   bool changeTerrain(math::vector_3d const& pos, float change, float radius, int BrushType, float inner_radius);
   bool flattenTerrain(math::vector_3d const& pos, float remain, float radius, int BrushType, int flattenType, const math::vector_3d& origin, math::degrees angle, math::degrees orientation);
   bool blurTerrain ( math::vector_3d const& pos, float remain, float radius, int BrushType
-                   , std::function<boost::optional<float> (float, float)> height
+                   , noggit::terrain_blur const& blur
                    );
 
   void selectVertex(math::vector_3d const& pos, float radius, std::set<math::vector_3d*>& vertices);
@@ -151,6 +171,7 @@ public:
   void setAreaID(int ID);
 
   bool GetVertex(float x, float z, math::vector_3d *V);
+  math::vector_3d* vertex_at(float x, float z);
   float getHeight(int x, int z);
   float getMinHeight();
 
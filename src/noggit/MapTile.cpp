@@ -1,6 +1,8 @@
 // This file is part of Noggit3, licensed under GNU General Public License (version 3).
 
+#include <noggit/AsyncLoader.h>
 #include <noggit/Log.h>
+#include <noggit/MPQ.h>
 #include <noggit/MapChunk.h>
 #include <noggit/MapTile.h>
 #include <noggit/Misc.h>
@@ -12,6 +14,7 @@
 #include <noggit/World.h>
 #include <noggit/alphamap.hpp>
 #include <noggit/map_index.hpp>
+#include <noggit/terrain_picking.hpp>
 #include <noggit/texture_set.hpp>
 #include <opengl/matrix.hpp>
 #include <opengl/scoped.hpp>
@@ -25,26 +28,45 @@
 #include <utility>
 #include <vector>
 
-MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, bool pLoadModels, World* world)
+MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, bool pLoadModels, World* world, bool pDeferred)
   : index(tile_index(pX, pZ))
   , xbase(pX * TILESIZE)
   , zbase(pZ * TILESIZE)
   , changed(0)
   , Water (this, xbase, zbase)
+  , mFlags(0)
   , mBigAlpha(pBigAlpha)
   , mFilename(pFilename)
+  , _world(world)
+  , _load_models(pLoadModels)
+  , _deferred(pDeferred)
+  , _objects_placed(false)
+  , _chunks_uploaded(0)
 {
-  MPQFile theFile(mFilename);
+  if (!_deferred)
+  {
+    finishLoading();
+    finish_chunks (256);
+  }
+}
+
+MapTile::~MapTile()
+{
+  // a worker may still be parsing this tile
+  if (_deferred)
+  {
+    AsyncLoader::getInstance()->removeObject (this);
+  }
+}
+
+void MapTile::finishLoading()
+{
+  MPQFile theFile (mFilename);
 
   Log << "Opening tile " << index.x << ", " << index.z << " (\"" << mFilename << "\") from " << (theFile.isExternal() ? "disk" : "MPQ") << "." << std::endl;
 
   // - Parsing the file itself. --------------------------
 
-  // We store this data to load it at the end.
-  uint32_t lMCNKOffsets[256];
-  std::vector<ENTRY_MDDF> lModelInstances;
-  std::vector<ENTRY_MODF> lWMOInstances;
-
   uint32_t fourcc;
   uint32_t size;
 
@@ -79,9 +101,11 @@ MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, b
 
   assert(fourcc == 'MCIN');
 
+  uint32_t mcnk_offsets[256];
+
   for (int i = 0; i < 256; ++i)
   {
-    theFile.read(&lMCNKOffsets[i], 4);
+    theFile.read(&mcnk_offsets[i], 4);
     theFile.seekRelative(0xC);
   }
 
@@ -104,7 +128,7 @@ MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, b
     }
   }
 
-  if (pLoadModels)
+  if (_load_models)
   {
     // - MMDX ----------------------------------------------
 
@@ -153,10 +177,7 @@ MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, b
     assert(fourcc == 'MDDF');
 
     ENTRY_MDDF const* mddf_ptr = reinterpret_cast<ENTRY_MDDF const*>(theFile.getPointer());
-    for (unsigned int i = 0; i < size / sizeof(ENTRY_MDDF); ++i)
-    {
-      lModelInstances.push_back(mddf_ptr[i]);
-    }
+    _model_instances.assign (mddf_ptr, mddf_ptr + size / sizeof(ENTRY_MDDF));
 
     // - MODF ----------------------------------------------
 
@@ -167,10 +188,7 @@ MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, b
     assert(fourcc == 'MODF');
 
     ENTRY_MODF const* modf_ptr = reinterpret_cast<ENTRY_MODF const*>(theFile.getPointer());
-    for (unsigned int i = 0; i < size / sizeof(ENTRY_MODF); ++i)
-    {
-      lWMOInstances.push_back(modf_ptr[i]);
-    }
+    _wmo_instances.assign (modf_ptr, modf_ptr + size / sizeof(ENTRY_MODF));
   }
 
   // - MISC ----------------------------------------------
@@ -178,7 +196,10 @@ MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, b
   //! \todo  Parse all chunks in the new style!
 
   // - MH2O ----------------------------------------------
-  if (Header.mh2o != 0) {
+
+  //! \note the liquid layers are created from it in finish_chunks()
+  if (Header.mh2o != 0)
+  {
     theFile.seek(Header.mh2o + 0x14);
     theFile.read(&fourcc, 4);
     theFile.read(&size, 4);
@@ -186,7 +207,7 @@ MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, b
     int ofsW = Header.mh2o + 0x14 + 0x8;
     assert(fourcc == 'MH2O');
 
-    Water.readFromFile(theFile, ofsW);
+    _water_data = TileWater::read(theFile, ofsW);
   }
 
   // - MFBO ----------------------------------------------
@@ -246,43 +267,107 @@ MapTile::MapTile(int pX, int pZ, const std::string& pFilename, bool pBigAlpha, b
 
   }*/
 
+  // - Load chunks ---------------------------------------
+
+  //! \note uploaded in finish_chunks()
+  for (int i = 0; i < 256; ++i)
+  {
+    theFile.seek(mcnk_offsets[i]);
+    mChunks[i / 16][i % 16] = std::make_unique<MapChunk> (this, &theFile, mBigAlpha);
+  }
+
+  theFile.close();
+
   // - Done. ---------------------------------------------
 
-  // - Load textures -------------------------------------
+  finished = true;
+}
 
-  //! \note We no longer pre load textures but the chunks themselves do.
+std::size_t MapTile::finish_chunks (std::size_t chunk_budget)
+{
+  assert (finishedLoading());
 
-  if (pLoadModels)
+  if (!_objects_placed)
   {
+    // - MH2O ----------------------------------------------
 
-    // - Load WMOs -----------------------------------------
-
-    for (auto const& object : lWMOInstances)
+    if (!_water_data.empty())
     {
-      world->mWMOInstances.emplace(object.uniqueID, WMOInstance(mWMOFilenames[object.nameID], &object));
+      Water.load(_water_data);
+      _water_data.clear();
     }
 
-    // - Load M2s ------------------------------------------
+    // - Load textures -------------------------------------
+
+    //! \note We no longer pre load textures but the chunks themselves do.
 
-    for (auto const& model : lModelInstances)
+    if (_load_models)
     {
-      world->mModelInstances.emplace(model.uniqueID, ModelInstance(mModelFilenames[model.nameID], &model));
+      // - Load WMOs -----------------------------------------
+
+      for (auto const& object : _wmo_instances)
+      {
+        auto const inserted (_world->mWMOInstances.emplace(object.uniqueID, WMOInstance(mWMOFilenames[object.nameID], &object)));
+        if (inserted.second)
+        {
+          _world->update_wmo_bounds(inserted.first->second);
+        }
+      }
+
+      // - Load M2s ------------------------------------------
+
+      for (auto const& model : _model_instances)
+      {
+        auto const inserted (_world->mModelInstances.emplace(model.uniqueID, ModelInstance(mModelFilenames[model.nameID], &model)));
+        if (inserted.second)
+        {
+          _world->update_model_bounds(inserted.first->second);
+        }
+      }
+
+      _wmo_instances.clear();
+      _model_instances.clear();
     }
+
+    _objects_placed = true;
   }
 
-  // - Load chunks ---------------------------------------
+  // - Upload chunks -------------------------------------
 
-  for (int nextChunk = 0; nextChunk < 256; ++nextChunk)
+  std::size_t const first_chunk (_chunks_uploaded);
+
+  for (; _chunks_uploaded < 256 && _chunks_uploaded - first_chunk < chunk_budget; ++_chunks_uploaded)
   {
-    theFile.seek(lMCNKOffsets[nextChunk]);
-    mChunks[nextChunk / 16][nextChunk % 16] = std::make_unique<MapChunk> (this, &theFile, mBigAlpha);
+    mChunks[_chunks_uploaded / 16][_chunks_uploaded % 16]->upload();
   }
 
-  theFile.close();
+  if (is_ready() && _chunks_uploaded != first_chunk)
+  {
+    // - Really done. --------------------------------------
+
+    LogDebug << "Done loading tile " << index.x << "," << index.z << "." << std::endl;
+  }
 
-  // - Really done. --------------------------------------
+  return _chunks_uploaded - first_chunk;
+}
+
+std::size_t MapTile::memory_usage()
+{
+  std::size_t bytes (sizeof (MapTile));
+
+  for (std::size_t i = 0; i < 256; ++i)
+  {
+    if (MapChunk* chunk = mChunks[i / 16][i % 16].get())
+    {
+      bytes += sizeof (MapChunk)
+             // vertices, normals and vertex colors are uploaded once more
+             + mapbufsize * 3 * sizeof (math::vector_3d)
+             // shadow and alpha maps
+             + 64 * 64 * (1 + chunk->_texture_set.num());
+    }
+  }
 
-  LogDebug << "Done loading tile " << index.x << "," << index.z << "." << std::endl;
+  return bytes;
 }
 
 bool MapTile::isTile(int pX, int pZ)
@@ -312,56 +397,42 @@ void MapTile::convert_alphamap(bool to_big_alpha)
   }
 }
 
-void MapTile::draw ( math::frustum const& frustum
-                   , const float& cull_distance
-                   , const math::vector_3d& camera
-                   , bool show_unpaintable_chunks
-                   , bool draw_contour
-                   , bool draw_paintability_overlay
-                   , bool draw_chunk_flag_overlay
-                   , bool draw_areaid_overlay
-                   , bool draw_wireframe_overlay
-                   , int cursor_type
-                   , std::map<int, misc::random_color>& area_id_colors
-                   , math::vector_4d shadow_color
-                   , boost::optional<selection_type> selection
-                   , int animtime
-                   )
+void MapTile::visible_chunks ( math::frustum const& frustum
+                             , const float& cull_distance
+                             , const math::vector_3d& camera
+                             , std::vector<MapChunk*>& chunks
+                             ) const
 {
-  gl.color4f(1, 1, 1, 1);
-
   for (int j = 0; j<16; ++j)
   {
     for (int i = 0; i<16; ++i)
     {
-      mChunks[j][i]->draw ( frustum
-                          , cull_distance
-                          , camera
-                          , show_unpaintable_chunks
-                          , draw_contour
-                          , draw_paintability_overlay
-                          , draw_chunk_flag_overlay
-                          , draw_areaid_overlay
-                          , draw_wireframe_overlay
-                          , cursor_type
-                          , area_id_colors
-                          , shadow_color
-                          , selection
-                          , animtime
-                          );
+      if (mChunks[j][i]->is_visible (cull_distance, frustum, camera))
+      {
+        chunks.emplace_back (mChunks[j][i].get());
+      }
     }
   }
 }
 
-void MapTile::intersect (math::ray const& ray, selection_result* results) const
+bool MapTile::intersect ( math::ray const& ray
+                        , float t_min
+                        , float t_max
+                        , selection_result* results
+                        ) const
 {
-  for (size_t j (0); j < 16; ++j)
-  {
-    for (size_t i (0); i < 16; ++i)
-    {
-      mChunks[j][i]->intersect (ray, results);
-    }
-  }
+  bool hit (false);
+
+  noggit::terrain_picking::walk_grid
+    ( ray, {xbase, 0.f, zbase}, CHUNKSIZE, 16, 16, t_min, t_max
+    , [&] (std::size_t x, std::size_t z, float, float)
+      {
+        hit = mChunks[z][x]->intersect (ray, results);
+        return hit;
+      }
+    );
+
+  return hit;
 }
 
 void MapTile::drawLines ( opengl::scoped::use_program& line_shader
@@ -512,30 +583,21 @@ bool MapTile::GetVertex(float x, float z, math::vector_3d *V)
   return xcol >= 0 && xcol <= 15 && ycol >= 0 && ycol <= 15 && mChunks[ycol][xcol]->GetVertex(x, z, V);
 }
 
-/// --- Only saving related below this line. --------------------------
-
-void MapTile::saveTile(bool saveAllModels, World* world)
+math::vector_3d* MapTile::vertex_at(float x, float z)
 {
+  int xcol = (int)((x - xbase) / CHUNKSIZE);
+  int ycol = (int)((z - zbase) / CHUNKSIZE);
 
-  Log << "Saving ADT \"" << mFilename << "\"." << std::endl;
-  LogDebug << "CHANGED FLAG " << changed << std::endl;
-  int lID;  // This is a global counting variable. Do not store something in here you need later.
+  return xcol >= 0 && xcol <= 15 && ycol >= 0 && ycol <= 15 ? mChunks[ycol][xcol]->vertex_at(x, z) : nullptr;
+}
 
-            // if wod output path is set creat also wod map files and save them in this alternate path.
-  bool wodSave = false;
-  std::string wodSavePath = "";
-  if (Settings::getInstance()->wodSavePath != "")
-  {
-    wodSave = true;
-    wodSavePath = Settings::getInstance()->wodSavePath;
-    LogDebug << "WOD Save path is set to : " << wodSavePath << std::endl;
-  }
+/// --- Only saving related below this line. --------------------------
 
+void MapTile::saveTile(bool saveAllModels, World* world)
+{
   std::vector<WMOInstance> lObjectInstances;
   std::vector<ModelInstance> lModelInstances;
 
-  // Collect some information we need later.
-
   // Check which doodads and WMOs are on this ADT.
   math::vector_3d lTileExtents[2];
   lTileExtents[0] = math::vector_3d(xbase, 0.0f, zbase);
@@ -558,6 +620,25 @@ void MapTile::saveTile(bool saveAllModels, World* world)
     }
   }
 
+  saveTile(world, lObjectInstances, lModelInstances);
+}
+
+void MapTile::saveTile(World* world, std::vector<WMOInstance>& lObjectInstances, std::vector<ModelInstance>& lModelInstances)
+{
+  Log << "Saving ADT \"" << mFilename << "\"." << std::endl;
+  LogDebug << "CHANGED FLAG " << changed << std::endl;
+  int lID;  // This is a global counting variable. Do not store something in here you need later.
+
+            // if wod output path is set creat also wod map files and save them in this alternate path.
+  bool wodSave = false;
+  std::string wodSavePath = "";
+  if (Settings::getInstance()->wodSavePath != "")
+  {
+    wodSave = true;
+    wodSavePath = Settings::getInstance()->wodSavePath;
+    LogDebug << "WOD Save path is set to : " << wodSavePath << std::endl;
+  }
+
   struct filenameOffsetThing
   {
     int nameID;
@@ -986,7 +1067,7 @@ void MapTile::saveTile(bool saveAllModels, World* world)
 
   {
     MPQFile f(mFilename);
-    f.setBuffer(lADTFile.data);
+    f.setBuffer(std::move(lADTFile.data));
     f.SaveFile();
   }
 
@@ -995,7 +1076,7 @@ void MapTile::saveTile(bool saveAllModels, World* world)
   {
     // ADT root file
     MPQFile f1 (mFilename, wodSavePath);
-    f1.setBuffer(lADTRootFile.data);
+    f1.setBuffer(std::move(lADTRootFile.data));
     f1.SaveFile();
     f1.close();
 
@@ -1012,7 +1093,7 @@ void MapTile::saveTile(bool saveAllModels, World* world)
     f2.close();
 
     MPQFile f3 (texFilename2.str(), wodSavePath);
-    f3.setBuffer(lADTTexFile.data);
+    f3.setBuffer(std::move(lADTTexFile.data));
     f3.SaveFile();
     f3.close();
 
@@ -1029,13 +1110,12 @@ void MapTile::saveTile(bool saveAllModels, World* world)
     f4.close();
 
     MPQFile f5 (objFilename2.str(), wodSavePath);
-    f5.setBuffer(lADTObjFile.data);
+    f5.setBuffer(std::move(lADTObjFile.data));
     f5.SaveFile();
     f5.close();
   }
 
-  lObjectInstances.clear();
-  lModelInstances.clear();
+  // the instances belong to the caller, they release their models there
   lModels.clear();
 }
 
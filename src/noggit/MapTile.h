@@ -3,6 +3,7 @@
 #pragma once
 
 #include <math/ray.hpp>
+#include <noggit/AsyncObject.h>
 #include <noggit/MapChunk.h>
 #include <noggit/MapHeaders.h>
 #include <noggit/Selection.h>
@@ -11,7 +12,9 @@
 #include <opengl/shader.fwd.hpp>
 #include <noggit/Misc.h>
 
+#include <cstddef>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -21,13 +24,32 @@ namespace math
   struct vector_3d;
 }
 
+class MPQFile;
 class World;
 
-class MapTile
+class MapTile : public AsyncObject
 {
 
 public:
-	MapTile(int x0, int z0, const std::string& pFilename, bool pBigAlpha, bool pLoadModels, World*);
+  //! \note a deferred tile is empty until finishLoading() parsed the file (on a
+  //!       loader thread) and finish_chunks() uploaded all chunks (on the render thread)
+	MapTile(int x0, int z0, const std::string& pFilename, bool pBigAlpha, bool pLoadModels, World*, bool pDeferred = false);
+  ~MapTile();
+
+  //! \brief Read and parse the ADT, including all chunks and the liquids.
+  //! Does not touch GL, the TextureManager or the world.
+  virtual void finishLoading() override;
+
+  //! \brief Place the objects and water, then upload up to chunk_budget chunks.
+  //! \note needs the GL context. returns the number of chunks uploaded.
+  std::size_t finish_chunks (std::size_t chunk_budget);
+
+  //! \brief all chunks are uploaded, the tile can be drawn and edited
+  bool is_ready() const { return _chunks_uploaded == 256; }
+
+  //! \brief Rough amount of RAM and VRAM held by this tile's chunks.
+  //! \note textures are shared between tiles and not accounted for
+  std::size_t memory_usage();
 
   //! \todo on destruction, unload ModelInstances and WMOInstances on this tile:
   // a) either keep up the information what tiles the instances are on at all times
@@ -58,22 +80,20 @@ public:
 
   int changed;
 
-  void draw ( math::frustum const& frustum
-            , const float& cull_distance
-            , const math::vector_3d& camera
-            , bool show_unpaintable_chunks
-            , bool draw_contour
-            , bool draw_paintability_overlay
-            , bool draw_chunk_flag_overlay
-            , bool draw_areaid_overlay
-            , bool draw_wireframe_overlay
-            , int cursor_type
-            , std::map<int, misc::random_color>& area_id_colors
-            , math::vector_4d shadow_color
-            , boost::optional<selection_type> selection
-            , int animtime
-            );
-  void intersect (math::ray const&, selection_result*) const;
+  //! \brief Append the chunks within cull_distance and the frustum.
+  void visible_chunks ( math::frustum const& frustum
+                      , const float& cull_distance
+                      , const math::vector_3d& camera
+                      , std::vector<MapChunk*>& chunks
+                      ) const;
+  //! \brief Add the nearest hit of the ray with the chunks it passes
+  //! between the distances t_min and t_max.
+  //! \return whether the ray hits the tile
+  bool intersect ( math::ray const&
+                 , float t_min
+                 , float t_max
+                 , selection_result*
+                 ) const;
   void drawLines ( opengl::scoped::use_program& line_shader
                  , math::frustum const& frustum
                  , const float& cull_distance
@@ -95,8 +115,13 @@ public:
   void drawMFBO (opengl::scoped::use_program&);
 
   bool GetVertex(float x, float z, math::vector_3d *V);
+  math::vector_3d* vertex_at(float x, float z);
 
   void saveTile(bool saveAllModels, World*);
+  //! \brief Serialize and write the tile with the given objects on it.
+  //! \note Only reads the tile and does not touch GL or the world's
+  //!       instances, so different tiles may be saved concurrently.
+  void saveTile(World*, std::vector<WMOInstance>& lObjectInstances, std::vector<ModelInstance>& lModelInstances);
 	void CropWater();
 
   bool isTile(int pX, int pZ);
@@ -126,6 +151,16 @@ private:
   std::unique_ptr<MapChunk> mChunks[16][16];
   std::vector<TileWater*> chunksLiquids; //map chunks liquids for old style water render!!! (Not MH2O)
 
+  // Parsed by finishLoading(), consumed by finish_chunks().
+  World* _world;
+  bool _load_models;
+  bool _deferred;
+  std::vector<chunk_water_data> _water_data;
+  std::vector<ENTRY_MDDF> _model_instances;
+  std::vector<ENTRY_MODF> _wmo_instances;
+  bool _objects_placed;
+  std::size_t _chunks_uploaded;
+
   friend class MapChunk;
   friend class TextureSet;
 };
@@ -11,9 +11,11 @@
 #include <noggit/Project.h>
 #include <noggit/Settings.h>
 #include <noggit/TextureManager.h> // TextureManager, Texture
+#include <noggit/WMO.h> // WMOManager
 #include <noggit/WMOInstance.h> // WMOInstance
 #include <noggit/World.h>
 #include <noggit/map_index.hpp>
+#include <noggit/shader_registry.hpp>
 #include <noggit/ui/CurrentTexture.h>
 #include <noggit/ui/CursorSwitcher.h> // cursor_switcher
 #include <noggit/ui/DetailInfos.h> // detailInfos
@@ -44,6 +46,7 @@
 
 #include <QtCore/QTimer>
 #include <QtGui/QKeyEvent>
+#include <QtGui/QOpenGLDebugLogger>
 #include <QtGui/QMouseEvent>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QMenuBar>
@@ -534,7 +537,13 @@ void MapView::createGUI()
                {
                  makeCurrent();
                  opengl::context::scoped_setter const _ (::gl, context());
-                 _world->mapIndex.saveChanged (_world.get());
+                 _world->mapIndex.saveChanged
+                   ( _world.get()
+                   , [this] (std::size_t saved, std::size_t total)
+                     {
+                       show_save_progress (saved, total);
+                     }
+                   );
                }
              );
   ADD_ACTION ( file_menu
@@ -544,7 +553,13 @@ void MapView::createGUI()
                {
                  makeCurrent();
                  opengl::context::scoped_setter const _ (::gl, context());
-                 _world->mapIndex.saveall (_world.get());
+                 _world->mapIndex.saveall
+                   ( _world.get()
+                   , [this] (std::size_t saved, std::size_t total)
+                     {
+                       show_save_progress (saved, total);
+                     }
+                   );
                }
              );
   ADD_ACTION ( file_menu
@@ -1224,6 +1239,8 @@ MapView::MapView( math::degrees camera_yaw0
   , _status_area (new QLabel (this))
   , _status_time (new QLabel (this))
   , _status_fps (new QLabel (this))
+  , _status_emitters (new QLabel (this))
+  , _status_gl_state (new QLabel (this))
   , _minimap (new noggit::ui::minimap_widget (nullptr))
   , _minimap_dock (new QDockWidget ("Minimap", this))
   , _cursor_switcher (new noggit::ui::cursor_switcher (this, cursor_color, cursor_type))
@@ -1259,6 +1276,18 @@ MapView::MapView( math::degrees camera_yaw0
           , _main_window
           , [=] { _main_window->statusBar()->removeWidget (_status_fps); }
           );
+  _main_window->statusBar()->addWidget (_status_emitters);
+  connect ( this
+          , &QObject::destroyed
+          , _main_window
+          , [=] { _main_window->statusBar()->removeWidget (_status_emitters); }
+          );
+  _main_window->statusBar()->addWidget (_status_gl_state);
+  connect ( this
+          , &QObject::destroyed
+          , _main_window
+          , [=] { _main_window->statusBar()->removeWidget (_status_gl_state); }
+          );
 
   _minimap->world (_world.get());
   _minimap->camera (&_camera);
@@ -1320,6 +1349,14 @@ MapView::MapView( math::degrees camera_yaw0
   connect (&_update_every_event_loop, &QTimer::timeout, [this] { update(); });
 }
 
+  void MapView::show_save_progress (std::size_t saved, std::size_t total)
+  {
+    _main_window->statusBar()->showMessage
+      (QString ("Saved %1 of %2 tiles").arg (saved).arg (total), 2000);
+    // the event loop is blocked until saving is done
+    _main_window->statusBar()->repaint();
+  }
+
   void MapView::move_camera_with_auto_height (math::vector_3d const& pos)
   {
     makeCurrent();
@@ -1351,6 +1388,12 @@ MapView::MapView( math::degrees camera_yaw0
   void MapView::initializeGL()
   {
     opengl::context::scoped_setter const _ (::gl, context());
+
+    if (opengl::context::validation_level() == opengl::context::validation::debug_output)
+    {
+      start_debug_output();
+    }
+
     gl.viewport(0.0f, 0.0f, width(), height());
 
     gl.clearColor (0.0f, 0.0f, 0.0f, 1.0f);
@@ -1377,6 +1420,35 @@ MapView::MapView( math::degrees camera_yaw0
     gl.enableClientState (GL_TEXTURE_COORD_ARRAY);
   }
 
+  void MapView::start_debug_output()
+  {
+    _debug_logger = std::make_unique<QOpenGLDebugLogger>();
+
+    if (!_debug_logger->initialize())
+    {
+      LogError << "GL: KHR_debug is not available, OpenGL errors will not be reported" << std::endl;
+      _debug_logger.reset();
+      return;
+    }
+
+    connect ( _debug_logger.get(), &QOpenGLDebugLogger::messageLogged
+            , [] (QOpenGLDebugMessage const& message)
+              {
+                if (message.severity() == QOpenGLDebugMessage::NotificationSeverity)
+                {
+                  LogDebug << "GL: " << message.message().toStdString() << std::endl;
+                }
+                else
+                {
+                  LogError << "GL: " << message.message().toStdString() << std::endl;
+                }
+              }
+            );
+
+    // synchronous, so a breakpoint in the handler shows the failing call
+    _debug_logger->startLogging (QOpenGLDebugLogger::SynchronousLogging);
+  }
+
   void MapView::paintGL()
   {
     {
@@ -1393,6 +1465,7 @@ MapView::MapView( math::degrees camera_yaw0
     {
       makeCurrent();
       opengl::context::scoped_setter const _ (::gl, context());
+      gl.reset_state_statistics();
       gl.clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
       //! \todo  Get this out or do it somehow else. This is ugly and is a senseless if each draw.
@@ -1419,6 +1492,26 @@ MapView::MapView( math::degrees camera_yaw0
         displayViewMode_3D();
         break;
       }
+
+      TextureManager::update();
+      ModelManager::update();
+      WMOManager::update();
+
+      opengl::state_cache::statistics const& state (gl.state_statistics());
+      _status_gl_state->setText
+        ( "GL state: " + QString::number (state.dropped()) + "/" + QString::number (state.calls)
+        + " redundant changes dropped, " + QString::number (state.queries) + " queries cached"
+        );
+      _status_gl_state->setToolTip
+        ( "enable: " + QString::number (state.enable)
+        + "\ndisable: " + QString::number (state.disable)
+        + "\nactiveTexture: " + QString::number (state.active_texture)
+        + "\nbindTexture: " + QString::number (state.bind_texture)
+        + "\nbindBuffer: " + QString::number (state.bind_buffer)
+        + "\nuseProgram: " + QString::number (state.use_program)
+        + "\nblendFunc: " + QString::number (state.blend_func)
+        + "\ndepthMask: " + QString::number (state.depth_mask)
+        );
     }
   }
 
@@ -1439,6 +1532,16 @@ MapView::~MapView()
   _minimap->hide();
 
   _world.reset();
+
+  // WMOs release their doodads and models their textures
+  WMOManager::clear_unused();
+  ModelManager::clear_unused();
+  TextureManager::clear_unused();
+
+  noggit::shader_registry::getInstance()->clear();
+
+  // stops logging, which needs the context
+  _debug_logger.reset();
 }
 
 void MapView::tick (float dt)
@@ -1456,6 +1559,8 @@ void MapView::tick (float dt)
 
   // start unloading tiles
   _world->mapIndex.enterTile (tile_index (_camera.position));
+  _world->mapIndex.prefetch (_camera.position, dt);
+  _world->mapIndex.upload_pending_tiles();
   _world->mapIndex.unloadTiles (tile_index (_camera.position));
 
   dt = std::min(dt, 1.0f);
@@ -1891,7 +1996,7 @@ void MapView::tick (float dt)
 
   _world->animtime += dt * 1000.0f;
 
-  _world->tick (dt);
+  _world->tick (dt, _camera.position);
 
   lastSelected = _world->GetCurrentSelection();
 
@@ -1986,6 +2091,9 @@ void MapView::tick (float dt)
     _status_fps->setText ("FPS: " + QString::number (int (1. / avg_frame_duration)));
   }
 
+  _status_emitters->setText
+    ("Emitters: " + QString::number (_world->emitter_update_time, 'f', 2) + " ms");
+
   guiWater->updatePos (_camera.position);
 
   {
@@ -29,6 +29,7 @@
 #endif
 
 
+class QOpenGLDebugLogger;
 class World;
 
 
@@ -239,6 +240,10 @@ private:
 
   std::unique_ptr<World> _world;
 
+  //! only with opengl::context::validation::debug_output
+  std::unique_ptr<QOpenGLDebugLogger> _debug_logger;
+  void start_debug_output();
+
   float _tablet_pressure;
   bool _tablet_active = false;
 #ifdef _WIN32
@@ -251,6 +256,8 @@ private:
   QLabel* _status_area;
   QLabel* _status_time;
   QLabel* _status_fps;
+  QLabel* _status_emitters;
+  QLabel* _status_gl_state;
 
   noggit::bool_toggle_property _locked_cursor_mode = {false};
   noggit::bool_toggle_property _move_model_to_cursor_position = {true};
@@ -268,6 +275,7 @@ private:
   QDockWidget* _minimap_dock;
 
   void move_camera_with_auto_height (math::vector_3d const&);
+  void show_save_progress (std::size_t saved, std::size_t total);
 
   std::unique_ptr<noggit::ui::cursor_switcher> _cursor_switcher;
   std::unique_ptr<noggit::ui::help> _keybindings;
@@ -4,11 +4,13 @@
 #include <noggit/Model.h>
 #include <noggit/TextureManager.h> // TextureManager, Texture
 #include <noggit/World.h>
+#include <noggit/geometry_arena.hpp>
 #include <opengl/matrix.hpp>
 #include <opengl/scoped.hpp>
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
 #include <map>
 #include <sstream>
 #include <string>
@@ -73,7 +75,19 @@ Model::~Model()
   _textures.clear();
   _textureFilenames.clear();
 
-  gl.deleteBuffers (1, &_vertices_buffer);
+  if (_finished_upload)
+  {
+    if (animGeometry)
+    {
+      gl.deleteBuffers (1, &_vertices_buffer);
+    }
+    else
+    {
+      noggit::vertex_arena::getInstance()->free (_vertices_range);
+    }
+
+    noggit::index_arena::getInstance()->free (_indices_range);
+  }
 }
 
 
@@ -412,8 +426,12 @@ void Model::initAnimated(const MPQFile& f)
   // particle systems
   if (header.nParticleEmitters) {
     ModelParticleEmitterDef const* pdefs = reinterpret_cast<ModelParticleEmitterDef const*>(f.getBuffer() + header.ofsParticleEmitters);
+    // the emitters point back to their system, it must not be moved
+    _particles.reserve (header.nParticleEmitters);
     for (size_t i = 0; i<header.nParticleEmitters; ++i) {
-      _particles.emplace_back (this, f, pdefs[i], _global_sequences.data());
+      _particles.emplace_back ( this, f, pdefs[i], _global_sequences.data()
+                              , static_cast<unsigned int> (std::hash<std::string>() (_filename) + i)
+                              );
     }
   }
 
@@ -441,19 +459,54 @@ void Model::initAnimated(const MPQFile& f)
   animcalc = false;
 }
 
-void Model::calcBones(int _anim, int time, int animtime)
+void Model::calcBones(int _anim, int time, int animtime, math::matrix_4x4 const& model_view)
 {
   for (size_t i = 0; i<header.nBones; ++i) {
     bones[i].calc = false;
   }
 
   for (size_t i = 0; i<header.nBones; ++i) {
-    bones[i].calcMatrix(bones.data(), _anim, time, animtime);
+    bones[i].calcMatrix(bones.data(), _anim, time, animtime, model_view);
   }
 }
 
 void Model::animate(int _anim, int animtime_)
 {
+  // skip reading back the model view if the result is already there
+  if (mPerInstanceAnimation || _animation_key != std::make_pair (_anim, animtime_))
+  {
+    prepare_animation (_anim, animtime_, opengl::matrix::model_view());
+  }
+
+  if (_skinned_vertices_changed && _finished_upload)
+  {
+    opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const binder (_vertices_buffer);
+    gl.bufferData (GL_ARRAY_BUFFER, _current_vertices.size() * sizeof (model_vertex), _current_vertices.data(), GL_STREAM_DRAW);
+
+    _skinned_vertices_changed = false;
+  }
+}
+
+void Model::prepare_animation (int _anim, int animtime_, math::matrix_4x4 const& model_view)
+{
+  if (!finishedLoading() || !animated)
+    return;
+
+  // instances and picking in the same frame all ask for the same time,
+  // billboarded bones also depend on the model view so can't be shared
+  if (mPerInstanceAnimation)
+  {
+    _animation_key = boost::none;
+  }
+  else if (_animation_key == std::make_pair (_anim, animtime_))
+  {
+    return;
+  }
+  else
+  {
+    _animation_key = std::make_pair (_anim, animtime_);
+  }
+
   this->anim = _anim;
   ModelAnimation &a = _animations[anim];
 
@@ -467,10 +520,27 @@ void Model::animate(int _anim, int animtime_)
   _global_animtime = animtime_;
 
   if (animBones) {
-    calcBones(anim, t, _global_animtime);
+    calcBones(anim, t, _global_animtime, model_view);
   }
 
   if (animGeometry) {
+    // the bones' transforms as rows of 3x4 matrices, weights folded in per vertex
+    std::vector<float> palette (bones.size() * 24);
+
+    for (size_t b (0); b < bones.size(); ++b)
+    {
+      float* matrices (&palette[b * 24]);
+
+      for (size_t row (0); row < 3; ++row)
+      {
+        for (size_t column (0); column < 4; ++column)
+        {
+          matrices[row * 4 + column] = bones[b].mat (row, column);
+          matrices[12 + row * 4 + column] = bones[b].mrot (row, column);
+        }
+      }
+    }
+
     // transform vertices
     _current_vertices.resize (header.nVertices);
 
@@ -479,27 +549,39 @@ void Model::animate(int _anim, int animtime_)
       model_vertex const& vertex (_vertices[i]);
       model_vertex_parameter const& param (_vertices_parameters[i]);
 
-      ::math::vector_3d v(0,0,0), n(0,0,0);
+      float v[3] = {0.f, 0.f, 0.f};
+      float n[3] = {0.f, 0.f, 0.f};
 
       for (size_t b (0); b < 4; ++b)
       {
         if (param.weights[b] <= 0)
           continue;
 
-        ::math::vector_3d tv = bones[param.bones[b]].mat * vertex.position;
-        ::math::vector_3d tn = bones[param.bones[b]].mrot * vertex.normal;
-
-        v += tv * (static_cast<float> (param.weights[b]) / 255.0f);
-        n += tn * (static_cast<float> (param.weights[b]) / 255.0f);
+        float const weight (static_cast<float> (param.weights[b]) / 255.0f);
+        float const* mat (&palette[param.bones[b] * 24]);
+        float const* mrot (mat + 12);
+
+        for (size_t row (0); row < 3; ++row)
+        {
+          v[row] += weight * ( mat[row * 4 + 0] * vertex.position.x
+                             + mat[row * 4 + 1] * vertex.position.y
+                             + mat[row * 4 + 2] * vertex.position.z
+                             + mat[row * 4 + 3]
+                             );
+          n[row] += weight * ( mrot[row * 4 + 0] * vertex.normal.x
+                             + mrot[row * 4 + 1] * vertex.normal.y
+                             + mrot[row * 4 + 2] * vertex.normal.z
+                             + mrot[row * 4 + 3]
+                             );
+        }
       }
 
-      _current_vertices[i].position = v;
-      _current_vertices[i].normal = n.normalize();
+      _current_vertices[i].position = {v[0], v[1], v[2]};
+      _current_vertices[i].normal = ::math::vector_3d (n[0], n[1], n[2]).normalize();
       _current_vertices[i].texcoords = vertex.texcoords;
     }
 
-    opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const binder (_vertices_buffer);
-    gl.bufferData (GL_ARRAY_BUFFER, _current_vertices.size() * sizeof (model_vertex), _current_vertices.data(), GL_STREAM_DRAW);
+    _skinned_vertices_changed = true;
   }
 
   for (size_t i=0; i<header.nLights; ++i) {
@@ -653,6 +735,9 @@ bool ModelRenderPass::init(Model *m)
       gl.pushMatrix();
 
       m->_texture_animations[texanim].setup(texanim);
+
+      // the instances' transforms are applied while the pass is active
+      gl.matrixMode(GL_MODELVIEW);
     }
 
     // color
@@ -689,6 +774,7 @@ void ModelRenderPass::deinit()
     gl.depthMask(GL_TRUE);
   }
   if (texanim != -1) {
+    gl.matrixMode(GL_TEXTURE);
     gl.popMatrix();
     gl.matrixMode(GL_MODELVIEW);
   }
@@ -841,7 +927,7 @@ Bone::Bone( const MPQFile& f,
   scale.apply(fixCoordSystem2);
 }
 
-void Bone::calcMatrix(Bone *allbones, int anim, int time, int animtime)
+void Bone::calcMatrix(Bone *allbones, int anim, int time, int animtime, math::matrix_4x4 const& model_view)
 {
   if (calc) return;
 
@@ -869,8 +955,7 @@ void Bone::calcMatrix(Bone *allbones, int anim, int time, int animtime)
 
     if (billboard)
     {
-      float modelview[16];
-      gl.getFloatv(GL_MODELVIEW_MATRIX, modelview);
+      float const* modelview (model_view);
 
       math::vector_3d vRight (modelview[0], modelview[4], modelview[8]);
       math::vector_3d vUp (modelview[1], modelview[5], modelview[9]); // Spherical billboarding
@@ -889,7 +974,7 @@ void Bone::calcMatrix(Bone *allbones, int anim, int time, int animtime)
 
   if (parent >= 0)
   {
-    allbones[parent].calcMatrix (allbones, anim, time, animtime);
+    allbones[parent].calcMatrix (allbones, anim, time, animtime, model_view);
     mat = allbones[parent].mat * m;
   }
   else
@@ -918,7 +1003,17 @@ void Bone::calcMatrix(Bone *allbones, int anim, int time, int animtime)
 }
 
 
+namespace
+{
+  std::vector<math::matrix_4x4> const in_place (1, math::matrix_4x4::unit);
+}
+
 void Model::draw (bool draw_fog, int animtime)
+{
+  draw (in_place, draw_fog, animtime);
+}
+
+void Model::draw (std::vector<math::matrix_4x4> const& transforms, bool draw_fog, int animtime)
 {
   if (!finishedLoading())
     return;
@@ -928,24 +1023,47 @@ void Model::draw (bool draw_fog, int animtime)
     return;
   }
 
-  if (draw_fog)
-    gl.enable(GL_FOG);
-  else
-    gl.disable(GL_FOG);
+  // billboarded bones face the camera as seen from the instance, so
+  // every instance has to be animated with its own model view
+  if (animated && mPerInstanceAnimation)
+  {
+    for (math::matrix_4x4 const& transform : transforms)
+    {
+      opengl::scoped::matrix_pusher const matrix;
+      gl.multMatrixf (transform);
 
-  if (animated && (!animcalc || mPerInstanceAnimation))
+      animate (0, animtime);
+      draw_instances (in_place, draw_fog);
+    }
+
+    animcalc = true;
+    return;
+  }
+
+  // all instances are animated with the same time, so once is enough
+  if (animated && (!animcalc || _skinned_vertices_changed))
   {
     animate(0, animtime);
     animcalc = true;
   }
 
-  lightsOn(GL_LIGHT4);
+  draw_instances (transforms, draw_fog);
+}
+
+void Model::draw_instances (std::vector<math::matrix_4x4> const& transforms, bool draw_fog)
+{
+  if (draw_fog)
+    gl.enable(GL_FOG);
+  else
+    gl.disable(GL_FOG);
 
   // assume these client states are enabled: GL_VERTEX_ARRAY, GL_NORMAL_ARRAY, GL_TEXTURE_COORD_ARRAY
   opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const binder (_vertices_buffer);
-  gl.vertexPointer (3, GL_FLOAT, sizeof (model_vertex), 0);
-  gl.normalPointer (GL_FLOAT, sizeof (model_vertex), reinterpret_cast<void*> (sizeof (::math::vector_3d)));
-  gl.texCoordPointer (2, GL_FLOAT, sizeof (model_vertex), reinterpret_cast<void*> (2 * sizeof (::math::vector_3d)));
+  gl.vertexPointer (3, GL_FLOAT, sizeof (model_vertex), _vertices_range.pointer());
+  gl.normalPointer (GL_FLOAT, sizeof (model_vertex), _vertices_range.pointer (sizeof (::math::vector_3d)));
+  gl.texCoordPointer (2, GL_FLOAT, sizeof (model_vertex), _vertices_range.pointer (2 * sizeof (::math::vector_3d)));
+
+  opengl::scoped::buffer_binder<GL_ELEMENT_ARRAY_BUFFER> const indices_binder (_indices_range.buffer);
 
   gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   gl.alphaFunc(GL_GREATER, 0.3f);
@@ -957,10 +1075,19 @@ void Model::draw (bool draw_fog, int animtime)
     // we don't want to render completely transparent parts
     if (p.init(this))
     {
-      //gl.drawElements(GL_TRIANGLES, p.indexCount, GL_UNSIGNED_SHORT, indices + p.indexStart);
-      // a GDC OpenGL Performace Tuning paper recommended gl.drawRangeElements over gl.drawElements
-      // I can't notice a difference but I guess it can't hurt
-      gl.drawRangeElements(GL_TRIANGLES, p.vertexStart, p.vertexEnd, p.indexCount, GL_UNSIGNED_SHORT, _indices.data() + p.indexStart);
+      for (math::matrix_4x4 const& transform : transforms)
+      {
+        opengl::scoped::matrix_pusher const matrix;
+        gl.multMatrixf (transform);
+
+        // the light positions are transformed by the instance's matrix
+        lightsOn(GL_LIGHT4);
+
+        //gl.drawElements(GL_TRIANGLES, p.indexCount, GL_UNSIGNED_SHORT, indices + p.indexStart);
+        // a GDC OpenGL Performace Tuning paper recommended gl.drawRangeElements over gl.drawElements
+        // I can't notice a difference but I guess it can't hurt
+        gl.drawRangeElements(GL_TRIANGLES, p.vertexStart, p.vertexEnd, p.indexCount, GL_UNSIGNED_SHORT, _indices_range.pointer (p.indexStart * sizeof (uint16_t)));
+      }
 
       p.deinit();
     }
@@ -979,11 +1106,20 @@ void Model::draw (bool draw_fog, int animtime)
   lightsOff(GL_LIGHT4);
 
   // draw particle systems & _ribbons
-  for (size_t i = 0; i < header.nParticleEmitters; ++i)
-    _particles[i].draw();
+  if (header.nParticleEmitters || header.nRibbonEmitters)
+  {
+    for (math::matrix_4x4 const& transform : transforms)
+    {
+      opengl::scoped::matrix_pusher const matrix;
+      gl.multMatrixf (transform);
+
+      for (size_t i = 0; i < header.nParticleEmitters; ++i)
+        _particles[i].draw();
 
-  for (size_t i = 0; i < header.nRibbonEmitters; ++i)
-    _ribbons[i].draw();
+      for (size_t i = 0; i < header.nRibbonEmitters; ++i)
+        _ribbons[i].draw();
+    }
+  }
 }
 
 std::vector<float> Model::intersect (math::ray const& ray, int animtime)
@@ -1014,6 +1150,15 @@ std::vector<float> Model::intersect (math::ray const& ray, int animtime)
   return results;
 }
 
+std::size_t Model::memory_usage() const
+{
+  return (_vertices.capacity() + _current_vertices.capacity()) * sizeof (model_vertex)
+       + _vertices_parameters.capacity() * sizeof (model_vertex_parameter)
+       + _indices.capacity() * sizeof (uint16_t)
+       + _vertices_range.size
+       + _indices_range.size;
+}
+
 void Model::lightsOn(opengl::light lbase)
 {
   // setup lights
@@ -1030,20 +1175,20 @@ void Model::upload()
   for (std::string texture : _textureFilenames)
     _textures.emplace_back(texture);
 
-  gl.genBuffers (1, &_vertices_buffer);
-
-  if (!animGeometry)
+  // animated geometry is rewritten every frame, so it keeps its own buffer
+  if (animGeometry)
   {
-    opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const binder (_vertices_buffer);
-    gl.bufferData (GL_ARRAY_BUFFER, _current_vertices.size() * sizeof (model_vertex), _current_vertices.data(), GL_STATIC_DRAW);
+    gl.genBuffers (1, &_vertices_buffer);
+  }
+  else
+  {
+    _vertices_range = noggit::vertex_arena::getInstance()->allocate
+      (_current_vertices.size() * sizeof (model_vertex), _current_vertices.data());
+    _vertices_buffer = _vertices_range.buffer;
   }
 
-  _finished_upload = true;
-}
+  _indices_range = noggit::index_arena::getInstance()->allocate
+    (_indices.size() * sizeof (uint16_t), _indices.data());
 
-void Model::updateEmitters(float dt)
-{
-  for (size_t i = 0; i<header.nParticleEmitters; ++i) {
-    _particles[i].update(dt);
-  }
+  _finished_upload = true;
 }
@@ -12,8 +12,12 @@
 #include <noggit/ModelHeaders.h>
 #include <noggit/Particle.h>
 #include <noggit/TextureManager.h>
+#include <noggit/geometry_arena.hpp>
+
+#include <boost/optional.hpp>
 
 #include <string>
+#include <utility>
 #include <vector>
 
 class Bone;
@@ -37,7 +41,7 @@ public:
   math::matrix_4x4 mrot = math::matrix_4x4::uninitialized;
 
   bool calc;
-  void calcMatrix(Bone* allbones, int anim, int time, int animtime);
+  void calcMatrix(Bone* allbones, int anim, int time, int animtime, math::matrix_4x4 const& model_view);
   Bone ( const MPQFile& f,
          const ModelBoneDef &b,
          int *global,
@@ -154,11 +158,29 @@ public:
   ~Model();
 
   void draw (bool draw_fog, int animtime);
+  //! \brief Draw one copy per transform, setting every render pass up
+  //! once for all of them instead of once per copy.
+  //! \note The transforms are column-major, as passed to glMultMatrixf.
+  //! \note Models with billboarded bones are animated and drawn one
+  //! instance at a time, as the bones depend on the instance's model view.
+  void draw (std::vector<math::matrix_4x4> const& transforms, bool draw_fog, int animtime);
   void drawTileMode();
 
   std::vector<float> intersect (math::ray const&, int animtime);
 
-  void updateEmitters(float dt);
+  //! \brief Approximate bytes of geometry held in memory and buffers.
+  std::size_t memory_usage() const;
+
+  //! \note updated by World::tick, every system on its own
+  std::vector<ParticleSystem>& particle_systems() { return _particles; }
+
+  //! \brief Compute the bones and skinned vertices for the given time
+  //! without touching GL. The result is kept until a different time is
+  //! asked for, so all instances and picking in a frame share it.
+  //! \note Not kept for models with billboarded bones, which depend on
+  //! each instance's model view and are animated when drawn instead.
+  //! \note may run for different models in parallel
+  void prepare_animation (int anim, int animtime, math::matrix_4x4 const& model_view);
 
   virtual void finishLoading();
 
@@ -197,7 +219,9 @@ private:
   void initAnimated(const MPQFile& f);
 
   void animate(int anim, int animtime);
-  void calcBones(int anim, int time, int animtime);
+  //! \note expects the model to be animated already
+  void draw_instances (std::vector<math::matrix_4x4> const& transforms, bool draw_fog);
+  void calcBones(int anim, int time, int animtime, math::matrix_4x4 const& model_view);
 
   void lightsOn(opengl::light lbase);
   void lightsOff(opengl::light lbase);
@@ -209,7 +233,10 @@ private:
   // ===============================
   // Geometry
   // ===============================
+  //! \note the shared arena's buffer, or an own one for animated geometry
   GLuint _vertices_buffer;
+  noggit::arena_range _vertices_range;
+  noggit::arena_range _indices_range;
 
   std::vector<model_vertex> _vertices;
   std::vector<model_vertex> _current_vertices;
@@ -226,6 +253,9 @@ private:
   bool animated;
   bool animGeometry, animTextures, animBones;
 
+  boost::optional<std::pair<int, int>> _animation_key;
+  bool _skinned_vertices_changed = false;
+
   std::vector<ParticleSystem> _particles;
   std::vector<RibbonEmitter> _ribbons;
 
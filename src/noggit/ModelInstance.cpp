@@ -50,36 +50,39 @@ ModelInstance::ModelInstance(std::string const& filename, ENTRY_MDDF const*d)
   recalcExtents();
 }
 
-void ModelInstance::draw ( math::frustum const& frustum
-                         , const float& cull_distance
-                         , const math::vector_3d& camera
-                         , bool force_box
-                         , bool all_boxes
-                         , bool draw_fog
-                         , bool is_current_selection
-                         , int animtime
-                         )
+bool ModelInstance::is_visible ( math::frustum const& frustum
+                               , const float& cull_distance
+                               , const math::vector_3d& camera
+                               ) const
 {
-  if(((pos - camera).length() - model->rad * scale) >= cull_distance)
-    return;
+  return ((pos - camera).length() - model->rad * scale) < cull_distance
+      && frustum.intersectsSphere(pos, model->rad * scale);
+}
+
+math::matrix_4x4 ModelInstance::transform_matrix() const
+{
+  return math::matrix_4x4 (math::matrix_4x4::translation, pos)
+       * math::matrix_4x4 ( math::matrix_4x4::rotation_yzx
+                          , { math::degrees (-dir.z)
+                            , math::degrees (dir.y - 90.0f)
+                            , math::degrees (dir.x)
+                            }
+                          )
+       * math::matrix_4x4 (math::matrix_4x4::scale, scale);
+}
 
-  if (!frustum.intersectsSphere(pos, model->rad * scale))
+void ModelInstance::draw_box ( bool force_box
+                             , bool all_boxes
+                             , bool draw_fog
+                             , bool is_current_selection
+                             )
+{
+  if (!all_boxes && !is_current_selection && !force_box)
     return;
 
   opengl::scoped::matrix_pusher const matrix;
 
-  math::matrix_4x4 const model_matrix
-    ( math::matrix_4x4 (math::matrix_4x4::translation, pos)
-    * math::matrix_4x4 ( math::matrix_4x4::rotation_yzx
-                       , { math::degrees (-dir.z)
-                         , math::degrees (dir.y - 90.0f)
-                         , math::degrees (dir.x)
-                         }
-                       )
-    * math::matrix_4x4 (math::matrix_4x4::scale, scale)
-    );
-
-  gl.multMatrixf (model_matrix.transposed());
+  gl.multMatrixf (transform_matrix().transposed());
 
   if (all_boxes)
   {
@@ -87,7 +90,6 @@ void ModelInstance::draw ( math::frustum const& frustum
                                  , TransformCoordsForModel(model->header.VertexBoxMax)
                                  ).draw ({0.5f, 0.5f, 0.5f, 1.0f}, 1.0f);
   }
-  model->draw (draw_fog, animtime);
 
   if (is_current_selection || force_box)
   {
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <math/matrix_4x4.hpp>
 #include <math/ray.hpp>
 #include <math/vector_3d.hpp> // math::vector_3d
 #include <noggit/MPQ.h> // MPQFile
@@ -68,15 +69,20 @@ public:
     return *this;
   }
 
-  void draw ( math::frustum const& frustum
-            , const float& cull_distance
-            , const math::vector_3d& camera
-            , bool force_box
-            , bool all_boxes
-            , bool draw_fog
-            , bool is_current_selection
-            , int animtime
-            );
+  bool is_visible ( math::frustum const& frustum
+                  , const float& cull_distance
+                  , const math::vector_3d& camera
+                  ) const;
+  //! \brief model space to world space, row-major
+  math::matrix_4x4 transform_matrix() const;
+
+  //! \note the model itself is drawn batched with the other instances of
+  //! the same model, see Model::draw
+  void draw_box ( bool force_box
+                , bool all_boxes
+                , bool draw_fog
+                , bool is_current_selection
+                );
   void drawMapTile();
   //  void drawHighlight();
   void intersect ( math::ray const&
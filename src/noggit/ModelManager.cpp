@@ -4,30 +4,40 @@
 #include <noggit/Log.h> // LogDebug
 #include <noggit/Model.h> // Model
 #include <noggit/ModelManager.h> // ModelManager
+#include <noggit/Settings.h>
 
 #include <algorithm>
 
 namespace
 {
-  std::string normalized_filename (std::string filename)
+  void normalized_filename (boost::string_ref filename, std::string& normalized)
   {
-    filename = noggit::mpq::normalized_filename (filename);
+    noggit::mpq::normalize_filename (filename, normalized);
 
     std::size_t found;
-    if ((found = filename.rfind (".mdx")) != std::string::npos)
+    if ((found = normalized.rfind (".mdx")) != std::string::npos)
     {
-      filename.replace(found, 4, ".m2");
+      normalized.replace (found, 4, ".m2");
     }
-    else if ((found = filename.rfind (".mdl")) != std::string::npos)
+    else if ((found = normalized.rfind (".mdl")) != std::string::npos)
     {
-      filename.replace(found, 4, ".m2");
+      normalized.replace (found, 4, ".m2");
     }
-
-    return filename;
   }
 }
 
-decltype (ModelManager::_) ModelManager::_ {normalized_filename};
+decltype (ModelManager::_) ModelManager::_
+  { normalized_filename
+    // the loader may still be filling in a model that isn't finished
+  , [] (Model const& model) -> boost::optional<std::size_t>
+    {
+      if (!model.finishedLoading())
+      {
+        return boost::none;
+      }
+      return model.memory_usage();
+    }
+  };
 
 void ModelManager::report()
 {
@@ -37,23 +47,29 @@ void ModelManager::report()
               output += " - " + key + "\n";
             }
           );
+  output += "Unused: " + std::to_string (_.unused_elements()) + " models, "
+          + std::to_string (_.unused_bytes() >> 20) + " MiB, "
+          + std::to_string (_.revives()) + " revived, "
+          + std::to_string (_.evictions()) + " evictions\n";
   LogDebug << output;
 }
 
-void ModelManager::resetAnim()
+void ModelManager::update()
 {
-  _.apply ( [&] (std::string const&, Model& model)
-            {
-              model.animcalc = false;
-            }
-          );
+  _.unused_budget
+    (std::size_t (std::max (Settings::getInstance()->unusedAssetBudget, 0)) << 20);
 }
 
-void ModelManager::updateEmitters(float dt)
+void ModelManager::clear_unused()
+{
+  _.clear_unused();
+}
+
+void ModelManager::resetAnim()
 {
   _.apply ( [&] (std::string const&, Model& model)
             {
-              model.updateEmitters (dt);
+              model.animcalc = false;
             }
           );
 }
@@ -15,10 +15,15 @@ class ModelManager
 {
 public:
   static void resetAnim();
-  static void updateEmitters(float dt);
 
   static void report();
 
+  //! \brief Apply Settings::unusedAssetBudget, call once per frame.
+  static void update();
+  //! \brief Destroy the models kept after their last reference, with the
+  //! context they were uploaded to still current.
+  static void clear_unused();
+
 private:
   friend struct scoped_model_reference;
   static noggit::multimap_with_normalized_key<Model> _;
@@ -27,59 +32,52 @@ private:
 struct scoped_model_reference
 {
   scoped_model_reference (std::string const& filename)
-    : _valid (true)
-    , _filename (filename)
-    , _model (ModelManager::_.emplace (_filename))
+    : _entry (ModelManager::_.acquire (filename))
   {}
 
   scoped_model_reference (scoped_model_reference const& other)
-    : _valid (other._valid)
-    , _filename (other._filename)
-    , _model (ModelManager::_.emplace (_filename))
-  {}
+    : _entry (other._entry)
+  {
+    if (_entry)
+    {
+      ModelManager::_.add_reference (_entry);
+    }
+  }
   scoped_model_reference& operator= (scoped_model_reference const& other)
   {
-    _valid = other._valid;
-    _filename = other._filename;
-    _model = ModelManager::_.emplace (_filename);
+    scoped_model_reference copy (other);
+    std::swap (_entry, copy._entry);
     return *this;
   }
 
   scoped_model_reference (scoped_model_reference&& other)
-    : _valid (other._valid)
-    , _filename (other._filename)
-    , _model (other._model)
+    : _entry (other._entry)
   {
-    other._valid = false;
+    other._entry = nullptr;
   }
   scoped_model_reference& operator= (scoped_model_reference&& other)
   {
-    std::swap (_valid, other._valid);
-    std::swap (_filename, other._filename);
-    std::swap (_model, other._model);
-    other._valid = false;
+    std::swap (_entry, other._entry);
     return *this;
   }
 
   ~scoped_model_reference()
   {
-    if (_valid)
+    if (_entry)
     {
-      ModelManager::_.erase (_filename);
+      ModelManager::_.release (_entry);
     }
   }
 
   Model* operator->() const
   {
-    return _model;
+    return get();
   }
   Model* get() const
   {
-    return _model;
+    return _entry ? &_entry->value : nullptr;
   }
 
 private:
-  bool _valid;
-  std::string _filename;
-  Model* _model;
+  noggit::multimap_with_normalized_key<Model>::entry* _entry;
 };
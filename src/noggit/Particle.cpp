@@ -4,18 +4,59 @@
 #include <noggit/Particle.h>
 #include <opengl/context.hpp>
 
-#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
 
 static const unsigned int MAX_PARTICLES = 10000;
 
-template<class T>
-T lifeRamp(float life, float mid, const T &a, const T &b, const T &c)
+namespace
 {
-  if (life <= mid) return math::interpolation::linear(life / mid, a, b);
-  else return math::interpolation::linear((life - mid) / (1.0f - mid), b, c);
+  struct particle_vertex
+  {
+    math::vector_3d position;
+    math::vector_2d texcoord;
+    math::vector_4d color;
+  };
+
+  //! \note all particle systems draw through the same buffer, it's
+  //! orphaned on every upload so drivers don't stall on the previous draw
+  GLuint particle_buffer()
+  {
+    static GLuint const buffer
+      ( []
+        {
+          GLuint buffer;
+          gl.genBuffers (1, &buffer);
+          return buffer;
+        }()
+      );
+    return buffer;
+  }
+
+  //! \note reused between draws to not allocate every frame
+  std::vector<particle_vertex> particle_vertices;
+
+  // same as misc::frand and friends, but drawing from the emitter's own
+  // engine: emitters update in parallel and stay reproducible
+  float frand (std::minstd_rand& random)
+  {
+    return (random() - random.min()) / static_cast<float> (random.max() - random.min());
+  }
+
+  float randfloat (std::minstd_rand& random, float lower, float upper)
+  {
+    return lower + (upper - lower) * frand (random);
+  }
+
+  int randint (std::minstd_rand& random, int lower, int upper)
+  {
+    return lower + static_cast<int> ((upper + 1 - lower) * frand (random));
+  }
 }
 
-ParticleSystem::ParticleSystem(Model* model_, const MPQFile& f, const ModelParticleEmitterDef &mta, int *globals)
+ParticleSystem::ParticleSystem(Model* model_, const MPQFile& f, const ModelParticleEmitterDef &mta, int *globals, unsigned int seed)
   : model (model_)
   , emitter ( mta.EmitterType == 1 ? std::unique_ptr<ParticleEmitter> (std::make_unique<PlaneParticleEmitter> (this))
             : mta.EmitterType == 2 ? std::unique_ptr<ParticleEmitter> (std::make_unique<SphereParticleEmitter> (this))
@@ -36,6 +77,7 @@ ParticleSystem::ParticleSystem(Model* model_, const MPQFile& f, const ModelParti
   , slowdown (mta.p.slowdown)
   , pos (fixCoordSystem(mta.pos))
   , _texture (model->_textures[mta.texture])
+  , particles (MAX_PARTICLES)
   , blend (mta.blend)
   , order (mta.ParticleType > 0 ? -1 : 0)
   , type (mta.ParticleType)
@@ -46,7 +88,8 @@ ParticleSystem::ParticleSystem(Model* model_, const MPQFile& f, const ModelParti
   , billboard (!(mta.flags & 4096))
   , rem(0)
   , parent (&model->bones[mta.bone])
-  , tofs (misc::frand())
+  , _random (seed)
+  , tofs (frand (_random))
 {
   math::vector_3d colors2[3];
   memcpy(colors2, f.getBuffer() + mta.p.colors.ofsKeys, sizeof(math::vector_3d) * 3);
@@ -110,11 +153,11 @@ void ParticleSystem::update(float dt)
     else {
       int tospawn = (int)ftospawn;
 
-      if ((tospawn + particles.size()) > MAX_PARTICLES) // Error check to prevent the program from trying to load insane amounts of particles.
-        tospawn = particles.size() - MAX_PARTICLES;
-
       rem = ftospawn - static_cast<float>(tospawn);
 
+      // Error check to prevent the program from trying to load insane amounts of particles.
+      tospawn = std::min (tospawn, static_cast<int> (particles.free()));
+
 
       float w = areal.getValue(manim, mtime, manimtime) * 0.5f;
       float l = areaw.getValue(manim, mtime, manimtime) * 0.5f;
@@ -129,38 +172,18 @@ void ParticleSystem::update(float dt)
       //rem = 0;
       if (en) {
         for (int i = 0; i<tospawn; ++i) {
-          Particle p = emitter->newParticle(manim, mtime, manimtime, w, l, spd, var, spr, spr2);
-          // sanity check:
-          //if (particles.size() < MAX_PARTICLES) // No need to check this every loop iteration. Already checked above.
-          particles.push_back(p);
+          particles.spawn (emitter->newParticle(manim, mtime, manimtime, w, l, spd, var, spr, spr2));
         }
       }
     }
   }
 
-  float mspeed = 1.0f;
-
-  for (ParticleList::iterator it = particles.begin(); it != particles.end();) {
-    Particle &p = *it;
-    p.speed += p.down * grav * dt - p.dir * deaccel * dt;
+  noggit::particle_pool::life_ramp ramp;
+  ramp.mid = mid;
+  std::copy (sizes, sizes + 3, ramp.sizes);
+  std::copy (colors, colors + 3, ramp.colors);
 
-    if (slowdown>0) {
-      mspeed = expf(-1.0f * slowdown * p.life);
-    }
-    p.pos += p.speed * mspeed * dt;
-
-    p.life += dt;
-    float rlife = p.life / p.maxlife;
-    // calculate size and color based on lifetime
-    p.size = lifeRamp<float>(rlife, mid, sizes[0], sizes[1], sizes[2]);
-    p.color = lifeRamp<math::vector_4d>(rlife, mid, colors[0], colors[1], colors[2]);
-
-    // kill off old particles
-    if (rlife >= 1.0f)
-      particles.erase(it);
-
-    ++it;
-  }
+  particles.integrate (dt, grav, deaccel, slowdown, ramp);
 }
 
 void ParticleSystem::setup(int anim, int time, int animtime)
@@ -306,89 +329,115 @@ void ParticleSystem::draw()
   * 1  large quad from the particle's origin to its position (used in Moonwell water effects)
   * 2  seems to be the same as 0 (found some in the Deeprun Tram blinky-lights-sign thing)
   */
-  if (type == 0 || type == 2) {
-    //! \todo figure out type 2 (deeprun tram subway sign)
-    // - doesn't seem to be any different from 0 -_-
-    // regular particles
-
-    if (billboard) {
-      gl.begin(GL_QUADS);
-      //! \todo per-particle rotation in a non-expensive way?? :|
-      for (ParticleList::iterator it = particles.begin(); it != particles.end(); ++it) {
-        if (tiles.size() - 1 < it->tile) // Alfred, 2009.08.07, error prevent
-          break;
-        const float size = it->size;// / 2;
-        gl.color4fv(it->color);
-
-        gl.texCoord2fv(tiles[it->tile].tc[0]);
-        gl.vertex3fv(it->pos - (vRight + vUp) * size);
-
-        gl.texCoord2fv(tiles[it->tile].tc[1]);
-        gl.vertex3fv(it->pos + (vRight - vUp) * size);
-
-        gl.texCoord2fv(tiles[it->tile].tc[2]);
-        gl.vertex3fv(it->pos + (vRight + vUp) * size);
-
-        gl.texCoord2fv(tiles[it->tile].tc[3]);
-        gl.vertex3fv(it->pos - (vRight - vUp) * size);
+  particle_vertices.clear();
+  particle_vertices.reserve (particles.size() * 4);
+
+  auto const add_quad
+    ( [&] ( std::size_t i
+          , math::vector_3d const& a
+          , math::vector_3d const& b
+          , math::vector_3d const& c
+          , math::vector_3d const& d
+          )
+      {
+        math::vector_2d const* const tc (tiles[particles.tile[i]].tc);
+        math::vector_4d const color ( particles.r[i], particles.g[i]
+                                    , particles.b[i], particles.a[i]
+                                    );
+
+        particle_vertices.push_back ({a, tc[0], color});
+        particle_vertices.push_back ({b, tc[1], color});
+        particle_vertices.push_back ({c, tc[2], color});
+        particle_vertices.push_back ({d, tc[3], color});
       }
-      gl.end();
-
-    }
-    else {
-      gl.begin(GL_QUADS);
-      for (ParticleList::iterator it = particles.begin(); it != particles.end(); ++it) {
-        if (tiles.size() - 1 < it->tile) // Alfred, 2009.08.07, error prevent
-          break;
-        gl.color4fv(it->color);
-
-        gl.texCoord2fv(tiles[it->tile].tc[0]);
-        gl.vertex3fv(it->pos + it->corners[0] * it->size);
-
-        gl.texCoord2fv(tiles[it->tile].tc[1]);
-        gl.vertex3fv(it->pos + it->corners[1] * it->size);
-
-        gl.texCoord2fv(tiles[it->tile].tc[2]);
-        gl.vertex3fv(it->pos + it->corners[2] * it->size);
-
-        gl.texCoord2fv(tiles[it->tile].tc[3]);
-        gl.vertex3fv(it->pos + it->corners[3] * it->size);
+    );
+
+  for (std::size_t i (0); i < particles.size(); ++i) {
+    if (particles.tile[i] >= tiles.size()) // Alfred, 2009.08.07, error prevent
+      continue;
+
+    math::vector_3d const pos (particles.pos[i]);
+    float const size (particles.scale[i]);
+
+    if (type == 0 || type == 2) {
+      //! \todo figure out type 2 (deeprun tram subway sign)
+      // - doesn't seem to be any different from 0 -_-
+      // regular particles
+      if (billboard) {
+        //! \todo per-particle rotation in a non-expensive way?? :|
+        add_quad ( i
+                 , pos - (vRight + vUp) * size
+                 , pos + (vRight - vUp) * size
+                 , pos + (vRight + vUp) * size
+                 , pos - (vRight - vUp) * size
+                 );
+      }
+      else {
+        auto const& corners (particles.corners[i]);
+        add_quad ( i
+                 , pos + corners[0] * size
+                 , pos + corners[1] * size
+                 , pos + corners[2] * size
+                 , pos + corners[3] * size
+                 );
       }
-      gl.end();
+    }
+    else if (type == 1) { // Sphere particles
+      // particles from origin to position
+      /*
+      bv0 = mbb * math::vector_3d(0,-1.0f,0);
+      bv1 = mbb * math::vector_3d(0,+1.0f,0);
+
+
+      bv0 = mbb * math::vector_3d(-1.0f,0,0);
+      bv1 = mbb * math::vector_3d(1.0f,0,0);
+      */
+      math::vector_3d const origin (particles.origin[i]);
+      add_quad ( i
+               , pos + bv0 * size
+               , pos + bv1 * size
+               , origin + bv1 * size
+               , origin + bv0 * size
+               );
     }
   }
-  else if (type == 1) { // Sphere particles
-    // particles from origin to position
-    /*
-    bv0 = mbb * math::vector_3d(0,-1.0f,0);
-    bv1 = mbb * math::vector_3d(0,+1.0f,0);
-
-
-    bv0 = mbb * math::vector_3d(-1.0f,0,0);
-    bv1 = mbb * math::vector_3d(1.0f,0,0);
-    */
 
-    gl.begin(GL_QUADS);
-    for (ParticleList::iterator it = particles.begin(); it != particles.end(); ++it) {
-      if (tiles.size() - 1 < it->tile) // Alfred, 2009.08.07, error prevent
-        break;
-      gl.color4fv(it->color);
-
-      gl.texCoord2fv(tiles[it->tile].tc[0]);
-      gl.vertex3fv(it->pos + bv0 * it->size);
-
-      gl.texCoord2fv(tiles[it->tile].tc[1]);
-      gl.vertex3fv(it->pos + bv1 * it->size);
-
-      gl.texCoord2fv(tiles[it->tile].tc[2]);
-      gl.vertex3fv(it->origin + bv1 * it->size);
-
-      gl.texCoord2fv(tiles[it->tile].tc[3]);
-      gl.vertex3fv(it->origin + bv0 * it->size);
-    }
-    gl.end();
+  if (particle_vertices.empty()) {
+    return;
+  }
 
+  GLuint const buffer (particle_buffer());
+  gl.bufferData<GL_ARRAY_BUFFER> ( buffer
+                                 , particle_vertices.size() * sizeof (particle_vertex)
+                                 , particle_vertices.data()
+                                 , GL_STREAM_DRAW
+                                 );
+
+  // particles have no normals, the model's normal array must not be read
+  bool const normal_array (gl.isEnabled (GL_NORMAL_ARRAY));
+  if (normal_array) {
+    gl.disableClientState (GL_NORMAL_ARRAY);
+  }
+  gl.enableClientState (GL_COLOR_ARRAY);
+
+  gl.vertexPointer ( buffer, 3, GL_FLOAT, sizeof (particle_vertex)
+                   , reinterpret_cast<GLvoid const*> (offsetof (particle_vertex, position))
+                   );
+  gl.texCoordPointer ( buffer, 2, GL_FLOAT, sizeof (particle_vertex)
+                     , reinterpret_cast<GLvoid const*> (offsetof (particle_vertex, texcoord))
+                     );
+  gl.colorPointer ( buffer, 4, GL_FLOAT, sizeof (particle_vertex)
+                  , reinterpret_cast<GLvoid const*> (offsetof (particle_vertex, color))
+                  );
+
+  gl.drawArrays (GL_QUADS, 0, particle_vertices.size());
+
+  gl.disableClientState (GL_COLOR_ARRAY);
+  if (normal_array) {
+    gl.enableClientState (GL_NORMAL_ARRAY);
   }
+  // the current colour is undefined after drawing with a colour array
+  gl.color4f (1.0f, 1.0f, 1.0f, 1.0f);
   //}
 
   //gl.enable(GL_LIGHTING);
@@ -400,15 +449,15 @@ void ParticleSystem::draw()
 namespace
 {
   //Generates the rotation matrix based on spread
-  math::matrix_4x4 CalcSpreadMatrix(float Spread1, float Spread2, float w, float l)
+  math::matrix_4x4 CalcSpreadMatrix(std::minstd_rand& random, float Spread1, float Spread2, float w, float l)
   {
     int i, j;
     float a[2], c[2], s[2];
 
     math::matrix_4x4 SpreadMat (math::matrix_4x4::unit);
 
-    a[0] = misc::randfloat(-Spread1, Spread1) / 2.0f;
-    a[1] = misc::randfloat(-Spread2, Spread2) / 2.0f;
+    a[0] = randfloat(random, -Spread1, Spread1) / 2.0f;
+    a[1] = randfloat(random, -Spread2, Spread2) / 2.0f;
 
     /*SpreadMat.m[0][0]*=l;
     SpreadMat.m[1][1]*=l;
@@ -493,12 +542,12 @@ Particle PlaneParticleEmitter::newParticle(int anim, int time, int animtime, flo
   Particle p;
 
   //Spread Calculation
-  auto mrot = sys->parent->mrot*CalcSpreadMatrix(spr, spr, 1.0f, 1.0f);
+  auto mrot = sys->parent->mrot*CalcSpreadMatrix(sys->_random, spr, spr, 1.0f, 1.0f);
 
   if (sys->flags == 1041) { // Trans Halo
-    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(misc::randfloat(-l, l), 0, misc::randfloat(-w, w)));
+    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(randfloat(sys->_random, -l, l), 0, randfloat(sys->_random, -w, w)));
 
-    const float t = misc::randfloat(0.0f, 2.0f * (float)math::constants::pi);
+    const float t = randfloat(sys->_random, 0.0f, 2.0f * (float)math::constants::pi);
 
     p.pos = math::vector_3d(0.0f, sys->pos.y + 0.15f, sys->pos.z) + math::vector_3d(cos(t) / 8, 0.0f, sin(t) / 8); // Need to manually correct for the halo - why?
 
@@ -508,10 +557,10 @@ Particle PlaneParticleEmitter::newParticle(int anim, int time, int animtime, flo
     math::vector_3d dir(0.0f, 1.0f, 0.0f);
     p.dir = dir;
 
-    p.speed = dir.normalize() * spd * misc::randfloat(0, var);
+    p.speed = dir.normalize() * spd * randfloat(sys->_random, 0, var);
   }
   else if (sys->flags == 25 && sys->parent->parent<1) { // Weapon Flame
-    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(misc::randfloat(-l, l), misc::randfloat(-l, l), misc::randfloat(-w, w)));
+    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(randfloat(sys->_random, -l, l), randfloat(sys->_random, -l, l), randfloat(sys->_random, -w, w)));
     math::vector_3d dir = mrot * math::vector_3d(0.0f, 1.0f, 0.0f);
     p.dir = dir.normalize();
     //math::vector_3d dir = sys->model->bones[sys->parent->parent].mrot * sys->parent->mrot * math::vector_3d(0.0f, 1.0f, 0.0f);
@@ -519,19 +568,19 @@ Particle PlaneParticleEmitter::newParticle(int anim, int time, int animtime, flo
 
   }
   else if (sys->flags == 25 && sys->parent->parent > 0) { // Weapon with built-in Flame (Avenger lightsaber!)
-    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(misc::randfloat(-l, l), misc::randfloat(-l, l), misc::randfloat(-w, w)));
+    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(randfloat(sys->_random, -l, l), randfloat(sys->_random, -l, l), randfloat(sys->_random, -w, w)));
     math::vector_3d dir = math::vector_3d(sys->parent->mat (1, 0), sys->parent->mat (1, 1), sys->parent->mat (1, 2)) + math::vector_3d(0.0f, 1.0f, 0.0f);
-    p.speed = dir.normalize() * spd * misc::randfloat(0, var * 2);
+    p.speed = dir.normalize() * spd * randfloat(sys->_random, 0, var * 2);
 
   }
   else if (sys->flags == 17 && sys->parent->parent<1) { // Weapon Glow
-    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(misc::randfloat(-l, l), misc::randfloat(-l, l), misc::randfloat(-w, w)));
+    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(randfloat(sys->_random, -l, l), randfloat(sys->_random, -l, l), randfloat(sys->_random, -w, w)));
     math::vector_3d dir = mrot * math::vector_3d(0, 1, 0);
     p.dir = dir.normalize();
 
   }
   else {
-    p.pos = sys->pos + math::vector_3d(misc::randfloat(-l, l), 0, misc::randfloat(-w, w));
+    p.pos = sys->pos + math::vector_3d(randfloat(sys->_random, -l, l), 0, randfloat(sys->_random, -w, w));
     p.pos = sys->parent->mat * p.pos;
 
     //math::vector_3d dir = mrot * math::vector_3d(0,1,0);
@@ -539,7 +588,7 @@ Particle PlaneParticleEmitter::newParticle(int anim, int time, int animtime, flo
 
     p.dir = dir;//.normalize();
     p.down = math::vector_3d(0, -1.0f, 0); // dir * -1.0f;
-    p.speed = dir.normalize() * spd * (1.0f + misc::randfloat(-var, var));
+    p.speed = dir.normalize() * spd * (1.0f + randfloat(sys->_random, -var, var));
   }
 
   if (!sys->billboard)  {
@@ -554,7 +603,7 @@ Particle PlaneParticleEmitter::newParticle(int anim, int time, int animtime, flo
 
   p.origin = p.pos;
 
-  p.tile = misc::randint(0, sys->rows*sys->cols - 1);
+  p.tile = randint(sys->_random, 0, sys->rows*sys->cols - 1);
   return p;
 }
 
@@ -564,7 +613,7 @@ Particle SphereParticleEmitter::newParticle(int anim, int time, int animtime, fl
   math::vector_3d dir;
   float radius;
 
-  radius = misc::randfloat(0, 1);
+  radius = randfloat(sys->_random, 0, 1);
 
   // Old method
   //float t = misc::randfloat(0,2*math::constants::pi);
@@ -573,12 +622,12 @@ Particle SphereParticleEmitter::newParticle(int anim, int time, int animtime, fl
   // Spread should never be zero for sphere particles ?
   math::radians t (0);
   if (spr == 0)
-    t._ = misc::randfloat((float)-math::constants::pi, (float)math::constants::pi);
+    t._ = randfloat(sys->_random, (float)-math::constants::pi, (float)math::constants::pi);
   else
-    t._ = misc::randfloat(-spr, spr);
+    t._ = randfloat(sys->_random, -spr, spr);
 
   //Spread Calculation
-  auto mrot =  sys->parent->mrot*CalcSpreadMatrix(spr * 2, spr2 * 2, w, l);
+  auto mrot =  sys->parent->mrot*CalcSpreadMatrix(sys->_random, spr * 2, spr2 * 2, w, l);
 
   // New
   // Length should never technically be zero ?
@@ -596,11 +645,11 @@ Particle SphereParticleEmitter::newParticle(int anim, int time, int animtime, fl
 
 
   float theta_range = sys->spread.getValue(anim, time, animtime);
-  float theta = -0.5f* theta_range + misc::randfloat(0, theta_range);
+  float theta = -0.5f* theta_range + randfloat(sys->_random, 0, theta_range);
   math::vector_3d bdir(0, l*math::cos(theta), w*math::sin(theta));
 
   float phi_range = sys->lat.getValue(anim, time, animtime);
-  float phi = misc::randfloat(0, phi_range);
+  float phi = randfloat(sys->_random, 0, phi_range);
   rotate(0,0, &bdir.z, &bdir.x, phi);
   */
 
@@ -614,7 +663,7 @@ Particle SphereParticleEmitter::newParticle(int anim, int time, int animtime, fl
       p.speed = math::vector_3d(0, 0, 0);
     else {
       dir = sys->parent->mrot * (bdir.normalize());//mrot * math::vector_3d(0, 1.0f,0);
-      p.speed = dir.normalize() * spd * (1.0f + misc::randfloat(-var, var));   // ?
+      p.speed = dir.normalize() * spd * (1.0f + randfloat(sys->_random, -var, var));   // ?
     }
 
   }
@@ -646,7 +695,7 @@ Particle SphereParticleEmitter::newParticle(int anim, int time, int animtime, fl
       else
         dir = bdir.normalize();
 
-      p.speed = dir.normalize() * spd * (1.0f + misc::randfloat(-var, var));   // ?
+      p.speed = dir.normalize() * spd * (1.0f + randfloat(sys->_random, -var, var));   // ?
     }
   }
 
@@ -658,7 +707,7 @@ Particle SphereParticleEmitter::newParticle(int anim, int time, int animtime, fl
 
   p.origin = p.pos;
 
-  p.tile = misc::randint(0, sys->rows*sys->cols - 1);
+  p.tile = randint(sys->_random, 0, sys->rows*sys->cols - 1);
   return p;
 }
 
@@ -712,19 +761,13 @@ void RibbonEmitter::setup(int anim, int time, int animtime)
 
   // kill stuff from the end
   float l = 0;
-  bool erasemode = false;
-  for (std::list<RibbonSegment>::iterator it = segs.begin(); it != segs.end();) {
-    if (!erasemode) {
-      l += it->len;
-      if (l > length) {
-        it->len = l - length;
-        erasemode = true;
-      }
-    }
-    else {
-      segs.erase(it);
+  for (std::size_t i = 0; i < segs.size(); ++i) {
+    l += segs[i].len;
+    if (l > length) {
+      segs[i].len = l - length;
+      segs.erase(segs.begin() + i + 1, segs.end());
+      break;
     }
-    ++it;
   }
 
   tpos = ntpos;
@@ -761,7 +804,7 @@ void RibbonEmitter::draw()
   gl.color4fv(tcolor);
 
   gl.begin(GL_QUAD_STRIP);
-  std::list<RibbonSegment>::iterator it = segs.begin();
+  auto it = segs.begin();
   float l = 0;
   for (; it != segs.end(); ++it) {
     float u = l / length;
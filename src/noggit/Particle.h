@@ -5,9 +5,11 @@
 #include <noggit/Animated.h> // Animation::M2Value
 #include <noggit/Model.h>
 #include <noggit/TextureManager.h>
+#include <noggit/particle_pool.hpp>
 
-#include <list>
+#include <deque>
 #include <memory>
+#include <random>
 #include <vector>
 
 class Bone;
@@ -15,17 +17,6 @@ class Model;
 class ParticleSystem;
 class RibbonEmitter;
 
-struct Particle {
-  math::vector_3d pos, speed, down, origin, dir;
-  math::vector_3d  corners[4];
-  //math::vector_3d tpos;
-  float size, life, maxlife;
-  unsigned int tile;
-  math::vector_4d color;
-};
-
-typedef std::list<Particle> ParticleList;
-
 class ParticleEmitter {
 protected:
   ParticleSystem *sys;
@@ -61,7 +52,7 @@ class ParticleSystem {
   float mid, slowdown;
   math::vector_3d pos;
   scoped_blp_texture_reference _texture;
-  ParticleList particles;
+  noggit::particle_pool particles;
   int blend, order, type;
   int manim, mtime;
   int manimtime;
@@ -77,10 +68,14 @@ class ParticleSystem {
   Bone *parent;
   int32_t flags;
 
+  //! \note seeded per emitter, so spawning doesn't depend on which thread
+  //! updates which emitter in what order
+  std::minstd_rand _random;
+
 public:
   float tofs;
 
-  ParticleSystem(Model*, const MPQFile& f, const ModelParticleEmitterDef &mta, int *globals);
+  ParticleSystem(Model*, const MPQFile& f, const ModelParticleEmitterDef &mta, int *globals, unsigned int seed);
   void update(float dt);
 
   void setup(int anim, int time, int animtime);
@@ -121,7 +116,7 @@ class RibbonEmitter {
 
   scoped_blp_texture_reference _texture;
 
-  std::list<RibbonSegment> segs;
+  std::deque<RibbonSegment> segs;
 
 public:
   RibbonEmitter(Model*, const MPQFile &f, ModelRibbonEmitterDef const& mta, int *globals);
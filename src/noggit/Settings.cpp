@@ -21,8 +21,12 @@ void Settings::readFromDisk()
     this->random_tilt = false;
     this->mapDrawDistance = 998.0f;
     this->FarZ = 1024;
+    this->tileCacheSize = 1024;
+    this->textureBudget = 512;
+    this->unusedAssetBudget = 256;
     this->_noAntiAliasing = false;
     this->tabletMode = false;
+    this->openglValidation = "none";
     this->importFile = "Import.txt";
 
     std::string configPath = Native::getConfigPath();
@@ -40,9 +44,13 @@ void Settings::readFromDisk()
         config.readInto(this->projectPath, "ProjectPath");
         config.readInto(this->mapDrawDistance, "mapDrawDistance");
         config.readInto(this->FarZ, "FarZ");
+        config.readInto(this->tileCacheSize, "tileCacheSize");
+        config.readInto(this->textureBudget, "textureBudget");
+        config.readInto(this->unusedAssetBudget, "unusedAssetBudget");
         config.readInto(_noAntiAliasing, "noAntiAliasing");
         config.readInto(this->wodSavePath, "wodSavePath");
         config.readInto(this->tabletMode, "TabletMode");
+        config.readInto(this->openglValidation, "openglValidation");
         config.readInto(this->importFile, "ImportFile");
         config.readInto(this->wmvLogFile, "wmvLogFile");
         config.readInto(this->random_tilt, "randomTilt");
@@ -103,10 +111,14 @@ bool Settings::saveToDisk()
     config.add("wmvLogFile", this->wmvLogFile);
     config.add("mapDrawDistance", this->mapDrawDistance);
     config.add("FarZ", this->FarZ);
+    config.add("tileCacheSize", this->tileCacheSize);
+    config.add("textureBudget", this->textureBudget);
+    config.add("unusedAssetBudget", this->unusedAssetBudget);
     config.add("randomRotation", this->random_rotation);
     config.add("randomTilt", this->random_tilt);
     config.add("randomSize", this->random_size);
     config.add("TabletMode", this->tabletMode);
+    config.add("openglValidation", this->openglValidation);
 
     std::ofstream file(configPath);
 
@@ -18,8 +18,12 @@ public:
 
   int FarZ;        // the far clipping value
   float mapDrawDistance;
+  int tileCacheSize;      // MiB of map tiles kept loaded before the least recently used get unloaded
+  int textureBudget;      // MiB of video memory for full resolution textures before the least recently used drop to a placeholder
+  int unusedAssetBudget;  // MiB each of models, WMOs and textures kept after their last use, so loading them again is free
 
   bool tabletMode;
+  std::string openglValidation; // none, sampled, full or debug_output, see opengl::context::validation
 
   struct mysql_connection_info
   {
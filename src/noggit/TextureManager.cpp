@@ -2,6 +2,8 @@
 
 #include <noggit/TextureManager.h>
 #include <noggit/Log.h> // LogDebug
+#include <noggit/MPQ.h>
+#include <noggit/Settings.h>
 #include <opengl/context.hpp>
 #include <opengl/scoped.hpp>
 
@@ -12,20 +14,83 @@
 #include <QtOpenGL/QGLPixelBuffer>
 
 #include <algorithm>
+#include <string>
+#include <utility>
+
+namespace
+{
+  //! \note levels at most this large are uploaded when a texture is created
+  int const placeholder_size (64);
+  //! \note streamed levels are uploaded until this is exceeded in a frame
+  std::size_t const upload_bytes_per_frame (16 << 20);
+}
 
-decltype (TextureManager::_) TextureManager::_;
+decltype (TextureManager::_residency) TextureManager::_residency (0);
+decltype (TextureManager::_) TextureManager::_
+  { &noggit::mpq::normalize_filename
+    // the loader may still be decoding the streamed levels. Once they are
+    // decoded or uploaded, or were never requested, the texture can be kept
+  , [] (blp_texture const& texture) -> boost::optional<std::size_t>
+    {
+      if (texture.loading())
+      {
+        return boost::none;
+      }
+      return texture.resident_bytes();
+    }
+  };
+std::size_t TextureManager::_frame (0);
+std::size_t TextureManager::_uploaded_bytes (0);
 
 void TextureManager::report()
 {
   std::string output = "Still in the Texture manager:\n";
-  _.apply ( [&] (std::string const& key, blp_texture const&)
+  _.apply ( [&] (std::string const& key, blp_texture const& texture)
             {
-              output += " - " + key + "\n";
+              output += " - " + key
+                      + (texture.fully_resident() ? " (full, " : " (placeholder, ")
+                      + std::to_string (texture.resident_bytes() / 1024) + " KiB)\n";
             }
           );
+  output += "Streamed: " + std::to_string (_residency.resident_textures())
+          + " textures, " + std::to_string (_residency.resident_bytes() >> 20)
+          + " of " + std::to_string (_residency.budget() >> 20) + " MiB, "
+          + std::to_string (_residency.evictions()) + " evictions\n";
+  output += "Unused: " + std::to_string (_.unused_elements()) + " textures, "
+          + std::to_string (_.unused_bytes() >> 20) + " MiB, "
+          + std::to_string (_.revives()) + " revived, "
+          + std::to_string (_.evictions()) + " evictions\n";
   LogDebug << output;
 }
 
+void TextureManager::update()
+{
+  ++_frame;
+  _uploaded_bytes = 0;
+
+  _residency.budget
+    (std::size_t (std::max (Settings::getInstance()->textureBudget, 0)) << 20);
+  _.unused_budget
+    (std::size_t (std::max (Settings::getInstance()->unusedAssetBudget, 0)) << 20);
+
+  // the textures of the frame just drawn would be streamed in right again
+  for ( std::string const& name
+      : _residency.evict ( [] (std::string const& name)
+                           {
+                             return _.find (name)->last_used_frame() + 1 >= _frame;
+                           }
+                         )
+      )
+  {
+    _.find (name)->drop_streamed_levels();
+  }
+}
+
+void TextureManager::clear_unused()
+{
+  _.clear_unused();
+}
+
 #include <cstdint>
 //! \todo Cross-platform syntax for packed structs.
 #pragma pack(push,1)
@@ -44,38 +109,68 @@ struct BLPHeader
 };
 #pragma pack(pop)
 
-#include <boost/thread.hpp>
-#include <noggit/MPQ.h>
+#include <noggit/AsyncLoader.h>
+
+int blp_texture::level_width (int level) const
+{
+  return std::max (1, original_width >> level);
+}
+
+int blp_texture::level_height (int level) const
+{
+  return std::max (1, original_height >> level);
+}
 
-void blp_texture::loadFromUncompressedData(BLPHeader const* lHeader, char const* lData)
+std::size_t blp_texture::level_bytes (int level) const
 {
-  unsigned int const* pal = reinterpret_cast<unsigned int const*>(lData + sizeof(BLPHeader));
+  int const width (level_width (level));
+  int const height (level_height (level));
+
+  return _compressed ? std::size_t ((width + 3) / 4) * ((height + 3) / 4) * _blocksize
+                     : std::size_t (width) * height * 4;
+}
 
-  unsigned char const* buf;
-  unsigned int *buf2 = new unsigned int[_width*_height];
-  unsigned int *p;
-  unsigned char const* c;
-  unsigned char const* a;
+std::size_t blp_texture::resident_bytes() const
+{
+  std::size_t bytes (0);
+  for (int level (_base_level); level < _levels; ++level)
+  {
+    bytes += level_bytes (level);
+  }
+  return bytes;
+}
 
-  int alphabits = lHeader->attr_1_alphadepth;
-  bool hasalpha = alphabits != 0;
+std::vector<blp_texture::mip_level> blp_texture::decode
+  (BLPHeader const* lHeader, char const* lData, int first, int last) const
+{
+  std::vector<mip_level> levels;
 
-  for (int i = 0; i<16; ++i)
+  for (int i = first; i < last; ++i)
   {
-    _width = std::max(1, _width);
-    _height = std::max(1, _height);
+    mip_level level {level_width (i), level_height (i), std::vector<char> (level_bytes (i))};
 
-    if (lHeader->offsets[i] && lHeader->sizes[i])
+    if (_compressed)
     {
-      buf = reinterpret_cast<unsigned char const*>(&lData[lHeader->offsets[i]]);
+      std::copy ( lData + lHeader->offsets[i]
+                , lData + lHeader->offsets[i] + level.data.size()
+                , level.data.begin()
+                );
+    }
+    else
+    {
+      unsigned int const* pal = reinterpret_cast<unsigned int const*>(lData + sizeof(BLPHeader));
+
+      int alphabits = lHeader->attr_1_alphadepth;
+      bool hasalpha = alphabits != 0;
+
+      unsigned char const* c = reinterpret_cast<unsigned char const*>(&lData[lHeader->offsets[i]]);
+      unsigned char const* a = c + level.width*level.height;
+      unsigned int* p = reinterpret_cast<unsigned int*> (level.data.data());
 
       int cnt = 0;
-      p = buf2;
-      c = buf;
-      a = buf + _width*_height;
-      for (int y = 0; y<_height; y++)
+      for (int y = 0; y<level.height; y++)
       {
-        for (int x = 0; x<_width; x++)
+        for (int x = 0; x<level.width; x++)
         {
           unsigned int k = pal[*c++];
           k = ((k & 0x00FF0000) >> 16) | ((k & 0x0000FF00)) | ((k & 0x000000FF) << 16);
@@ -101,50 +196,23 @@ void blp_texture::loadFromUncompressedData(BLPHeader const* lHeader, char const*
           *p++ = k;
         }
       }
-
-      gl.texImage2D(GL_TEXTURE_2D, i, GL_RGBA8, _width, _height, 0, GL_RGBA, GL_UNSIGNED_BYTE, buf2);
-
-    }
-    else
-    {
-      return;
     }
 
-    _width >>= 1;
-    _height >>= 1;
+    levels.emplace_back (std::move (level));
   }
 
-  delete[] buf2;
+  return levels;
 }
 
-void blp_texture::loadFromCompressedData(BLPHeader const* lHeader, char const* lData)
+void blp_texture::upload (int level, mip_level const& data)
 {
-  //                         0 (0000) & 3 == 0                1 (0001) & 3 == 1                    7 (0111) & 3 == 3
-  const int alphatypes[] = { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT };
-  const int blocksizes[] = { 8, 16, 0, 16 };
-
-  int lTempAlphatype = lHeader->attr_2_alphatype & 3;
-  GLint format = alphatypes[lTempAlphatype];
-  int blocksize = blocksizes[lTempAlphatype];
-  format = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? (lHeader->attr_1_alphadepth == 1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT) : format;
-
-  // do every mipmap level
-  for (int i = 0; i < 16; ++i)
+  if (_compressed)
   {
-    _width = std::max(1, _width);
-    _height = std::max(1, _height);
-
-    if (lHeader->offsets[i] && lHeader->sizes[i])
-    {
-      gl.compressedTexImage2D(GL_TEXTURE_2D, i, format, _width, _height, 0, ((_width + 3) / 4) * ((_height + 3) / 4) * blocksize, reinterpret_cast<char const*>(lData + lHeader->offsets[i]));
-    }
-    else
-    {
-      return;
-    }
-
-    _width >>= 1;
-    _height >>= 1;
+    gl.compressedTexImage2D(GL_TEXTURE_2D, level, _format, data.width, data.height, 0, data.data.size(), data.data.data());
+  }
+  else
+  {
+    gl.texImage2D(GL_TEXTURE_2D, level, GL_RGBA8, data.width, data.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data.data());
   }
 }
 
@@ -153,12 +221,12 @@ const std::string& blp_texture::filename()
   return _filename;
 }
 
-blp_texture::blp_texture(const std::string& filenameArg)
+blp_texture::blp_texture(const std::string& filenameArg, bool streamed)
 {
   //! \todo Unload if there already is a model loaded?
   _filename = filenameArg;
 
-  bind();
+  opengl::texture::bind();
 
   MPQFile f(_filename);
   if (f.isEof())
@@ -169,29 +237,154 @@ blp_texture::blp_texture(const std::string& filenameArg)
 
   char const* lData = f.getPointer();
   BLPHeader const* lHeader = reinterpret_cast<BLPHeader const*>(lData);
-  _width = original_width = lHeader->resx;
-  _height = original_height = lHeader->resy;
+  original_width = lHeader->resx;
+  original_height = lHeader->resy;
 
   if (lHeader->attr_0_compression == 1)
   {
-    loadFromUncompressedData(lHeader, lData);
+    _compressed = false;
+    _format = GL_RGBA8;
+    _blocksize = 0;
   }
   else if (lHeader->attr_0_compression == 2)
   {
-    loadFromCompressedData(lHeader, lData);
+    //                         0 (0000) & 3 == 0                1 (0001) & 3 == 1                    7 (0111) & 3 == 3
+    const int alphatypes[] = { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT };
+    const int blocksizes[] = { 8, 16, 0, 16 };
+
+    int lTempAlphatype = lHeader->attr_2_alphatype & 3;
+    _compressed = true;
+    _format = alphatypes[lTempAlphatype];
+    _blocksize = blocksizes[lTempAlphatype];
+    _format = _format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? (lHeader->attr_1_alphadepth == 1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT) : _format;
   }
   else
   {
     throw std::logic_error ("unimplemented BLP colorEncoding");
   }
 
+  // the mip chain ends at the first missing level
+  while (_levels < 16 && lHeader->offsets[_levels] && lHeader->sizes[_levels])
+  {
+    ++_levels;
+  }
+
+  if (streamed)
+  {
+    while ( _placeholder_level + 1 < _levels
+         && std::max (level_width (_placeholder_level), level_height (_placeholder_level)) > placeholder_size
+          )
+    {
+      ++_placeholder_level;
+    }
+  }
+  _base_level = _placeholder_level;
+
+  std::vector<mip_level> const levels (decode (lHeader, lData, _placeholder_level, _levels));
+  for (std::size_t i = 0; i < levels.size(); ++i)
+  {
+    upload (_placeholder_level + i, levels[i]);
+  }
 
   f.close();
 
+  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, _base_level);
+  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, std::max (0, _levels - 1));
   gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
+blp_texture::~blp_texture()
+{
+  if (_requested)
+  {
+    AsyncLoader::getInstance()->removeObject (this);
+  }
+
+  // unstreamed textures may share the name of a managed one, e.g. previews
+  if (_placeholder_level > 0)
+  {
+    TextureManager::_residency.erase (_filename);
+  }
+}
+
+void blp_texture::finishLoading()
+{
+  MPQFile f(_filename);
+
+  char const* lData = f.getPointer();
+  _streamed_levels = decode (reinterpret_cast<BLPHeader const*>(lData), lData, 0, _placeholder_level);
+
+  f.close();
+
+  finished = true;
+}
+
+void blp_texture::bind()
+{
+  opengl::texture::bind();
+
+  if (_last_used_frame != TextureManager::_frame)
+  {
+    _last_used_frame = TextureManager::_frame;
+    TextureManager::_residency.touch (_filename);
+  }
+
+  if (_base_level == 0)
+  {
+    return;
+  }
+
+  if (!finishedLoading())
+  {
+    if (!_requested)
+    {
+      _requested = true;
+      AsyncLoader::getInstance()->addObject (this);
+    }
+    return;
+  }
+
+  if (TextureManager::_uploaded_bytes > upload_bytes_per_frame)
+  {
+    return;
+  }
+
+  std::size_t bytes (0);
+  for (std::size_t i = 0; i < _streamed_levels.size(); ++i)
+  {
+    upload (i, _streamed_levels[i]);
+    bytes += _streamed_levels[i].data.size();
+  }
+
+  _base_level = 0;
+  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, _base_level);
+
+  TextureManager::_uploaded_bytes += bytes;
+  TextureManager::_residency.insert (_filename, bytes);
+
+  _streamed_levels = std::vector<mip_level>();
+  _requested = false;
+  finished = false;
+}
+
+void blp_texture::drop_streamed_levels()
+{
+  if (_base_level == 0 && _placeholder_level > 0)
+  {
+    opengl::texture::bind();
+
+    _base_level = _placeholder_level;
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, _base_level);
+
+    // an empty image releases the level's storage
+    for (int level = 0; level < _placeholder_level; ++level)
+    {
+      gl.texImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+  }
+}
+
 namespace noggit
 {
   QPixmap render_blp_to_pixmap ( std::string const& blp_filename
@@ -216,13 +409,15 @@ namespace noggit
     opengl::context::scoped_setter const context_set (::gl, &context);
 
     opengl::scoped::texture_setter<0, GL_TRUE> const texture0;
-    blp_texture const texture (blp_filename);
+    blp_texture const texture (blp_filename, false);
 
     width = width == -1 ? texture.width() : width;
     height = height == -1 ? texture.height() : height;
 
     QOpenGLFramebufferObject pixel_buffer (width, height, fmt);
     pixel_buffer.bind();
+    // creating the framebuffer object binds its texture
+    gl.invalidate_state_cache();
 
     gl.viewport (0, 0, width, height);
     gl.matrixMode (GL_PROJECTION);
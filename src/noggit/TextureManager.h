@@ -2,102 +2,163 @@
 
 #pragma once
 
+#include <noggit/AsyncObject.h>
 #include <noggit/multimap_with_normalized_key.hpp>
+#include <noggit/texture_residency.hpp>
 #include <opengl/texture.hpp>
 
+#include <cstddef>
 #include <map>
 #include <string>
 #include <vector>
 
 struct BLPHeader;
 
-struct blp_texture : public opengl::texture
+//! \brief A BLP file's mip levels in a GL texture.
+//! Streamed textures upload only the levels up to a small placeholder
+//! size when created. The larger levels are decoded on the AsyncLoader
+//! once the texture is bound for drawing and uploaded by a later bind.
+//! TextureManager::update drops them again when over the VRAM budget.
+struct blp_texture : public opengl::texture, public AsyncObject
 {
-  blp_texture (std::string const& filename);
+  //! \param streamed false uploads all levels right away, e.g. for previews
+  blp_texture (std::string const& filename, bool streamed = true);
+  ~blp_texture();
 
-  void loadFromUncompressedData(BLPHeader const* lHeader, char const* lData);
-  void loadFromCompressedData(BLPHeader const* lHeader, char const* lData);
+  void bind();
+
+  //! \brief Decode the levels above the placeholder, done by the AsyncLoader.
+  virtual void finishLoading() override;
+
+  //! \brief Free the levels above the placeholder in video memory.
+  void drop_streamed_levels();
 
   const std::string& filename();
   int width() const { return original_width; }
   int height() const { return original_height; }
 
+  bool fully_resident() const { return _base_level == 0; }
+  //! \brief video memory used by the levels currently uploaded
+  std::size_t resident_bytes() const;
+  std::size_t last_used_frame() const { return _last_used_frame; }
+
 private:
+  struct mip_level
+  {
+    int width;
+    int height;
+    std::vector<char> data;
+  };
+
+  int level_width (int level) const;
+  int level_height (int level) const;
+  std::size_t level_bytes (int level) const;
+
+  //! \brief Decode levels [first, last) of the file's data.
+  std::vector<mip_level> decode (BLPHeader const* header, char const* data, int first, int last) const;
+  void upload (int level, mip_level const&);
+
   int original_width;
   int original_height;
-  int _width;
-  int _height;
   std::string _filename;
+
+  bool _compressed;
+  GLint _format;
+  int _blocksize;
+
+  int _levels = 0;
+  //! \note levels below _base_level are not in video memory, levels from
+  //! _placeholder_level on always are
+  int _placeholder_level = 0;
+  int _base_level = 0;
+
+  bool _requested = false;
+  std::vector<mip_level> _streamed_levels;
+  std::size_t _last_used_frame = 0;
 };
 
 struct scoped_blp_texture_reference;
 class TextureManager
 {
 public:
+  //! \brief Log the textures still loaded, their residency and bytes.
   static void report();
 
+  //! \brief Call once per frame after drawing: drops the streamed levels of
+  //! the least recently used textures while over Settings::textureBudget.
+  static void update();
+  //! \brief Destroy the textures kept after their last reference, with
+  //! the context they were created in still current.
+  static void clear_unused();
+
 private:
+  friend struct blp_texture;
   friend struct scoped_blp_texture_reference;
+
+  //! \note declared before _, the textures unregister when destroyed
+  static noggit::texture_residency _residency;
   static noggit::multimap_with_normalized_key<blp_texture> _;
+
+  static std::size_t _frame;
+  static std::size_t _uploaded_bytes;
 };
 
 struct scoped_blp_texture_reference
 {
   scoped_blp_texture_reference (std::string const& filename)
-    : _filename (filename)
-    , _blp_texture (TextureManager::_.emplace (_filename))
+    : _entry (TextureManager::_.acquire (filename))
   {}
 
   scoped_blp_texture_reference (scoped_blp_texture_reference const& other)
-    : _filename (other._filename)
-    , _blp_texture (other._blp_texture ? TextureManager::_.emplace (_filename) : nullptr)
-  {}
+    : _entry (other._entry)
+  {
+    if (_entry)
+    {
+      TextureManager::_.add_reference (_entry);
+    }
+  }
   scoped_blp_texture_reference& operator= (scoped_blp_texture_reference const& other)
   {
-    _filename = other._filename;
-    _blp_texture = other._blp_texture ? TextureManager::_.emplace (_filename) : nullptr;
+    scoped_blp_texture_reference copy (other);
+    std::swap (_entry, copy._entry);
     return *this;
   }
 
   scoped_blp_texture_reference (scoped_blp_texture_reference&& other)
-    : _filename (other._filename)
-    , _blp_texture (other._blp_texture)
+    : _entry (other._entry)
   {
-    other._blp_texture = nullptr;
+    other._entry = nullptr;
   }
   scoped_blp_texture_reference& operator= (scoped_blp_texture_reference&& other)
   {
-    std::swap (_filename, other._filename);
-    std::swap (_blp_texture, other._blp_texture);
-    other._blp_texture = nullptr;
+    std::swap (_entry, other._entry);
     return *this;
   }
 
   ~scoped_blp_texture_reference()
   {
-    if (_blp_texture)
+    if (_entry)
     {
-      TextureManager::_.erase (_filename);
+      TextureManager::_.release (_entry);
     }
   }
 
   blp_texture* operator->() const
   {
-    return _blp_texture;
+    return get();
   }
   blp_texture* get() const
   {
-    return _blp_texture;
+    return _entry ? &_entry->value : nullptr;
   }
 
   bool operator== (scoped_blp_texture_reference const& other) const
   {
-    return std::tie (_filename, _blp_texture) == std::tie (other._filename, other._blp_texture);
+    return _entry == other._entry;
   }
 
 private:
-  std::string _filename;
-  blp_texture* _blp_texture;
+  noggit::multimap_with_normalized_key<blp_texture>::entry* _entry;
 };
 
 namespace noggit
@@ -20,14 +20,29 @@ TileWater::TileWater(MapTile *pTile, float pXbase, float pZbase)
   }
 }
 
-void TileWater::readFromFile(MPQFile &theFile, size_t basePos)
+std::vector<chunk_water_data> TileWater::read(MPQFile &theFile, size_t basePos)
 {
+  std::vector<chunk_water_data> data;
+
   for (int z = 0; z < 16; ++z)
   {
     for (int x = 0; x < 16; ++x)
     {
       theFile.seek(basePos + (z * 16 + x) * sizeof(MH2O_Header));
-      chunks[z][x]->fromFile(theFile, basePos);
+      data.emplace_back (ChunkWater::read(theFile, basePos));
+    }
+  }
+
+  return data;
+}
+
+void TileWater::load(std::vector<chunk_water_data> const& data)
+{
+  for (int z = 0; z < 16; ++z)
+  {
+    for (int x = 0; x < 16; ++x)
+    {
+      chunks[z][x]->load(data[z * 16 + x]);
     }
   }
 }
@@ -8,6 +8,7 @@
 #include <noggit/MapHeaders.h>
 
 #include <memory>
+#include <vector>
 
 class MapTile;
 class sExtendableArray;
@@ -19,7 +20,10 @@ public:
 
   ChunkWater* getChunk(int x, int z);
 
-  void readFromFile(MPQFile &theFile, size_t basePos);
+  //! \brief Read MH2O without creating any liquid, e.g. on a loader thread.
+  static std::vector<chunk_water_data> read(MPQFile &theFile, size_t basePos);
+  //! \note needs the GL context
+  void load(std::vector<chunk_water_data> const& data);
   void saveToFile(sExtendableArray &lADTFile, int &lMHDR_Position, int &lCurrentPosition);
 
   void draw ( opengl::scoped::use_program& water_shader
@@ -3,6 +3,7 @@
 #include <math/frustum.hpp>
 #include <noggit/Log.h> // LogDebug
 #include <noggit/ModelManager.h> // ModelManager
+#include <noggit/Settings.h>
 #include <noggit/TextureManager.h> // TextureManager, Texture
 #include <noggit/WMO.h>
 #include <noggit/World.h>
@@ -31,6 +32,15 @@ WMO::WMO(const std::string& filenameArg)
   finishLoading();
 }
 
+WMO::~WMO()
+{
+  if (_finished_upload)
+  {
+    for (auto& group : groups)
+      group.unload();
+  }
+}
+
 void WMO::finishLoading ()
 {
   MPQFile f(_filename);
@@ -435,6 +445,18 @@ std::vector<float> WMO::intersect (math::ray const& ray) const
   return results;
 }
 
+std::size_t WMO::memory_usage() const
+{
+  std::size_t bytes (0);
+
+  for (auto const& group : groups)
+  {
+    bytes += group.memory_usage();
+  }
+
+  return bytes;
+}
+
 bool WMO::drawSkybox ( math::vector_3d pCamera
                      , math::vector_3d pLower
                      , math::vector_3d pUpper
@@ -644,33 +666,42 @@ namespace
 
 void WMOGroup::upload()
 {
-  gl.genBuffers (1, &_vertices_buffer);
-  gl.bufferData<GL_ARRAY_BUFFER> ( _vertices_buffer
-                                 , _vertices.size() * sizeof (*_vertices.data())
-                                 , _vertices.data()
-                                 , GL_STATIC_DRAW
-                                 );
-
-  gl.genBuffers (1, &_normals_buffer);
-  gl.bufferData<GL_ARRAY_BUFFER> ( _normals_buffer
-                                 , _normals.size() * sizeof (*_normals.data())
-                                 , _normals.data()
-                                 , GL_STATIC_DRAW
-                                 );
-
-  gl.genBuffers (1, &_texcoords_buffer);
-  gl.bufferData<GL_ARRAY_BUFFER> ( _texcoords_buffer
-                                 , _texcoords.size() * sizeof (*_texcoords.data())
-                                 , _texcoords.data()
-                                 , GL_STATIC_DRAW
-                                 );
-
-  gl.genBuffers (1, &_vertex_colors_buffer);
-  gl.bufferData<GL_ARRAY_BUFFER> ( _vertex_colors_buffer
-                                 , _vertex_colors.size() * sizeof (*_vertex_colors.data())
-                                 , _vertex_colors.data()
-                                 , GL_STATIC_DRAW
-                                 );
+  std::size_t const vertices_size (_vertices.size() * sizeof (*_vertices.data()));
+  std::size_t const normals_size (_normals.size() * sizeof (*_normals.data()));
+  std::size_t const texcoords_size (_texcoords.size() * sizeof (*_texcoords.data()));
+  std::size_t const vertex_colors_size (_vertex_colors.size() * sizeof (*_vertex_colors.data()));
+
+  // all attributes are put one after the other into a single range
+  _normals_offset = vertices_size;
+  _texcoords_offset = _normals_offset + normals_size;
+  _vertex_colors_offset = _texcoords_offset + texcoords_size;
+
+  std::vector<char> attributes (_vertex_colors_offset + vertex_colors_size);
+  std::copy_n (reinterpret_cast<char const*> (_vertices.data()), vertices_size, attributes.data());
+  std::copy_n (reinterpret_cast<char const*> (_normals.data()), normals_size, attributes.data() + _normals_offset);
+  std::copy_n (reinterpret_cast<char const*> (_texcoords.data()), texcoords_size, attributes.data() + _texcoords_offset);
+  std::copy_n (reinterpret_cast<char const*> (_vertex_colors.data()), vertex_colors_size, attributes.data() + _vertex_colors_offset);
+
+  _vertices_range = noggit::vertex_arena::getInstance()->allocate (attributes.size(), attributes.data());
+  _indices_range = noggit::index_arena::getInstance()->allocate
+    (_indices.size() * sizeof (*_indices.data()), _indices.data());
+}
+
+void WMOGroup::unload()
+{
+  noggit::vertex_arena::getInstance()->free (_vertices_range);
+  noggit::index_arena::getInstance()->free (_indices_range);
+}
+
+std::size_t WMOGroup::memory_usage() const
+{
+  return _vertices.capacity() * sizeof (*_vertices.data())
+       + _normals.capacity() * sizeof (*_normals.data())
+       + _texcoords.capacity() * sizeof (*_texcoords.data())
+       + _vertex_colors.capacity() * sizeof (*_vertex_colors.data())
+       + _indices.capacity() * sizeof (*_indices.data())
+       + _vertices_range.size
+       + _indices_range.size;
 }
 
 void WMOGroup::load()
@@ -1031,16 +1062,16 @@ void WMOGroup::draw( const math::vector_3d& ofs
   visible = true;
   setupFog (draw_fog, setup_fog);
 
-  gl.vertexPointer (_vertices_buffer, 3, GL_FLOAT, 0, nullptr);
-  gl.normalPointer (_normals_buffer, GL_FLOAT, 0, nullptr);
-  gl.texCoordPointer (_texcoords_buffer, 2, GL_FLOAT, 0, nullptr);
+  gl.vertexPointer (_vertices_range.buffer, 3, GL_FLOAT, 0, _vertices_range.pointer());
+  gl.normalPointer (_vertices_range.buffer, GL_FLOAT, 0, _vertices_range.pointer (_normals_offset));
+  gl.texCoordPointer (_vertices_range.buffer, 2, GL_FLOAT, 0, _vertices_range.pointer (_texcoords_offset));
 
   if (hascv)
   {
     if(indoor)
     {
       gl.enableClientState (GL_COLOR_ARRAY);
-      gl.colorPointer (_vertex_colors_buffer, 4, GL_FLOAT, 0, 0);
+      gl.colorPointer (_vertices_range.buffer, 4, GL_FLOAT, 0, _vertices_range.pointer (_vertex_colors_offset));
     }
 
     gl.disable(GL_LIGHTING);
@@ -1058,6 +1089,8 @@ void WMOGroup::draw( const math::vector_3d& ofs
   gl.disable(GL_BLEND);
   gl.color4f(1,1,1,1);
 
+  opengl::scoped::buffer_binder<GL_ELEMENT_ARRAY_BUFFER> const indices_binder (_indices_range.buffer);
+
   for (wmo_batch& batch : _batches)
   {
     WMOMaterial* mat (&wmo->mat.at (batch.texture));
@@ -1065,7 +1098,7 @@ void WMOGroup::draw( const math::vector_3d& ofs
 
     mat->_texture.get()->bind();
 
-    gl.drawRangeElements (GL_TRIANGLES, batch.vertex_start, batch.vertex_end, batch.index_count, GL_UNSIGNED_SHORT, _indices.data () + batch.index_start);
+    gl.drawRangeElements (GL_TRIANGLES, batch.vertex_start, batch.vertex_end, batch.index_count, GL_UNSIGNED_SHORT, _indices_range.pointer (batch.index_start * sizeof (*_indices.data())));
   }
 
   gl.color4f(1, 1, 1, 1);
@@ -1223,7 +1256,18 @@ void WMOFog::setup()
   gl.disable(GL_FOG);
 }
 
-decltype (WMOManager::_) WMOManager::_;
+decltype (WMOManager::_) WMOManager::_
+  { &noggit::mpq::normalize_filename
+    // the loader may still be filling in a WMO that isn't finished
+  , [] (WMO const& wmo) -> boost::optional<std::size_t>
+    {
+      if (!wmo.finishedLoading())
+      {
+        return boost::none;
+      }
+      return wmo.memory_usage();
+    }
+  };
 
 void WMOManager::report()
 {
@@ -1233,5 +1277,20 @@ void WMOManager::report()
               output += " - " + key + "\n";
             }
           );
+  output += "Unused: " + std::to_string (_.unused_elements()) + " WMOs, "
+          + std::to_string (_.unused_bytes() >> 20) + " MiB, "
+          + std::to_string (_.revives()) + " revived, "
+          + std::to_string (_.evictions()) + " evictions\n";
   LogDebug << output;
 }
+
+void WMOManager::update()
+{
+  _.unused_budget
+    (std::size_t (std::max (Settings::getInstance()->unusedAssetBudget, 0)) << 20);
+}
+
+void WMOManager::clear_unused()
+{
+  _.clear_unused();
+}
@@ -9,6 +9,7 @@
 #include <noggit/ModelInstance.h> // ModelInstance
 #include <noggit/ModelManager.h>
 #include <noggit/TextureManager.h>
+#include <noggit/geometry_arena.hpp>
 #include <noggit/multimap_with_normalized_key.hpp>
 #include <noggit/wmo_liquid.hpp>
 
@@ -47,6 +48,11 @@ public:
   void load ();
 
   void upload();
+  //! \brief Free the ranges upload() took from the geometry arenas.
+  void unload();
+
+  //! \brief Approximate bytes of geometry held in memory and buffers.
+  std::size_t memory_usage() const;
 
   void draw( const math::vector_3d& ofs
            , math::degrees const
@@ -102,7 +108,11 @@ private:
 
   std::vector<wmo_batch> _batches;
 
-  GLuint _vertices_buffer, _normals_buffer, _texcoords_buffer, _vertex_colors_buffer;
+  noggit::arena_range _vertices_range;
+  noggit::arena_range _indices_range;
+  std::size_t _normals_offset;
+  std::size_t _texcoords_offset;
+  std::size_t _vertex_colors_offset;
 
   std::vector<::math::vector_3d> _vertices;
   std::vector<::math::vector_3d> _normals;
@@ -159,6 +169,7 @@ class WMO : public AsyncObject
 {
 public:
   explicit WMO(const std::string& name);
+  ~WMO();
 
   void draw ( int doodadset
             , const math::vector_3d& ofs
@@ -186,6 +197,9 @@ public:
 
   std::vector<float> intersect (math::ray const&) const;
 
+  //! \brief Approximate bytes of geometry held by the groups.
+  std::size_t memory_usage() const;
+
   void finishLoading();
 
   void upload();
@@ -219,6 +233,12 @@ class WMOManager
 public:
   static void report();
 
+  //! \brief Apply Settings::unusedAssetBudget, call once per frame.
+  static void update();
+  //! \brief Destroy the WMOs kept after their last reference, with the
+  //! context they were uploaded to still current.
+  static void clear_unused();
+
 private:
   friend struct scoped_wmo_reference;
   static noggit::multimap_with_normalized_key<WMO> _;
@@ -227,60 +247,52 @@ private:
 struct scoped_wmo_reference
 {
   scoped_wmo_reference (std::string const& filename)
-    : _valid (true)
-    , _filename (filename)
-    , _wmo (WMOManager::_.emplace (_filename))
+    : _entry (WMOManager::_.acquire (filename))
   {}
 
   scoped_wmo_reference (scoped_wmo_reference const& other)
-    : _valid (other._valid)
-    , _filename (other._filename)
-    , _wmo (WMOManager::_.emplace (_filename))
-  {}
+    : _entry (other._entry)
+  {
+    if (_entry)
+    {
+      WMOManager::_.add_reference (_entry);
+    }
+  }
   scoped_wmo_reference& operator= (scoped_wmo_reference const& other)
   {
-    _valid = other._valid;
-    _filename = other._filename;
-    _wmo = WMOManager::_.emplace (_filename);
+    scoped_wmo_reference copy (other);
+    std::swap (_entry, copy._entry);
     return *this;
   }
 
   scoped_wmo_reference (scoped_wmo_reference&& other)
-    : _valid (other._valid)
-    , _filename (other._filename)
-    , _wmo (other._wmo)
+    : _entry (other._entry)
   {
-    other._valid = false;
+    other._entry = nullptr;
   }
   scoped_wmo_reference& operator= (scoped_wmo_reference&& other)
   {
-    std::swap(_valid, other._valid);
-    std::swap(_filename, other._filename);
-    std::swap(_wmo, other._wmo);
-    other._valid = false;
+    std::swap (_entry, other._entry);
     return *this;
   }
 
   ~scoped_wmo_reference()
   {
-    if (_valid)
+    if (_entry)
     {
-      WMOManager::_.erase (_filename);
+      WMOManager::_.release (_entry);
     }
   }
 
   WMO* operator->() const
   {
-    return _wmo;
+    return get();
   }
   WMO* get() const
   {
-    return _wmo;
+    return _entry ? &_entry->value : nullptr;
   }
 
 private:
-  bool _valid;
-
-  std::string _filename;
-  WMO* _wmo;
+  noggit::multimap_with_normalized_key<WMO>::entry* _entry;
 };
@@ -19,8 +19,12 @@
 #include <noggit/TileWater.hpp>// tile water
 #include <noggit/WMOInstance.h> // WMOInstance
 #include <noggit/map_index.hpp>
+#include <noggit/shader_registry.hpp>
+#include <noggit/terrain_blur.hpp>
+#include <noggit/terrain_picking.hpp>
 #include <noggit/texture_set.hpp>
 #include <noggit/tool_enums.hpp>
+#include <noggit/worker_pool.hpp>
 #include <noggit/ui/ObjectEditor.h>
 #include <noggit/ui/TexturingGUI.h>
 #include <opengl/matrix.hpp>
@@ -32,11 +36,14 @@
 #include <boost/thread/thread.hpp>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <ctime>
 #include <forward_list>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <sstream>
 #include <string>
@@ -343,7 +350,7 @@ void World::initDisplay()
     WMOInstance inst(mWmoFilename, &mWmoEntry);
     //! \todo is this used? does it even make _any_ sense to set the camera position to the center of a wmo?
     // camera = inst.pos;
-    mWMOInstances.emplace(mWmoEntry.uniqueID, std::move(inst));
+    update_wmo_bounds(mWMOInstances.emplace(mWmoEntry.uniqueID, std::move(inst)).first->second);
   }
   else
   {
@@ -479,8 +486,9 @@ void World::draw ( math::vector_3d const& cursor_pos
   bool hadSky = false;
   if (draw_wmo || mapIndex.hasAGlobalWMO())
   {
-    for (std::map<int, WMOInstance>::iterator it = mWMOInstances.begin(); it != mWMOInstances.end(); ++it)
+    for (int uid : _wmo_grid.overlapping (camera_pos, camera_pos))
     {
+      auto it (mWMOInstances.find (uid));
       hadSky = it->second.wmo->drawSkybox ( camera_pos
                                           , it->second.extents[0]
                                           , it->second.extents[1]
@@ -561,26 +569,273 @@ void World::draw ( math::vector_3d const& cursor_pos
 
   gl.clientActiveTexture(GL_TEXTURE0);
 
-  // height map w/ a zillion texture passes
+  // height map, all layers, the shadow and the overlays in one pass
   if (draw_terrain)
   {
+    opengl::program const& terrain_program
+      ( noggit::shader_registry::getInstance()->program
+          ( "terrain"
+          , R"code(
+#version 110
+
+attribute vec4 position;
+attribute vec3 normal;
+attribute vec3 mccv;
+attribute vec2 texcoord;
+attribute vec2 alphacoord;
+
+uniform mat4 model_view;
+uniform mat4 projection;
+
+uniform vec3 light_dir;
+uniform vec3 ambient_color;
+uniform vec3 diffuse_color;
+uniform vec3 specular_color;
+
+uniform int has_mccv;
+uniform int cant_paint;
+
+varying vec3 position_;
+varying vec2 texcoord_;
+varying vec2 alphacoord_;
+varying vec3 lighting_;
+varying vec3 specular_;
+varying float depth_;
+
+void main()
+{
+  vec4 view_position = model_view * position;
+  gl_Position = projection * view_position;
+
+  position_ = position.xyz;
+  texcoord_ = texcoord;
+  alphacoord_ = alphacoord;
+  depth_ = -view_position.z;
+
+  vec3 material = vec3 (1.0);
+  if (cant_paint != 0)
+  {
+    material = vec3 (1.0, 0.0, 0.0);
+  }
+  else if (has_mccv != 0)
+  {
+    material = mccv;
+  }
+
+  float diffuse = max (dot (normalize (normal), light_dir), 0.0);
+  lighting_ = clamp (material * (ambient_color + diffuse_color * diffuse), 0.0, 1.0);
+
+  specular_ = vec3 (0.0);
+  if (diffuse > 0.0)
+  {
+    vec3 eye_normal = normalize ((model_view * vec4 (normal, 0.0)).xyz);
+    vec3 eye_light = normalize ((model_view * vec4 (light_dir, 0.0)).xyz);
+    vec3 half_vector = normalize (eye_light + vec3 (0.0, 0.0, 1.0));
+    specular_ = specular_color * pow (max (dot (eye_normal, half_vector), 0.0), 64.0);
+  }
+}
+)code"
+          , R"code(
+#version 110
+
+uniform sampler2D textures[4];
+uniform sampler2D alphamap;
+uniform sampler2D shadow_map;
+
+uniform int layer_count;
+uniform vec2 layer_offsets[4];
+
+uniform vec4 shadow_color;
+uniform vec4 impassable_overlay;
+uniform vec4 areaid_overlay;
+
+uniform int draw_fog;
+uniform vec3 fog_color;
+uniform float fog_start;
+uniform float fog_end;
+
+uniform int draw_contour;
+uniform int draw_wireframe;
+uniform float unit_size;
+
+varying vec3 position_;
+varying vec2 texcoord_;
+varying vec2 alphacoord_;
+varying vec3 lighting_;
+varying vec3 specular_;
+varying float depth_;
+
+float line (float value, float half_width)
+{
+  float distance = abs (value - floor (value + 0.5));
+  float blur = fwidth (value);
+  return 1.0 - smoothstep (half_width, half_width + blur, distance);
+}
+
+void main()
+{
+  vec3 color = vec3 (1.0);
+
+  if (layer_count > 0)
+  {
+    color = texture2D (textures[0], texcoord_ + layer_offsets[0]).rgb;
+
+    vec3 alpha = texture2D (alphamap, alphacoord_).rgb;
+    if (layer_count > 1)
+    {
+      color = mix (color, texture2D (textures[1], texcoord_ + layer_offsets[1]).rgb, alpha.r);
+    }
+    if (layer_count > 2)
+    {
+      color = mix (color, texture2D (textures[2], texcoord_ + layer_offsets[2]).rgb, alpha.g);
+    }
+    if (layer_count > 3)
+    {
+      color = mix (color, texture2D (textures[3], texcoord_ + layer_offsets[3]).rgb, alpha.b);
+    }
+  }
+
+  color = color * lighting_ + specular_;
+
+  float shadow = texture2D (shadow_map, alphacoord_).a;
+  color = mix (color, shadow_color.rgb, shadow * shadow_color.a);
+
+  if (draw_contour != 0)
+  {
+    // same spacing and width as the former 1D contour texture
+    float s = position_.y * 0.25 - 0.13671875;
+    color = mix (color, vec3 (1.0), line (s, 0.01171875));
+  }
+
+  color = mix (color, impassable_overlay.rgb, impassable_overlay.a);
+  color = mix (color, areaid_overlay.rgb, areaid_overlay.a);
+
+  if (draw_wireframe != 0)
+  {
+    vec2 grid = position_.xz / unit_size;
+    float edges = max ( max (line (grid.x, 0.02), line (grid.y, 0.02))
+                      , max (line (grid.x + grid.y, 0.02), line (grid.x - grid.y, 0.02))
+                      );
+
+    // corners and cell centers
+    float radius = 0.06;
+    float blur = length (fwidth (grid));
+    float corner = length (grid - floor (grid + 0.5));
+    float center = length (grid - floor (grid) - 0.5);
+    float vertices = 1.0 - smoothstep (radius, radius + blur, min (corner, center));
+
+    color = mix (color, vec3 (1.0), edges * 0.2);
+    color = mix (color, vec3 (1.0), vertices * 0.5);
+  }
+
+  if (draw_fog != 0)
+  {
+    float fog = clamp ((depth_ - fog_start) / (fog_end - fog_start), 0.0, 1.0);
+    color = mix (color, fog_color, fog);
+  }
+
+  gl_FragColor = vec4 (color, 1.0);
+}
+)code"
+          )
+      );
+
+    _visible_chunks.clear();
     for (MapTile* tile : mapIndex.loaded_tiles())
     {
-      tile->draw ( frustum
-                 , culldistance
-                 , camera_pos
-                 , show_unpaintable_chunks
-                 , draw_contour
-                 , draw_paintability_overlay
-                 , draw_chunk_flag_overlay
-                 , draw_areaid_overlay
-                 , draw_wireframe
-                 , cursor_type
-                 , area_id_colors
-                 , math::vector_4d {skies->colorSet[WATER_COLOR_DARK] * 0.3f, 1.f}
-                 , mCurrentSelection
-                 , animtime
-                 );
+      tile->visible_chunks (frustum, culldistance, camera_pos, _visible_chunks);
+    }
+
+    // chunks are separate buffers so they can't be merged into one draw,
+    // but sorted by their layers most of them don't bind any texture
+    auto const layers
+      ( [] (MapChunk* chunk)
+        {
+          return std::array<blp_texture*, 4>
+            { { chunk->_texture_set.layer_texture (0)
+              , chunk->_texture_set.layer_texture (1)
+              , chunk->_texture_set.layer_texture (2)
+              , chunk->_texture_set.layer_texture (3)
+              }
+            };
+        }
+      );
+    std::sort ( _visible_chunks.begin(), _visible_chunks.end()
+              , [&] (MapChunk* lhs, MapChunk* rhs)
+                {
+                  auto const l (layers (lhs));
+                  auto const r (layers (rhs));
+                  return std::lexicographical_compare
+                    (l.begin(), l.end(), r.begin(), r.end(), std::less<blp_texture*>());
+                }
+              );
+
+    {
+      opengl::scoped::use_program terrain_shader {terrain_program};
+
+      terrain_shader.uniform ("model_view", opengl::matrix::model_view());
+      terrain_shader.uniform ("projection", opengl::matrix::projection());
+
+      terrain_shader.uniform ("textures", std::vector<int> {0, 1, 2, 3});
+      terrain_shader.uniform ("alphamap", 4);
+      terrain_shader.uniform ("shadow_map", 5);
+
+      float const di (outdoorLightStats.dayIntensity);
+      math::vector_3d const dd (outdoorLightStats.dayDir);
+      math::vector_3d light_dir (-dd.x, -dd.z, dd.y);
+      light_dir.normalize();
+      math::vector_3d const diffuse_color
+        (di > 0.f ? skies->colorSet[LIGHT_GLOBAL_DIFFUSE] * di : math::vector_3d (0.f, 0.f, 0.f));
+      math::vector_3d const specular_color
+        (di > 0.f ? math::vector_3d (0.1f, 0.1f, 0.1f) : math::vector_3d (0.f, 0.f, 0.f));
+
+      terrain_shader.uniform ("light_dir", light_dir);
+      terrain_shader.uniform ("ambient_color", skies->colorSet[LIGHT_GLOBAL_AMBIENT]);
+      terrain_shader.uniform ("diffuse_color", diffuse_color);
+      terrain_shader.uniform ("specular_color", specular_color);
+      terrain_shader.uniform
+        ("shadow_color", math::vector_4d {skies->colorSet[WATER_COLOR_DARK] * 0.3f, 1.f});
+
+      terrain_shader.uniform ("draw_fog", static_cast<GLint> (draw_fog));
+      terrain_shader.uniform ("fog_color", skies->colorSet[FOG_COLOR]);
+      terrain_shader.uniform ("fog_end", fogdistance);
+      terrain_shader.uniform ("fog_start", fogdistance * 0.5f);
+
+      terrain_shader.uniform ("draw_contour", static_cast<GLint> (draw_contour));
+      terrain_shader.uniform ("draw_wireframe", static_cast<GLint> (draw_wireframe));
+      terrain_shader.uniform ("unit_size", UNITSIZE);
+
+      terrain_shader.attrib ("texcoord", detailtexcoords, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+      terrain_shader.attrib ("alphacoord", alphatexcoords, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+      std::array<blp_texture*, 4> bound_textures {};
+
+      for (MapChunk* chunk : _visible_chunks)
+      {
+        chunk->draw ( terrain_shader
+                    , bound_textures
+                    , show_unpaintable_chunks
+                    , draw_paintability_overlay
+                    , draw_chunk_flag_overlay
+                    , draw_areaid_overlay
+                    , area_id_colors
+                    , animtime
+                    );
+      }
+    }
+
+    for (size_t unit (5); unit > 0; --unit)
+    {
+      opengl::texture::disable_texture (unit);
+    }
+    opengl::texture::set_active_texture (0);
+
+    if (cursor_type == 3 && mCurrentSelection)
+    {
+      if (auto chunk = boost::get<selected_chunk_type> (&*mCurrentSelection))
+      {
+        chunk->chunk->draw_selected_triangle (chunk->triangle);
+      }
     }
   }
 
@@ -683,8 +938,10 @@ void World::draw ( math::vector_3d const& cursor_pos
 
   if (draw_lines)
   {
-    opengl::program program { { GL_VERTEX_SHADER
-                              , R"code(
+    opengl::program const& program
+      ( noggit::shader_registry::getInstance()->program
+          ( "line"
+          , R"code(
 #version 110
 
 attribute vec4 position;
@@ -697,9 +954,7 @@ void main()
   gl_Position = projection * model_view * (position + vec4 (0.0, 0.5, 0.0, 0.0));
 }
 )code"
-                              }
-                            , { GL_FRAGMENT_SHADER
-                              , R"code(
+          , R"code(
 #version 110
 
 uniform vec4 color;
@@ -709,8 +964,8 @@ void main()
   gl_FragColor = color;
 }
 )code"
-                              }
-                            };
+          )
+      );
 
 
     opengl::scoped::use_program line_shader {program};
@@ -727,10 +982,10 @@ void main()
 
   if (draw_mfbo)
   {
-    //! \todo don't compile on every frame
-    opengl::program const program
-      { { GL_VERTEX_SHADER
-        , R"code(
+    opengl::program const& program
+      ( noggit::shader_registry::getInstance()->program
+          ( "mfbo"
+          , R"code(
 #version 110
 
 attribute vec4 position;
@@ -743,9 +998,7 @@ void main()
   gl_Position = projection * model_view * position;
 }
 )code"
-        }
-      , { GL_FRAGMENT_SHADER
-        , R"code(
+          , R"code(
 #version 110
 
 uniform vec4 color;
@@ -755,8 +1008,8 @@ void main()
   gl_FragColor = color;
 }
 )code"
-        }
-      };
+          )
+      );
     opengl::scoped::use_program mfbo_shader {program};
 
     mfbo_shader.uniform ("model_view", opengl::matrix::model_view());
@@ -804,21 +1057,67 @@ void main()
       ModelManager::resetAnim();
 
     gl.enable(GL_LIGHTING);  //! \todo  Is this needed? Or does this fuck something up?
-    for (std::map<int, ModelInstance>::iterator it = mModelInstances.begin(); it != mModelInstances.end(); ++it)
+
+    std::vector<std::pair<ModelInstance*, bool>> boxed;
+
+    for (int uid : _model_grid.visible (frustum))
     {
+      auto it (mModelInstances.find (uid));
       bool const is_hidden (hidden_models.count (it->second.model.get()));
-      if (!is_hidden)
+      if (!is_hidden && it->second.is_visible (frustum, culldistance, camera_pos))
       {
-        it->second.draw ( frustum
-                        , culldistance
-                        , camera_pos
-                        , is_hidden
-                        , draw_models_with_box
-                        , draw_fog
-                        , IsSelection (eEntry_Model) && boost::get<selected_model_type> (*GetCurrentSelection())->uid == it->second.uid
-                        , animtime
-                        );
+        _model_batches[it->second.model.get()].emplace_back (it->second.transform_matrix().transposed());
+
+        bool const is_current_selection
+          (IsSelection (eEntry_Model) && boost::get<selected_model_type> (*GetCurrentSelection())->uid == it->second.uid);
+
+        if (draw_models_with_box || is_current_selection)
+        {
+          boxed.emplace_back (&it->second, is_current_selection);
+        }
+      }
+    }
+
+    if (draw_model_animations)
+    {
+      std::vector<Model*> models;
+      for (auto const& batch : _model_batches)
+      {
+        // billboarded models are animated per instance while drawing
+        if (!batch.second.empty() && !batch.first->mPerInstanceAnimation)
+        {
+          models.emplace_back (batch.first);
+        }
+      }
+
+      // skin the visible models on all cores, drawing only uploads the result
+      math::matrix_4x4 const model_view (opengl::matrix::model_view());
+      noggit::worker_pool::getInstance()->for_each
+        ( models.size()
+        , [&] (std::size_t i)
+          {
+            models[i]->prepare_animation (0, animtime, model_view);
+          }
+        );
+    }
+
+    for (auto it (_model_batches.begin()); it != _model_batches.end();)
+    {
+      // models nothing was drawn of last frame are dropped
+      if (it->second.empty())
+      {
+        it = _model_batches.erase (it);
+        continue;
       }
+
+      it->first->draw (it->second, draw_fog, animtime);
+      it->second.clear();
+      ++it;
+    }
+
+    for (auto const& instance : boxed)
+    {
+      instance.first->draw_box (false, draw_models_with_box, draw_fog, instance.second);
     }
   }
 
@@ -833,8 +1132,9 @@ void main()
 
     gl.lightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, GL_SEPARATE_SPECULAR_COLOR);
 
-    for (std::map<int, WMOInstance>::iterator it = mWMOInstances.begin(); it != mWMOInstances.end(); ++it)
+    for (int uid : _wmo_grid.visible (frustum))
     {
+      auto it (mWMOInstances.find (uid));
       bool const is_hidden (hidden_map_objects.count (it->second.wmo.get()));
       if (!is_hidden)
       {
@@ -867,9 +1167,7 @@ void main()
 
   if (draw_water)
   {
-    liquid_render liquid_renderer;
-
-    opengl::scoped::use_program water_shader {liquid_renderer.shader_program()};
+    opengl::scoped::use_program water_shader {liquid_render::shader_program()};
 
     water_shader.uniform ("model_view", opengl::matrix::model_view());
     water_shader.uniform ("projection", opengl::matrix::projection());
@@ -900,34 +1198,43 @@ selection_result World::intersect ( math::ray const& ray
 
   if (draw_terrain)
   {
-    for (auto&& tile : mapIndex.loaded_tiles())
-    {
-      tile->intersect (ray, &results);
-    }
+    // only the nearest terrain hit matters, so walk the tiles and their
+    // chunks in the order the ray passes them and stop at the first hit
+    noggit::terrain_picking::walk_grid
+      ( ray, {0.f, 0.f, 0.f}, TILESIZE, 64, 64
+      , 0.f, std::numeric_limits<float>::max()
+      , [&] (std::size_t x, std::size_t z, float t_enter, float t_exit)
+        {
+          MapTile* tile (mapIndex.getTile (tile_index (x, z)));
+          return tile && tile->intersect (ray, t_enter, t_exit, &results);
+        }
+      );
   }
 
   if (!pOnlyMap && do_objects)
   {
     if (draw_models)
     {
-      for (auto&& model_instance : mModelInstances)
+      for (int uid : _model_grid.along (ray))
       {
-        bool const is_hidden (hidden_models.count (model_instance.second.model.get()));
+        ModelInstance& model_instance (mModelInstances.at (uid));
+        bool const is_hidden (hidden_models.count (model_instance.model.get()));
         if (!is_hidden)
         {
-          model_instance.second.intersect (ray, &results, animtime);
+          model_instance.intersect (ray, &results, animtime);
         }
       }
     }
 
     if (draw_wmo)
     {
-      for (auto&& wmo_instance : mWMOInstances)
+      for (int uid : _wmo_grid.along (ray))
       {
-        bool const is_hidden (hidden_map_objects.count (wmo_instance.second.wmo.get()));
+        WMOInstance& wmo_instance (mWMOInstances.at (uid));
+        bool const is_hidden (hidden_map_objects.count (wmo_instance.wmo.get()));
         if (!is_hidden)
         {
-          wmo_instance.second.intersect (ray, &results);
+          wmo_instance.intersect (ray, &results);
         }
       }
     }
@@ -936,13 +1243,74 @@ selection_result World::intersect ( math::ray const& ray
   return results;
 }
 
-void World::tick(float dt)
+void World::tick(float dt, math::vector_3d const& camera_pos)
 {
-  while (dt > 0.1f) {
-    ModelManager::updateEmitters(0.1f);
-    dt -= 0.1f;
+  auto const start (std::chrono::steady_clock::now());
+
+  // only models with an instance in draw distance, a WMO's doodads count
+  // as in reach when any part of the WMO is
+  std::unordered_set<Model*> models;
+  math::vector_3d const reach (culldistance, 0.f, culldistance);
+
+  for (int uid : _model_grid.overlapping (camera_pos - reach, camera_pos + reach))
+  {
+    ModelInstance& instance (mModelInstances.at (uid));
+
+    if ((instance.pos - camera_pos).length() - instance.model->rad * instance.scale < culldistance)
+    {
+      models.emplace (instance.model.get());
+    }
+  }
+
+  for (int uid : _wmo_grid.overlapping (camera_pos - reach, camera_pos + reach))
+  {
+    WMOInstance& instance (mWMOInstances.at (uid));
+
+    math::vector_3d const nearest
+      ( std::min (std::max (camera_pos.x, instance.extents[0].x), instance.extents[1].x)
+      , std::min (std::max (camera_pos.y, instance.extents[0].y), instance.extents[1].y)
+      , std::min (std::max (camera_pos.z, instance.extents[0].z), instance.extents[1].z)
+      );
+
+    if (instance.wmo->finishedLoading() && (nearest - camera_pos).length() < culldistance)
+    {
+      for (ModelInstance& doodad : instance.wmo->modelis)
+      {
+        models.emplace (doodad.model.get());
+      }
+    }
+  }
+
+  std::vector<ParticleSystem*> emitters;
+
+  for (Model* model : models)
+  {
+    if (model->finishedLoading())
+    {
+      for (ParticleSystem& emitter : model->particle_systems())
+      {
+        emitters.emplace_back (&emitter);
+      }
+    }
   }
-  ModelManager::updateEmitters(dt);
+
+  noggit::worker_pool::getInstance()->for_each
+    ( emitters.size()
+    , [&] (std::size_t i)
+      {
+        float left (dt);
+
+        while (left > 0.1f)
+        {
+          emitters[i]->update (0.1f);
+          left -= 0.1f;
+        }
+        emitters[i]->update (left);
+      }
+    );
+
+  emitter_update_time = std::chrono::duration<float, std::milli>
+    (std::chrono::steady_clock::now() - start).count();
 }
 
 unsigned int World::getAreaID (math::vector_3d const& pos)
@@ -964,19 +1332,22 @@ void World::clearAllModelsOnADT(tile_index const& tile)
 {
   std::vector<int> wmo_to_delete, m2_to_delete;
 
-  for (auto it = mWMOInstances.begin(); it != mWMOInstances.end(); ++it)
+  math::vector_3d const tile_min (tile.x * TILESIZE, 0.0f, tile.z * TILESIZE);
+  math::vector_3d const tile_max ((tile.x + 1) * TILESIZE, 0.0f, (tile.z + 1) * TILESIZE);
+
+  for (int uid : _wmo_grid.overlapping (tile_min, tile_max))
   {
-    if (tile_index(it->second.pos) == tile)
+    if (tile_index(mWMOInstances.at(uid).pos) == tile)
     {
-      wmo_to_delete.push_back(it->second.mUniqueID);
+      wmo_to_delete.push_back(uid);
     }
   }
 
-  for (auto it = mModelInstances.begin(); it != mModelInstances.end(); ++it)
+  for (int uid : _model_grid.overlapping (tile_min, tile_max))
   {
-    if (tile_index(it->second.pos) == tile)
+    if (tile_index(mModelInstances.at(uid).pos) == tile)
     {
-      m2_to_delete.push_back(it->second.uid);
+      m2_to_delete.push_back(uid);
     }
   }
 
@@ -1092,6 +1463,18 @@ bool World::GetVertex(float x, float z, math::vector_3d *V) const
   return mapIndex.getTile(tile)->GetVertex(x, z, V);
 }
 
+math::vector_3d* World::vertex_at(float x, float z)
+{
+  tile_index tile({x, 0, z});
+
+  if (!mapIndex.tileLoaded(tile))
+  {
+    return nullptr;
+  }
+
+  return mapIndex.getTile(tile)->vertex_at(x, z);
+}
+
 template<typename Fun>
   bool World::for_all_chunks_in_range (math::vector_3d const& pos, float radius, Fun&& fun)
 {
@@ -1182,21 +1565,20 @@ void World::flattenTerrain(math::vector_3d const& pos, float remain, float radiu
 
 void World::blurTerrain(math::vector_3d const& pos, float remain, float radius, int BrushType)
 {
+  noggit::terrain_blur const blur
+    ( pos, radius
+    , [this] (float x, float z) -> float const*
+      {
+        math::vector_3d* vertex (vertex_at (x, z));
+        return vertex ? &vertex->y : nullptr;
+      }
+    );
+
   for_all_chunks_in_range
     ( pos, radius
     , [&] (MapChunk* chunk)
       {
-        return chunk->blurTerrain ( pos
-                                  , remain
-                                  , radius
-                                  , BrushType
-                                  , [this] (float x, float z) -> boost::optional<float>
-                                    {
-                                      math::vector_3d vec;
-                                      auto res (GetVertex (x, z, &vec));
-                                      return boost::make_optional (res, vec.y);
-                                    }
-                                  );
+        return chunk->blurTerrain (pos, remain, radius, BrushType, blur);
       }
     , [this] (MapChunk* chunk)
       {
@@ -1415,6 +1797,7 @@ void World::deleteModelInstance(int pUniqueID)
   if (it == mModelInstances.end()) return;
 
   updateTilesModel(&it->second);
+  _model_grid.erase(pUniqueID);
   mModelInstances.erase(it);
   ResetSelection();
 }
@@ -1425,6 +1808,7 @@ void World::deleteWMOInstance(int pUniqueID)
   if (it == mWMOInstances.end()) return;
 
   updateTilesWMO(&it->second);
+  _wmo_grid.erase(pUniqueID);
   mWMOInstances.erase(it);
   ResetSelection();
 }
@@ -1434,11 +1818,17 @@ void World::delete_duplicate_model_and_wmo_instances()
   std::unordered_set<int> wmos_to_remove;
   std::unordered_set<int> models_to_remove;
 
+  // duplicates have the same extents, so only compare with the ones nearby
   for (auto lhs(mWMOInstances.begin()); lhs != mWMOInstances.end(); ++lhs)
   {
-    for (auto rhs(std::next(lhs)); rhs != mWMOInstances.end(); ++rhs)
+    for (int uid : _wmo_grid.overlapping (lhs->second.extents[0], lhs->second.extents[1]))
     {
-      assert(lhs->first != rhs->first);
+      if (uid <= lhs->first)
+      {
+        continue;
+      }
+
+      auto rhs (mWMOInstances.find (uid));
 
       if ( lhs->second.pos == rhs->second.pos
         && lhs->second.dir == rhs->second.dir
@@ -1452,9 +1842,14 @@ void World::delete_duplicate_model_and_wmo_instances()
 
   for (auto lhs(mModelInstances.begin()); lhs != mModelInstances.end(); ++lhs)
   {
-    for (auto rhs(std::next(lhs)); rhs != mModelInstances.end(); ++rhs)
+    for (int uid : _model_grid.overlapping (lhs->second.extents[0], lhs->second.extents[1]))
     {
-      assert(lhs->first != rhs->first);
+      if (uid <= lhs->first)
+      {
+        continue;
+      }
+
+      auto rhs (mModelInstances.find (uid));
 
       if ( lhs->second.pos == rhs->second.pos
         && lhs->second.dir == rhs->second.dir
@@ -1561,6 +1956,8 @@ void World::updateTilesEntry(selection_type const& entry)
 
 void World::updateTilesWMO(WMOInstance* wmo)
 {
+  update_wmo_bounds(*wmo);
+
   tile_index start(wmo->extents[0]), end(wmo->extents[1]);
   for (int z = start.z; z <= end.z; ++z)
   {
@@ -1573,6 +1970,8 @@ void World::updateTilesWMO(WMOInstance* wmo)
 
 void World::updateTilesModel(ModelInstance* m2)
 {
+  update_model_bounds(*m2);
+
   tile_index start(m2->extents[0]), end(m2->extents[1]);
   for (int z = start.z; z <= end.z; ++z)
   {
@@ -1583,6 +1982,22 @@ void World::updateTilesModel(ModelInstance* m2)
   }
 }
 
+void World::update_model_bounds(ModelInstance const& model)
+{
+  // drawing culls by the bounding sphere, which may stick out of the box
+  math::vector_3d const radius (math::vector_3d (1.0f, 1.0f, 1.0f) * (model.model->rad * model.scale));
+
+  _model_grid.insert ( model.uid
+                     , math::min (model.extents[0], model.pos - radius)
+                     , math::max (model.extents[1], model.pos + radius)
+                     );
+}
+
+void World::update_wmo_bounds(WMOInstance const& wmo)
+{
+  _wmo_grid.insert (wmo.mUniqueID, wmo.extents[0], wmo.extents[1]);
+}
+
 unsigned int World::getMapID()
 {
   return mapIndex._map_id;
@@ -9,14 +9,18 @@
 #include <noggit/Selection.h>
 #include <noggit/Sky.h> // Skies, OutdoorLighting, OutdoorLightStats
 #include <noggit/WMO.h> // WMOManager
+#include <noggit/instance_grid.hpp>
 #include <noggit/map_horizon.h>
 #include <noggit/map_index.hpp>
 #include <noggit/tile_index.hpp>
 #include <noggit/tool_enums.hpp>
 
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace opengl
 {
@@ -85,7 +89,11 @@ public:
 
   void initDisplay();
 
-  void tick(float dt);
+  //! \brief Update the particle emitters of all models in draw distance
+  //! of the camera, spread over the worker pool.
+  void tick(float dt, math::vector_3d const& camera_pos);
+  //! \brief milliseconds the last tick spent updating emitters
+  float emitter_update_time = 0.f;
   void draw ( math::vector_3d const& cursor_pos
             , math::vector_4d const& cursor_color
             , int cursor_type
@@ -157,6 +165,7 @@ public:
   void ResetSelection() { mCurrentSelection.reset(); }
 
   bool GetVertex(float x, float z, math::vector_3d *V) const;
+  math::vector_3d* vertex_at(float x, float z);
 
   // check if the cursor is under map or in an unloaded tile
   bool isUnderMap(math::vector_3d const& pos);
@@ -213,10 +222,15 @@ public:
 
   void reload_tile(tile_index const& tile);
 
+  //! \note also moves the instance in the spatial index, call after every change
   void updateTilesEntry(selection_type const& entry);
   void updateTilesWMO(WMOInstance* wmo);
   void updateTilesModel(ModelInstance* m2);
 
+  //! \brief Add a loaded instance to the spatial index.
+  void update_model_bounds (ModelInstance const& model);
+  void update_wmo_bounds (WMOInstance const& wmo);
+
   void saveMap (int width, int height);
 
   void deleteModelInstance(int pUniqueID);
@@ -286,5 +300,15 @@ private:
 
   std::unique_ptr<noggit::map_horizon::render> _horizon_render;
 
+  // uids of mModelInstances and mWMOInstances by area
+  noggit::instance_grid _model_grid;
+  noggit::instance_grid _wmo_grid;
+
+  // transforms of the visible instances of each model, reused every frame
+  std::unordered_map<Model*, std::vector<math::matrix_4x4>> _model_batches;
+
+  // chunks drawn in the current frame, sorted by their layers
+  std::vector<MapChunk*> _visible_chunks;
+
   bool _display_initialized = false;
 };
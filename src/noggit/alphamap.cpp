@@ -6,7 +6,6 @@
 Alphamap::Alphamap()
 {
   createNew();
-  genTexture();
 }
 
 Alphamap::Alphamap(MPQFile *f, unsigned int flags, bool mBigAlpha, bool doNotFixAlpha)
@@ -19,8 +18,6 @@ Alphamap::Alphamap(MPQFile *f, unsigned int flags, bool mBigAlpha, bool doNotFix
     readBigAlpha(f);
   else
     readNotCompressed(f, doNotFixAlpha);
-
-  genTexture();
 }
 
 void Alphamap::readCompressed(MPQFile *f)
@@ -91,22 +88,23 @@ void Alphamap::createNew()
 
 void Alphamap::loadTexture()
 {
-  bind();
-  gl.texImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 64, 64, 0, GL_ALPHA, GL_UNSIGNED_BYTE, amap);
-}
-
-void Alphamap::genTexture()
-{
-  loadTexture();
-  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  _texture_changed = true;
 }
 
 void Alphamap::bind()
 {
   map.bind();
+
+  if (_texture_changed)
+  {
+    gl.texImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 64, 64, 0, GL_ALPHA, GL_UNSIGNED_BYTE, amap);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    _texture_changed = false;
+  }
 }
 
 void Alphamap::setAlpha(size_t offset, unsigned char value)
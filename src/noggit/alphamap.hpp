@@ -12,6 +12,9 @@ public:
   Alphamap();
   Alphamap(MPQFile* f, unsigned int flags, bool mBigAlpha, bool doNotFixAlpha);
 
+  //! \brief Upload the alphas on the next bind.
+  //! \note the 3D view draws the alphamaps packed by TextureSet instead,
+  //! so the texture only gets created once the 2D view binds it
   void loadTexture();
 
   void bind();
@@ -29,8 +32,7 @@ private:
 
   void createNew();
 
-  void genTexture();
-
   unsigned char amap[64 * 64];
   opengl::texture map;
+  bool _texture_changed = true;
 };
@@ -23,6 +23,8 @@
 #include <boost/thread/thread.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
@@ -44,19 +46,24 @@ class Noggit
 public:
   Noggit (int argc, char *argv[]);
 
+  bool benchmarkOnly() const
+  {
+    return benchmarkMPQ;
+  }
+
 private:
   void initPath(char *argv[]);
   void parseArgs(int argc, char *argv[]);
   void loadMPQs();
+  void benchmarkMPQs();
 
   std::unique_ptr<noggit::ui::main_window> main_window;
 
   boost::filesystem::path wowpath;
 
-  std::unique_ptr<AsyncLoader> asyncLoader;
-
   bool fullscreen;
   bool doAntiAliasing;
+  bool benchmarkMPQ;
 };
 
 void Noggit::initPath(char *argv[])
@@ -94,6 +101,10 @@ void Noggit::parseArgs(int argc, char *argv[])
     {
       doAntiAliasing = false;
     }
+    else if (!strcmp(argv[i], "-benchmark-mpq"))
+    {
+      benchmarkMPQ = true;
+    }
   }
 
   if (Settings::getInstance()->noAntiAliasing())
@@ -104,8 +115,8 @@ void Noggit::parseArgs(int argc, char *argv[])
 
 void Noggit::loadMPQs()
 {
-  asyncLoader = std::make_unique<AsyncLoader>();
-  asyncLoader->start(1);
+  AsyncLoader* asyncLoader (AsyncLoader::getInstance());
+  asyncLoader->start(std::max(1u, boost::thread::hardware_concurrency()));
 
   std::vector<std::string> archiveNames;
   archiveNames.push_back("common.MPQ");
@@ -172,7 +183,7 @@ void Noggit::loadMPQs()
       {
         path.replace(location, 1, std::string(&j, 1));
         if (boost::filesystem::exists(path))
-          MPQArchive::loadMPQ (asyncLoader.get(), path, true);
+          MPQArchive::loadMPQ (asyncLoader, path, true);
       }
     }
     else if (path.find("{character}") != std::string::npos)
@@ -183,18 +194,72 @@ void Noggit::loadMPQs()
       {
         path.replace(location, 1, std::string(&c, 1));
         if (boost::filesystem::exists(path))
-          MPQArchive::loadMPQ (asyncLoader.get(), path, true);
+          MPQArchive::loadMPQ (asyncLoader, path, true);
       }
     }
     else
       if (boost::filesystem::exists(path))
-        MPQArchive::loadMPQ (asyncLoader.get(), path, true);
+        MPQArchive::loadMPQ (asyncLoader, path, true);
+  }
+}
+
+void Noggit::benchmarkMPQs()
+{
+  while (!MPQArchive::allFinishedLoading())
+  {
+    MPQArchive::allFinishLoading();
+  }
+
+  std::vector<std::string> files;
+  for (auto const& file : gListfile.entries())
+  {
+    files.emplace_back (file.to_string());
+  }
+
+  unsigned const maxThreads (std::max(1u, boost::thread::hardware_concurrency()));
+
+  std::vector<unsigned> threadCounts;
+  for (unsigned threadCount (1); threadCount < maxThreads; threadCount *= 2)
+  {
+    threadCounts.push_back(threadCount);
+  }
+  threadCounts.push_back(maxThreads);
+
+  for (unsigned threadCount : threadCounts)
+  {
+    std::atomic<std::size_t> next (0);
+    std::atomic<std::size_t> bytes (0);
+
+    auto const start (std::chrono::steady_clock::now());
+
+    boost::thread_group readers;
+    for (unsigned i (0); i < threadCount; ++i)
+    {
+      readers.create_thread
+        ( [&]
+          {
+            for (std::size_t index (next++); index < files.size(); index = next++)
+            {
+              MPQFile file (files[index]);
+              bytes += file.getSize();
+            }
+          }
+        );
+    }
+    readers.join_all();
+
+    std::chrono::duration<double> const seconds (std::chrono::steady_clock::now() - start);
+
+    Log << "MPQ benchmark: " << threadCount << " thread(s) read " << files.size()
+        << " files, " << bytes / (1024 * 1024) << " MiB in " << seconds.count()
+        << " s (" << bytes / (1024.0 * 1024.0) / seconds.count() << " MiB/s)" << std::endl;
   }
 }
 
 Noggit::Noggit(int argc, char *argv[])
   : fullscreen(false)
   , doAntiAliasing(true)
+  , benchmarkMPQ(false)
 {
   InitLogging();
   initPath(argv);
@@ -227,6 +292,13 @@ Noggit::Noggit(int argc, char *argv[])
   Log << "Project path: " << Project::getInstance()->getPath() << std::endl;
 
   loadMPQs(); // listfiles are not available straight away! They are async! Do not rely on anything at this point!
+
+  if (benchmarkMPQ)
+  {
+    benchmarkMPQs();
+    return;
+  }
+
   OpenDBs();
 
   if (!QGLFormat::hasOpenGL())
@@ -247,6 +319,27 @@ Noggit::Noggit(int argc, char *argv[])
     format.setSamples (4);
   }
 
+  {
+    std::string const& validation (Settings::getInstance()->openglValidation);
+    if (validation == "full")
+    {
+      opengl::context::validation_level (opengl::context::validation::full);
+    }
+    else if (validation == "sampled")
+    {
+      opengl::context::validation_level (opengl::context::validation::sampled);
+    }
+    else if (validation == "debug_output")
+    {
+      opengl::context::validation_level (opengl::context::validation::debug_output);
+      format.setOption (QSurfaceFormat::DebugContext);
+    }
+    else if (validation != "none")
+    {
+      LogError << "unknown openglValidation '" << validation << "', not validating OpenGL calls" << std::endl;
+    }
+  }
+
   QSurfaceFormat::setDefaultFormat (format);
 
   QOpenGLContext context;
@@ -289,5 +382,10 @@ int main(int argc, char *argv[])
 
   Noggit app (argc, argv);
 
+  if (app.benchmarkOnly())
+  {
+    return 0;
+  }
+
   return qapp.exec();
 }
@@ -0,0 +1,104 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/geometry_arena.hpp>
+
+#include <opengl/context.hpp>
+
+#include <algorithm>
+
+namespace noggit
+{
+  namespace
+  {
+    //! \note larger allocations get a buffer of their own
+    std::size_t const page_size (8 << 20);
+    std::size_t const alignment (16);
+  }
+
+  template<GLenum target>
+    geometry_arena<target>* geometry_arena<target>::getInstance()
+  {
+    static geometry_arena instance;
+    return &instance;
+  }
+
+  template<GLenum target>
+    geometry_arena<target>::page::page (std::size_t size)
+      : allocator (size)
+  {
+    gl.genBuffers (1, &buffer);
+    gl.bufferData<target> (buffer, size, nullptr, GL_STATIC_DRAW);
+  }
+
+  template<GLenum target>
+    arena_range geometry_arena<target>::allocate (std::size_t size, GLvoid const* data)
+  {
+    arena_range range;
+
+    if (!size)
+    {
+      return range;
+    }
+
+    page* destination (nullptr);
+    boost::optional<std::size_t> offset;
+
+    for (auto& page : _pages)
+    {
+      if ((offset = page->allocator.allocate (size, alignment)))
+      {
+        destination = page.get();
+        break;
+      }
+    }
+
+    if (!destination)
+    {
+      _pages.emplace_back (new page (std::max (size, page_size)));
+      destination = _pages.back().get();
+      offset = destination->allocator.allocate (size, alignment);
+    }
+
+    range.buffer = destination->buffer;
+    range.offset = offset.get();
+    range.size = size;
+
+    gl.bufferSubData<target> (range.buffer, range.offset, range.size, data);
+
+    return range;
+  }
+
+  template<GLenum target>
+    void geometry_arena<target>::free (arena_range& range)
+  {
+    if (!range.size)
+    {
+      return;
+    }
+
+    auto const it
+      ( std::find_if ( _pages.begin(), _pages.end()
+                     , [&] (std::unique_ptr<page> const& page)
+                       {
+                         return page->buffer == range.buffer;
+                       }
+                     )
+      );
+
+    if (it != _pages.end())
+    {
+      (*it)->allocator.free (range.offset, range.size);
+
+      if ((*it)->allocator.empty())
+      {
+        gl.deleteBuffers (1, &(*it)->buffer);
+        _pages.erase (it);
+      }
+    }
+
+    range = arena_range();
+  }
+
+  template class geometry_arena<GL_ARRAY_BUFFER>;
+  template class geometry_arena<GL_ELEMENT_ARRAY_BUFFER>;
+}
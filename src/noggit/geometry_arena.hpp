@@ -0,0 +1,61 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/range_allocator.hpp>
+#include <opengl/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace noggit
+{
+  //! \brief A part of one of the arena's buffers.
+  struct arena_range
+  {
+    GLuint buffer = 0;
+    std::size_t offset = 0;
+    std::size_t size = 0;
+
+    //! \brief offset as expected by gl*Pointer and glDraw*Elements
+    GLvoid const* pointer (std::size_t offset_in_range = 0) const
+    {
+      return reinterpret_cast<GLvoid const*> (offset + offset_in_range);
+    }
+  };
+
+  //! \brief Static geometry of all models and WMOs packed into a few large
+  //! GL buffers, so drawing doesn't rebind a small buffer per object and
+  //! indices don't have to be sent from client memory for every draw call.
+  //! \note main thread only, like everything else touching GL
+  template<GLenum target>
+    class geometry_arena
+  {
+  public:
+    static geometry_arena* getInstance();
+
+    //! \brief Copy data into a free part of one of the buffers, a new buffer
+    //! is created when none has enough room left.
+    arena_range allocate (std::size_t size, GLvoid const* data);
+    //! \brief Give the range back, buffers without any ranges are deleted.
+    void free (arena_range&);
+
+    std::size_t buffers() const { return _pages.size(); }
+
+  private:
+    struct page
+    {
+      page (std::size_t size);
+
+      GLuint buffer;
+      range_allocator allocator;
+    };
+
+    std::vector<std::unique_ptr<page>> _pages;
+  };
+
+  using vertex_arena = geometry_arena<GL_ARRAY_BUFFER>;
+  using index_arena = geometry_arena<GL_ELEMENT_ARRAY_BUFFER>;
+}
@@ -0,0 +1,262 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <math/frustum.hpp>
+#include <math/ray.hpp>
+#include <noggit/MapHeaders.h>
+#include <noggit/instance_grid.hpp>
+#include <noggit/terrain_picking.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace noggit
+{
+  namespace
+  {
+    // a quarter tile: small enough for doodads, big WMOs still only span
+    // a few dozen cells
+    float const cell_size (TILESIZE / 4.0f);
+    std::int64_t const cells_per_side (64 * 4);
+
+    void sort_unique (std::vector<instance_grid::uid>& uids)
+    {
+      std::sort (uids.begin(), uids.end());
+      uids.erase (std::unique (uids.begin(), uids.end()), uids.end());
+    }
+  }
+
+  template<typename Fun>
+    void instance_grid::for_each_cell_key (bounds const& box, Fun&& fun) const
+  {
+    // everything off the map ends up in the border cells
+    auto const cell_coordinate
+      ( [] (float position)
+        {
+          return std::int64_t (std::max (-1.0f, std::min (std::floor (position / cell_size), float (cells_per_side))));
+        }
+      );
+
+    std::int64_t const min_x (cell_coordinate (box.min.x));
+    std::int64_t const min_z (cell_coordinate (box.min.z));
+    std::int64_t const max_x (cell_coordinate (box.max.x));
+    std::int64_t const max_z (cell_coordinate (box.max.z));
+
+    for (std::int64_t z (min_z); z <= max_z; ++z)
+    {
+      for (std::int64_t x (min_x); x <= max_x; ++x)
+      {
+        fun (key (x, z));
+      }
+    }
+  }
+
+  instance_grid::cell_key instance_grid::key (std::int64_t x, std::int64_t z)
+  {
+    return (x << 32) | (z & 0xffffffff);
+  }
+
+  template<typename Test>
+    void instance_grid::collect (cell_key key, Test&& test, std::vector<uid>& result) const
+  {
+    auto const it (_cells.find (key));
+
+    if (it == _cells.end() || !test (it->second.extents))
+    {
+      return;
+    }
+
+    for (uid id : it->second.instances)
+    {
+      if (test (_instances.at (id)))
+      {
+        result.push_back (id);
+      }
+    }
+  }
+
+  void instance_grid::recalc_extents (cell& c) const
+  {
+    c.extents = _instances.at (c.instances.front());
+
+    for (uid id : c.instances)
+    {
+      bounds const& box (_instances.at (id));
+      c.extents.min = math::min (c.extents.min, box.min);
+      c.extents.max = math::max (c.extents.max, box.max);
+    }
+  }
+
+  void instance_grid::insert (uid id, math::vector_3d const& min, math::vector_3d const& max)
+  {
+    erase (id);
+
+    bounds const box {min, max};
+    _instances.emplace (id, box);
+
+    float const map_size (cells_per_side * cell_size);
+    if (box.min.x < 0.0f || box.min.z < 0.0f || box.max.x > map_size || box.max.z > map_size)
+    {
+      _outside.insert (id);
+    }
+
+    for_each_cell_key
+      ( box
+      , [&] (cell_key key)
+        {
+          auto inserted (_cells.emplace (key, cell {{}, box}));
+          cell& c (inserted.first->second);
+
+          c.instances.push_back (id);
+          c.extents.min = math::min (c.extents.min, box.min);
+          c.extents.max = math::max (c.extents.max, box.max);
+        }
+      );
+  }
+
+  void instance_grid::erase (uid id)
+  {
+    auto const instance (_instances.find (id));
+
+    if (instance == _instances.end())
+    {
+      return;
+    }
+
+    bounds const box (instance->second);
+    _instances.erase (instance);
+    _outside.erase (id);
+
+    for_each_cell_key
+      ( box
+      , [&] (cell_key key)
+        {
+          auto const it (_cells.find (key));
+          cell& c (it->second);
+
+          auto const position (std::find (c.instances.begin(), c.instances.end(), id));
+          std::swap (*position, c.instances.back());
+          c.instances.pop_back();
+
+          if (c.instances.empty())
+          {
+            _cells.erase (it);
+          }
+          else
+          {
+            recalc_extents (c);
+          }
+        }
+      );
+  }
+
+  void instance_grid::clear()
+  {
+    _instances.clear();
+    _cells.clear();
+    _outside.clear();
+  }
+
+  std::vector<instance_grid::uid> instance_grid::overlapping
+    (math::vector_3d const& min, math::vector_3d const& max) const
+  {
+    std::vector<uid> result;
+
+    for_each_cell_key
+      ( bounds {min, max}
+      , [&] (cell_key key)
+        {
+          auto const it (_cells.find (key));
+
+          if (it == _cells.end())
+          {
+            return;
+          }
+
+          for (uid id : it->second.instances)
+          {
+            bounds const& box (_instances.at (id));
+
+            if ( box.min.x <= max.x && min.x <= box.max.x
+              && box.min.z <= max.z && min.z <= box.max.z
+               )
+            {
+              result.push_back (id);
+            }
+          }
+        }
+      );
+
+    sort_unique (result);
+    return result;
+  }
+
+  std::vector<instance_grid::uid> instance_grid::visible (math::frustum const& frustum) const
+  {
+    std::vector<uid> result;
+
+    float const infinity (std::numeric_limits<float>::infinity());
+    bounds area {{infinity, infinity, infinity}, {-infinity, -infinity, -infinity}};
+
+    for (math::vector_3d const& corner : frustum.corners())
+    {
+      area.min = math::min (area.min, corner);
+      area.max = math::max (area.max, corner);
+    }
+
+    // a degenerate frustum can't be bounded, look at all cells
+    if (std::isnan (area.min.x) || std::isnan (area.min.z) || std::isnan (area.max.x) || std::isnan (area.max.z))
+    {
+      area = {{-infinity, 0.0f, -infinity}, {infinity, 0.0f, infinity}};
+    }
+
+    for_each_cell_key
+      ( area
+      , [&] (cell_key key)
+        {
+          collect ( key
+                  , [&] (bounds const& box) { return frustum.intersects (box.min, box.max); }
+                  , result
+                  );
+        }
+      );
+
+    sort_unique (result);
+    return result;
+  }
+
+  std::vector<instance_grid::uid> instance_grid::along (math::ray const& ray) const
+  {
+    std::vector<uid> result;
+
+    auto const hit
+      ([&] (bounds const& box) { return !!ray.intersect_bounds (box.min, box.max); });
+
+    // the cells on the map and the border around it
+    terrain_picking::walk_grid
+      ( ray
+      , {-cell_size, 0.0f, -cell_size}
+      , cell_size
+      , cells_per_side + 2
+      , cells_per_side + 2
+      , 0.0f
+      , std::numeric_limits<float>::infinity()
+      , [&] (std::size_t x, std::size_t z, float, float)
+        {
+          collect (key (std::int64_t (x) - 1, std::int64_t (z) - 1), hit, result);
+          return false;
+        }
+      );
+
+    for (uid id : _outside)
+    {
+      if (hit (_instances.at (id)))
+      {
+        result.push_back (id);
+      }
+    }
+
+    sort_unique (result);
+    return result;
+  }
+}
@@ -0,0 +1,82 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace math
+{
+  class frustum;
+  struct ray;
+}
+
+namespace noggit
+{
+  //! \brief Uniform grid over the map's XZ plane to find model and WMO
+  //! instances by area instead of iterating all of them.
+  //! Every instance is entered in each cell its bounding box touches. Each
+  //! cell also keeps the union of its instances' boxes, so whole cells can
+  //! be skipped for frustum and ray tests. Queries only visit the cells
+  //! under the frustum's bounds or along the ray.
+  class instance_grid
+  {
+  public:
+    using uid = int;
+
+    //! \brief Add an instance, or move it if it is already in the grid.
+    void insert (uid id, math::vector_3d const& min, math::vector_3d const& max);
+    void erase (uid id);
+    void clear();
+
+    std::size_t size() const { return _instances.size(); }
+
+    //! \note All queries return ascending uids without duplicates, which is
+    //! the order of World's instance maps. They test the instances' boxes
+    //! only, the caller still has to test the instance itself.
+
+    //! \brief Instances whose box overlaps the given one on the XZ plane.
+    std::vector<uid> overlapping (math::vector_3d const& min, math::vector_3d const& max) const;
+    //! \brief Instances whose box intersects the frustum.
+    std::vector<uid> visible (math::frustum const& frustum) const;
+    //! \brief Instances whose box is hit by the ray.
+    std::vector<uid> along (math::ray const& ray) const;
+
+  private:
+    struct bounds
+    {
+      math::vector_3d min;
+      math::vector_3d max;
+    };
+
+    struct cell
+    {
+      std::vector<uid> instances;
+      bounds extents;
+    };
+
+    using cell_key = std::int64_t;
+
+    static cell_key key (std::int64_t x, std::int64_t z);
+
+    template<typename Fun>
+      void for_each_cell_key (bounds const& box, Fun&& fun) const;
+
+    void recalc_extents (cell& c) const;
+
+    //! \brief Add the instances of the cell whose box passes test.
+    template<typename Test>
+      void collect (cell_key key, Test&& test, std::vector<uid>& result) const;
+
+    std::unordered_map<uid, bounds> _instances;
+    std::unordered_map<cell_key, cell> _cells;
+    //! \brief Instances reaching off the map, which all end up in the
+    //! border cells. Rays are only walked through the cells on the map.
+    std::unordered_set<uid> _outside;
+  };
+}
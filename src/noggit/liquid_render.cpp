@@ -5,6 +5,7 @@
 #include <noggit/Log.h>
 #include <noggit/TextureManager.h> // TextureManager, Texture
 #include <noggit/World.h>
+#include <noggit/shader_registry.hpp>
 #include <opengl/context.hpp>
 #include <opengl/matrix.hpp>
 #include <opengl/scoped.hpp>
@@ -13,15 +14,96 @@
 #include <boost/format.hpp>
 
 #include <algorithm>
+#include <map>
 #include <string>
 
+namespace
+{
+  char const* const vertex_source
+  { R"code(
+#version 110
+
+attribute vec4 position;
+attribute vec2 tex_coord;
+attribute float depth;
+
+uniform mat4 model_view;
+uniform mat4 projection;
+
+varying float depth_;
+varying vec2 tex_coord_;
+
+void main()
+{
+  depth_ = depth;
+  tex_coord_ = tex_coord;
+
+  gl_Position = projection * model_view * position;
+}
+)code"
+  };
+
+  char const* const fragment_source
+  { R"code(
+#version 110
+
+uniform sampler2D texture;
+uniform vec4 color_light;
+uniform vec4 color_dark;
+uniform float tex_repeat;
+
+varying float depth_;
+varying vec2 tex_coord_;
+
+void main()
+{
+  vec4 texel = texture2D (texture, tex_coord_ / tex_repeat);
+  vec4 lerp = mix (color_dark, color_light, depth_);
+  vec4 tResult = clamp (texel + lerp, 0.0, 1.0); //clamp shouldn't be needed
+  vec4 oColor = clamp (texel + tResult, 0.0, 1.0);
+  gl_FragColor = vec4 (oColor.rgb, lerp.a);
+}
+)code"
+  };
+
+  using animation_frames = std::vector<scoped_blp_texture_reference>;
+
+  //! \note frames stay loaded while any liquid uses them
+  std::shared_ptr<animation_frames const> shared_frames (std::string const& filename)
+  {
+    static std::map<std::string, std::weak_ptr<animation_frames const>> frames_by_filename;
+
+    std::weak_ptr<animation_frames const>& cached (frames_by_filename[filename]);
+
+    if (auto frames = cached.lock())
+    {
+      return frames;
+    }
+
+    auto frames (std::make_shared<animation_frames>());
+    for (int i = 1; i <= 30; ++i)
+    {
+      frames->emplace_back (boost::str (boost::format (filename) % i));
+    }
+
+    cached = frames;
+    return frames;
+  }
+}
+
+opengl::program const& liquid_render::shader_program()
+{
+  return noggit::shader_registry::getInstance()->program
+    ("liquid", vertex_source, fragment_source);
+}
+
 void liquid_render::draw ( std::function<void (opengl::scoped::use_program&)> actual
                          , math::vector_3d water_color_light
                          , math::vector_3d water_color_dark
                          , int animtime
                          )
 {
-  opengl::scoped::use_program water_shader {program};
+  opengl::scoped::use_program water_shader {shader_program()};
 
   prepare_draw (water_shader, water_color_light, water_color_dark, animtime);
 
@@ -43,7 +125,7 @@ void liquid_render::prepare_draw ( opengl::scoped::use_program& water_shader
   water_shader.sampler
     ( "texture"
     , GL_TEXTURE0
-    , _textures[static_cast<std::size_t> (animtime / 60.0f) % _textures.size()].get()
+    , (*_textures)[static_cast<std::size_t> (animtime / 60.0f) % _textures->size()].get()
     );
 }
 
@@ -58,10 +140,5 @@ liquid_render::liquid_render(bool transparency, std::string const& filename)
 
 void liquid_render::setTextures(std::string const& filename)
 {
-  _textures.clear();
-
-  for (int i = 1; i <= 30; ++i)
-  {
-    _textures.emplace_back(boost::str(boost::format(filename) % i));
-  }
+  _textures = shared_frames (filename);
 }
@@ -2,14 +2,14 @@
 
 #pragma once
 
-
 #include <noggit/MPQ.h>
 #include <noggit/TextureManager.h>
 #include <opengl/shader.hpp>
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
-#include <memory>
 
 class liquid_render
 {
@@ -29,62 +29,12 @@ public:
   void setTextures(std::string const& filename);
   void setTransparency(bool b) { _transparency = b; }
 
-  opengl::program const& shader_program() const
-  {
-    return program;
-  }
+  //! \brief The program shared by all liquids, see shader_registry.
+  static opengl::program const& shader_program();
 
 private:
-  opengl::program const program
-    { { GL_VERTEX_SHADER
-      , R"code(
-#version 110
-
-attribute vec4 position;
-attribute vec2 tex_coord;
-attribute float depth;
-
-uniform mat4 model_view;
-uniform mat4 projection;
-
-varying float depth_;
-varying vec2 tex_coord_;
-
-void main()
-{
-  depth_ = depth;
-  tex_coord_ = tex_coord;
-
-  gl_Position = projection * model_view * position;
-}
-)code"
-      }
-    , { GL_FRAGMENT_SHADER
-      , R"code(
-#version 110
-
-uniform sampler2D texture;
-uniform vec4 color_light;
-uniform vec4 color_dark;
-uniform float tex_repeat;
-
-varying float depth_;
-varying vec2 tex_coord_;
-
-void main()
-{
-  vec4 texel = texture2D (texture, tex_coord_ / tex_repeat);
-  vec4 lerp = mix (color_dark, color_light, depth_);
-  vec4 tResult = clamp (texel + lerp, 0.0, 1.0); //clamp shouldn't be needed
-  vec4 oColor = clamp (texel + tResult, 0.0, 1.0);
-  gl_FragColor = vec4 (oColor.rgb, lerp.a);
-}
-)code"
-      }
-    };
-
-
   bool _transparency;
 
-  std::vector<scoped_blp_texture_reference> _textures;
+  // the animation frames, shared by all liquids with the same textures
+  std::shared_ptr<std::vector<scoped_blp_texture_reference> const> _textures;
 };
@@ -6,6 +6,7 @@
 #include <noggit/Log.h>
 #include <noggit/map_index.hpp>
 #include <noggit/World.h>
+#include <noggit/shader_registry.hpp>
 #include <opengl/context.hpp>
 #include <opengl/matrix.hpp>
 
@@ -343,8 +344,9 @@ void map_horizon::render::draw( MapIndex *index
     }
   }
 
-  static opengl::program const program
-      { { GL_VERTEX_SHADER
+  opengl::program const& program
+    ( noggit::shader_registry::getInstance()->program
+        ( "horizon"
         , R"code(
 #version 110
 
@@ -358,8 +360,6 @@ void main()
   gl_Position = projection * model_view * position;
 }
 )code"
-        }
-      , { GL_FRAGMENT_SHADER
         , R"code(
 #version 110
 
@@ -370,8 +370,8 @@ void main()
   gl_FragColor = vec4(color, 1.0);
 }
 )code"
-        }
-      };
+        )
+    );
 
   opengl::scoped::use_program shader {program};
 
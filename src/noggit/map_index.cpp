@@ -1,21 +1,30 @@
 // This file is part of Noggit3, licensed under GNU General Public License (version 3).
 
+#include <noggit/AsyncLoader.h>
 #include <noggit/MPQ.h>
 #include <noggit/MapChunk.h>
 #include <noggit/MapChunk.h>
 #include <noggit/MapTile.h>
 #include <noggit/Misc.h>
 #include <noggit/Project.h>
+#include <noggit/Settings.h>
 #include <noggit/World.h>
 #ifdef USE_MYSQL_UID_STORAGE
   #include <mysql/mysql.h>
 #endif
 #include <noggit/map_index.hpp>
 #include <noggit/uid_storage.hpp>
+#include <noggit/worker_pool.hpp>
 
 #include <boost/range/adaptor/map.hpp>
+#include <boost/thread.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
 #include <forward_list>
+#include <utility>
 
 MapIndex::MapIndex (const std::string &pBasename, int map_id, World* world)
   : basename(pBasename)
@@ -29,6 +38,8 @@ MapIndex::MapIndex (const std::string &pBasename, int map_id, World* world)
   , cz(-1)
   , highestGUID(0)
   , highestGUIDDB(0)
+  , _tile_cache (std::size_t (std::max (Settings::getInstance()->tileCacheSize, 0)) * 1024 * 1024)
+  , _camera_velocity (0.f, 0.f, 0.f)
   , _world (world)
 {
 
@@ -134,11 +145,103 @@ MapIndex::MapIndex (const std::string &pBasename, int map_id, World* world)
   theFile.close();
 }
 
-void MapIndex::saveall (World* world)
+void MapIndex::saveall (World* world, save_progress progress)
 {
+  std::vector<MapTile*> tiles;
+
   for (MapTile* tile : loaded_tiles())
   {
-    tile->saveTile (false, world);
+    tiles.push_back (tile);
+  }
+
+  save_tiles (tiles, world, progress);
+}
+
+void MapIndex::save_tiles (std::vector<MapTile*> const& tiles, World* world, save_progress const& progress)
+{
+  if (tiles.empty())
+  {
+    return;
+  }
+
+  // Find the objects on every tile to save in one pass over all of them,
+  // instead of one pass per tile. Copying instances takes model
+  // references, which is only safe on this thread.
+  std::vector<int> slot (64 * 64, -1);
+  for (std::size_t i = 0; i < tiles.size(); ++i)
+  {
+    slot[tiles[i]->index.z * 64 + tiles[i]->index.x] = i;
+  }
+
+  std::vector<std::vector<WMOInstance>> objects (tiles.size());
+  std::vector<std::vector<ModelInstance>> models (tiles.size());
+
+  auto const for_each_tile_touched
+    ( [&slot] (auto const& instance, auto add)
+      {
+        // one more on the low side as the extents may lie exactly on a tile border
+        int const min_x (std::max (int (std::floor (instance.extents[0].x / TILESIZE)) - 1, 0));
+        int const min_z (std::max (int (std::floor (instance.extents[0].z / TILESIZE)) - 1, 0));
+        int const max_x (std::min (int (std::floor (instance.extents[1].x / TILESIZE)), 63));
+        int const max_z (std::min (int (std::floor (instance.extents[1].z / TILESIZE)), 63));
+
+        for (int z = min_z; z <= max_z; ++z)
+        {
+          for (int x = min_x; x <= max_x; ++x)
+          {
+            math::vector_3d rect[2] = { math::vector_3d (x * TILESIZE, 0.0f, z * TILESIZE)
+                                      , math::vector_3d ((x + 1) * TILESIZE, 0.0f, (z + 1) * TILESIZE)
+                                      };
+
+            if (slot[z * 64 + x] != -1 && instance.isInsideRect (rect))
+            {
+              add (slot[z * 64 + x]);
+            }
+          }
+        }
+      }
+    );
+
+  for (auto const& object : world->mWMOInstances)
+  {
+    for_each_tile_touched
+      (object.second, [&] (int tile) { objects[tile].emplace_back (object.second); });
+  }
+
+  for (auto const& model : world->mModelInstances)
+  {
+    for_each_tile_touched
+      (model.second, [&] (int tile) { models[tile].emplace_back (model.second); });
+  }
+
+  // Serialize and write on all cores, the tiles and objects are only read.
+  // The calling thread saves tiles as well and reports the progress in
+  // between. The first exception thrown while saving is rethrown once all
+  // workers are done.
+  std::atomic<std::size_t> saved (0);
+  boost::thread::id const calling_thread (boost::this_thread::get_id());
+
+  noggit::worker_pool::getInstance()->for_each
+    ( tiles.size()
+    , [&] (std::size_t tile)
+      {
+        tiles[tile]->saveTile (world, objects[tile], models[tile]);
+        std::size_t const done (++saved);
+
+        if (progress && boost::this_thread::get_id() == calling_thread)
+        {
+          progress (done, tiles.size());
+        }
+      }
+    );
+
+  if (progress)
+  {
+    progress (tiles.size(), tiles.size());
+  }
+
+  for (MapTile* tile : tiles)
+  {
     tile->changed = 0;
   }
 }
@@ -215,7 +318,7 @@ void MapIndex::save()
   }
 
   MPQFile f(filename.str());
-  f.setBuffer(wdtFile.data);
+  f.setBuffer(std::move(wdtFile.data));
   f.SaveFile();
   f.close();
 
@@ -231,6 +334,8 @@ void MapIndex::enterTile(const tile_index& tile)
   }
 
   noadt = false;
+
+  bool const moved ((int)tile.x != cx || (int)tile.z != cz);
   cx = tile.x;
   cz = tile.z;
 
@@ -238,7 +343,104 @@ void MapIndex::enterTile(const tile_index& tile)
   {
     for (int px = std::max(cx - 1, 0); px < std::min(cx + 2, 63); ++px)
     {
-      loadTile(tile_index(px, pz));
+      // only count once per tile entered, not every frame
+      if (moved)
+      {
+        _tile_cache.touch(tile_index(px, pz));
+      }
+
+      request_tile(tile_index(px, pz), std::abs(px - cx) + std::abs(pz - cz));
+    }
+  }
+}
+
+void MapIndex::prefetch(math::vector_3d const& camera, float dt)
+{
+  float const lookahead_seconds (2.f);
+  float const max_lookahead (3.f * TILESIZE);
+
+  if (_last_camera && dt > 0.f)
+  {
+    // smoothed over a few frames so a single jump does not fetch random tiles
+    _camera_velocity = _camera_velocity * 0.8f + (camera - *_last_camera) * (0.2f / dt);
+  }
+  _last_camera = camera;
+
+  float const speed (_camera_velocity.length());
+
+  if (speed < 1.f)
+  {
+    return;
+  }
+
+  float const lookahead (std::min (speed * lookahead_seconds, max_lookahead));
+
+  for (float distance (TILESIZE / 2.f); distance <= lookahead; distance += TILESIZE / 2.f)
+  {
+    // after the tiles around the camera
+    request_tile(tile_index (camera + _camera_velocity * (distance / speed)), 2.f + distance / TILESIZE);
+  }
+}
+
+void MapIndex::request_tile(tile_index const& tile, float priority)
+{
+  if (!hasTile(tile) || mTiles[tile.z][tile.x].tile)
+  {
+    return;
+  }
+
+  std::string const filename (tile_filename (tile));
+
+  if (!MPQFile::exists(filename))
+  {
+    LogError << "The requested tile \"" << filename << "\" does not exist! Oo" << std::endl;
+    return;
+  }
+
+  mTiles[tile.z][tile.x].tile = std::make_unique<MapTile> (tile.x, tile.z, filename, mBigAlpha, true, _world, true);
+  _pending_tiles.push_back (tile);
+
+  AsyncLoader::getInstance()->addObject (mTiles[tile.z][tile.x].tile.get(), priority);
+}
+
+void MapIndex::upload_pending_tiles(std::size_t chunk_budget)
+{
+  // drop the ones finished by loadTile() or unloaded in the meantime
+  _pending_tiles.erase
+    ( std::remove_if ( _pending_tiles.begin(), _pending_tiles.end()
+                     , [this] (tile_index const& tile)
+                       {
+                         MapTile* pending (mTiles[tile.z][tile.x].tile.get());
+                         return !pending || pending->is_ready();
+                       }
+                     )
+    , _pending_tiles.end()
+    );
+
+  std::sort ( _pending_tiles.begin(), _pending_tiles.end()
+            , [this] (tile_index const& lhs, tile_index const& rhs)
+              {
+                return std::abs((int)lhs.x - cx) + std::abs((int)lhs.z - cz)
+                     < std::abs((int)rhs.x - cx) + std::abs((int)rhs.z - cz);
+              }
+            );
+
+  for (tile_index const& tile : _pending_tiles)
+  {
+    MapTile* pending (mTiles[tile.z][tile.x].tile.get());
+
+    if (chunk_budget == 0)
+    {
+      break;
+    }
+    if (pending->finishedLoading())
+    {
+      chunk_budget -= pending->finish_chunks (chunk_budget);
+
+      if (pending->is_ready())
+      {
+        _tile_cache.insert(tile, pending->memory_usage());
+      }
     }
   }
 }
@@ -294,30 +496,52 @@ MapTile* MapIndex::loadTile(const tile_index& tile)
     return nullptr;
   }
 
-  if (tileLoaded(tile))
+  if (MapTile* pending = mTiles[tile.z][tile.x].tile.get())
   {
-    return mTiles[tile.z][tile.x].tile.get();
+    if (!pending->is_ready())
+    {
+      // take it away from the workers and finish it on this thread
+      AsyncLoader::getInstance()->removeObject(pending);
+
+      if (!pending->finishedLoading())
+      {
+        pending->finishLoading();
+      }
+
+      pending->finish_chunks(256);
+      _tile_cache.insert(tile, pending->memory_usage());
+    }
+
+    return pending;
   }
 
-  std::stringstream filename;
-  filename << "World\\Maps\\" << basename << "\\" << basename << "_" << tile.x << "_" << tile.z << ".adt";
+  std::string const filename (tile_filename (tile));
 
-  if (!MPQFile::exists(filename.str()))
+  if (!MPQFile::exists(filename))
   {
-    LogError << "The requested tile \"" << filename.str() << "\" does not exist! Oo" << std::endl;
+    LogError << "The requested tile \"" << filename << "\" does not exist! Oo" << std::endl;
     return nullptr;
   }
 
-  mTiles[tile.z][tile.x].tile = std::make_unique<MapTile> (tile.x, tile.z, filename.str(), mBigAlpha, true, _world);
+  mTiles[tile.z][tile.x].tile = std::make_unique<MapTile> (tile.x, tile.z, filename, mBigAlpha, true, _world);
+  _tile_cache.insert(tile, mTiles[tile.z][tile.x].tile->memory_usage());
 
   return mTiles[tile.z][tile.x].tile.get();
 }
 
+std::string MapIndex::tile_filename(tile_index const& tile) const
+{
+  std::stringstream filename;
+  filename << "World\\Maps\\" << basename << "\\" << basename << "_" << tile.x << "_" << tile.z << ".adt";
+  return filename.str();
+}
+
 void MapIndex::reloadTile(const tile_index& tile)
 {
   if (tileLoaded(tile))
   {
     mTiles[tile.z][tile.x].tile = nullptr;
+    _tile_cache.erase(tile);
 
     enterTile (tile);
   }
@@ -325,35 +549,41 @@ void MapIndex::reloadTile(const tile_index& tile)
 
 void MapIndex::unloadTiles(const tile_index& tile)
 {
-  if ( ((clock() / CLOCKS_PER_SEC) - this->lastUnloadTime) > 5) // only unload every 5 seconds
-  {
-    int unloadBoundery = 6; // means noggit hold always plus X adts in all direction in ram - perhaps move this into settings file?
-    for (int pz = 0; pz < 64; ++pz)
-    {
-      for (int px = 0; px < 64; ++px)
-      {
-        if (std::abs(px - (int)tile.x) > unloadBoundery || std::abs(pz - (int)tile.z) > unloadBoundery)
-        {
-          tile_index id(px, pz);
-
-          //Only unload adts not marked to save
-          if (getChanged(id) == 0)
+  auto const evicted
+    ( _tile_cache.evict
+        ( [this, &tile] (tile_index const& resident)
           {
-            unloadTile(id);
+            //Only unload adts not marked to save and not around the camera
+            return getChanged(resident) != 0
+                || ( std::abs((int)resident.x - (int)tile.x) <= 1
+                  && std::abs((int)resident.z - (int)tile.z) <= 1
+                   );
           }
-        }
-      }
-    }
-    this->lastUnloadTime = clock() / CLOCKS_PER_SEC;
+        )
+    );
+
+  for (tile_index const& id : evicted)
+  {
+    mTiles[id.z][id.x].tile = nullptr;
+    Log << "Unload Tile " << id.x << "-" << id.z << "\n";
+  }
+
+  if (!evicted.empty())
+  {
+    Log << "Tile cache: " << _tile_cache.resident_tiles() << " tiles, "
+        << _tile_cache.resident_bytes() / (1024 * 1024) << " MiB resident, "
+        << _tile_cache.hits() << " hits, " << _tile_cache.misses() << " misses, "
+        << _tile_cache.evictions() << " evictions\n";
   }
 }
 
 void MapIndex::unloadTile(const tile_index& tile)
 {
-  // unloads a tile with givn cords
-  if (tileLoaded(tile))
+  // unloads a tile with givn cords, streaming or not
+  if (hasTile(tile) && mTiles[tile.z][tile.x].tile)
   {
     mTiles[tile.z][tile.x].tile = nullptr;
+    _tile_cache.erase(tile);
     Log << "Unload Tile " << tile.x << "-" << tile.z << "\n";
   }
 }
@@ -382,21 +612,24 @@ void MapIndex::saveTile(const tile_index& tile, World* world)
 	}
 }
 
-void MapIndex::saveChanged (World* world)
+void MapIndex::saveChanged (World* world, save_progress progress)
 {
   if (changed)
     save();
 
   saveMaxUID();
 
+  std::vector<MapTile*> tiles;
+
   for (MapTile* tile : loaded_tiles())
   {
     if (tile->changed)
     {
-      tile->saveTile (false, world);
-      tile->changed = 0;
+      tiles.push_back (tile);
     }
   }
+
+  save_tiles (tiles, world, progress);
 }
 
 bool MapIndex::hasAGlobalWMO()
@@ -412,7 +645,7 @@ bool MapIndex::hasTile(const tile_index& tile) const
 
 bool MapIndex::tileLoaded(const tile_index& tile) const
 {
-  return hasTile(tile) && mTiles[tile.z][tile.x].tile;
+  return hasTile(tile) && mTiles[tile.z][tile.x].tile && mTiles[tile.z][tile.x].tile->is_ready();
 }
 
 bool MapIndex::hasAdt()
@@ -427,7 +660,8 @@ void MapIndex::setAdt(bool value)
 
 MapTile* MapIndex::getTile(const tile_index& tile) const
 {
-  return (tile.is_valid() ? mTiles[tile.z][tile.x].tile.get() : nullptr);
+  // tiles still streaming in are neither drawn nor edited
+  return (tile.is_valid() && mTiles[tile.z][tile.x].tile && mTiles[tile.z][tile.x].tile->is_ready() ? mTiles[tile.z][tile.x].tile.get() : nullptr);
 }
 
 MapTile* MapIndex::getTileAbove(MapTile* tile) const
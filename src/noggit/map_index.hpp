@@ -5,16 +5,21 @@
 #include <noggit/MapHeaders.h>
 #include <noggit/MapTile.h>
 #include <noggit/Misc.h>
+#include <noggit/tile_cache.hpp>
 #include <noggit/tile_index.hpp>
 
+#include <boost/optional.hpp>
 #include <boost/range/iterator_range.hpp>
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <ctime>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <string>
+#include <vector>
 
 /*!
 \brief This class is only a holder to have easier access to MapTiles and their flags for easier WDT parsing. This is private and for the class World only.
@@ -140,8 +145,15 @@ public:
 
   MapIndex(const std::string& pBasename, int map_id, World*);
 
+  //! \note streams in the surrounding tiles, they are not visible until uploaded
   void enterTile(const tile_index& tile);
+  //! \note loads synchronously, finishing the tile if it is still streaming in
   MapTile *loadTile(const tile_index& tile);
+  //! \brief upload at most chunk_budget chunks of streamed tiles, closest first
+  //! \note needs the GL context, call once per frame
+  void upload_pending_tiles (std::size_t chunk_budget = 32);
+  //! \brief stream in the tiles the camera is heading to
+  void prefetch (math::vector_3d const& camera, float dt);
 
   void setChanged(const tile_index& tile);
   void setChanged(MapTile* tile);
@@ -150,10 +162,13 @@ public:
   void setFlag(bool to, math::vector_3d const& pos, uint32_t flag);
   int getChanged(const tile_index& tile) const;
 
+  //! \brief reports the number of tiles written so far and the total
+  using save_progress = std::function<void (std::size_t saved, std::size_t total)>;
+
   void saveTile(const tile_index& tile, World*);
-  void saveChanged (World*);
+  void saveChanged (World*, save_progress progress = save_progress());
   void reloadTile(const tile_index& tile);
-  void unloadTiles(const tile_index& tile);  // unloads all tiles more then x adts away from given
+  void unloadTiles(const tile_index& tile);  // unloads the least recently used tiles over budget, except around given and changed ones
   void unloadTile(const tile_index& tile);  // unload given tile
   void markOnDisc(const tile_index& tile, bool mto);
   bool isTileExternal(const tile_index& tile) const;
@@ -166,7 +181,7 @@ public:
   void setAdt(bool value);
 
   void save();
-  void saveall (World*);
+  void saveall (World*, save_progress progress = save_progress());
 
   MapTile* getTile(const tile_index& tile) const;
   MapTile* getTileAbove(MapTile* tile) const;
@@ -180,12 +195,20 @@ public:
 
   uint32_t newGUID();
 
+  noggit::tile_cache const& tile_cache() const { return _tile_cache; }
+
   void fixUIDs (World*);
   void searchMaxUID();
   void saveMaxUID();
   void loadMaxUID();
 
 private:
+  std::string tile_filename (tile_index const& tile) const;
+  //! \brief Write the given tiles on the worker pool.
+  //! \note blocks until all are written, progress is reported on the calling thread
+  void save_tiles (std::vector<MapTile*> const& tiles, World*, save_progress const& progress);
+  void request_tile (tile_index const& tile, float priority);
+
 	uint32_t getHighestGUIDFromFile(const std::string& pFilename) const;
 #ifdef USE_MYSQL_UID_STORAGE
   uint32_t getHighestGUIDFromDB() const;
@@ -200,8 +223,6 @@ public:
 private:
   std::string globalWMOName;
 
-  int lastUnloadTime;
-
   // Is the WDT telling us to use a different alphamap structure.
   bool mBigAlpha;
   bool mHasAGlobalWMO;
@@ -225,6 +246,14 @@ private:
   // Holding all MapTiles there can be in a World.
   MapTileEntry mTiles[64][64];
 
+  // Tiles requested by enterTile() that are not ready to be drawn yet.
+  std::vector<tile_index> _pending_tiles;
+  // Tiles that are ready, in the order they were last needed.
+  noggit::tile_cache _tile_cache;
+
+  boost::optional<math::vector_3d> _last_camera;
+  math::vector_3d _camera_velocity;
+
   //! \todo REMOVE!
   World* _world;
 };
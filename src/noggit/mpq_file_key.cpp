@@ -0,0 +1,66 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/mpq_file_key.hpp>
+
+#include <array>
+
+namespace noggit
+{
+  namespace mpq
+  {
+    namespace
+    {
+      std::array<std::uint32_t, 0x500> make_crypt_table()
+      {
+        std::array<std::uint32_t, 0x500> table;
+        std::uint32_t seed (0x00100001);
+
+        for (std::size_t index1 (0); index1 < 0x100; ++index1)
+        {
+          for (std::size_t index2 (index1), i (0); i < 5; ++i, index2 += 0x100)
+          {
+            seed = (seed * 125 + 3) % 0x2AAAAB;
+            std::uint32_t const high ((seed & 0xFFFF) << 0x10);
+            seed = (seed * 125 + 3) % 0x2AAAAB;
+            std::uint32_t const low (seed & 0xFFFF);
+
+            table[index2] = high | low;
+          }
+        }
+
+        return table;
+      }
+
+      std::array<std::uint32_t, 0x500> const crypt_table (make_crypt_table());
+
+      unsigned char normalized (char c)
+      {
+        if (c == '/')
+        {
+          return '\\';
+        }
+        if (c >= 'a' && c <= 'z')
+        {
+          return static_cast<unsigned char> (c - 'a' + 'A');
+        }
+        return static_cast<unsigned char> (c);
+      }
+    }
+
+    std::uint32_t hash_string (char const* begin, char const* end, hash_type type)
+    {
+      std::uint32_t seed1 (0x7FED7FED);
+      std::uint32_t seed2 (0xEEEEEEEE);
+      std::uint32_t const offset (static_cast<std::uint32_t> (type) << 8);
+
+      for (; begin != end; ++begin)
+      {
+        std::uint32_t const c (normalized (*begin));
+        seed1 = crypt_table[offset + c] ^ (seed1 + seed2);
+        seed2 = c + seed1 + seed2 + (seed2 << 5) + 3;
+      }
+
+      return seed1;
+    }
+  }
+}
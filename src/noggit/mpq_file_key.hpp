@@ -0,0 +1,44 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace noggit
+{
+  namespace mpq
+  {
+    //! \brief The two name hashes an MPQ hash table identifies a file by.
+    //! Case and slash direction do not matter, just like inside archives.
+    using file_key = std::uint64_t;
+
+    enum class hash_type : std::uint32_t
+    {
+      table_offset = 0,
+      name_a = 1,
+      name_b = 2,
+      file_key = 3,
+    };
+
+    //! \note the classic MPQ string hash, without allocating a normalized copy
+    std::uint32_t hash_string (char const* begin, char const* end, hash_type);
+
+    inline file_key make_file_key (std::uint32_t name_a, std::uint32_t name_b)
+    {
+      return (file_key (name_a) << 32) | name_b;
+    }
+
+    inline file_key make_file_key (char const* begin, char const* end)
+    {
+      return make_file_key ( hash_string (begin, end, hash_type::name_a)
+                           , hash_string (begin, end, hash_type::name_b)
+                           );
+    }
+
+    inline file_key make_file_key (std::string const& filename)
+    {
+      return make_file_key (filename.data(), filename.data() + filename.size());
+    }
+  }
+}
@@ -0,0 +1,131 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/mpq_listfile.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace noggit
+{
+  namespace mpq
+  {
+    void listfile::add (std::vector<char> contents)
+    {
+      std::transform ( contents.begin(), contents.end(), contents.begin()
+                     , [] (char c)
+                       {
+                         return c == '\\' ? '/'
+                              : c >= 'A' && c <= 'Z' ? static_cast<char> (c - 'A' + 'a')
+                              : c;
+                       }
+                     );
+
+      std::vector<entry> names;
+
+      auto line_begin (contents.begin());
+      while (line_begin != contents.end())
+      {
+        auto const line_end
+          (std::find_if (line_begin, contents.end(), [] (char c) { return c == '\r' || c == '\n'; }));
+
+        if (line_begin != line_end)
+        {
+          names.emplace_back (&*line_begin, std::distance (line_begin, line_end));
+        }
+
+        line_begin = std::find_if (line_end, contents.end(), [] (char c) { return c != '\r' && c != '\n'; });
+      }
+
+      std::sort (names.begin(), names.end());
+      names.erase (std::unique (names.begin(), names.end()), names.end());
+
+      std::vector<entry> merged;
+      boost::mutex::scoped_lock lock (_mutex);
+
+      merged.reserve (_entries.size() + names.size());
+      std::set_union ( _entries.begin(), _entries.end()
+                     , names.begin(), names.end()
+                     , std::back_inserter (merged)
+                     );
+
+      // moving the vector keeps the entries' pointers into it valid
+      _buffers.emplace_back (std::move (contents));
+      _entries = std::move (merged);
+      _compacted = false;
+    }
+
+    void listfile::compact() const
+    {
+      if (_compacted)
+      {
+        return;
+      }
+
+      std::size_t total_size (0);
+      for (entry const& name : _entries)
+      {
+        total_size += name.size();
+      }
+
+      std::vector<char> pool;
+      pool.reserve (total_size);
+      for (entry const& name : _entries)
+      {
+        pool.insert (pool.end(), name.begin(), name.end());
+      }
+
+      char const* position (pool.data());
+      for (entry& name : _entries)
+      {
+        name = entry (position, name.size());
+        position += name.size();
+      }
+
+      _pool = std::move (pool);
+      _buffers.clear();
+      _buffers.shrink_to_fit();
+      _compacted = true;
+    }
+
+    bool listfile::contains (entry filename) const
+    {
+      boost::mutex::scoped_lock lock (_mutex);
+      compact();
+
+      return std::binary_search (_entries.begin(), _entries.end(), filename);
+    }
+
+    listfile::range listfile::with_prefix (entry prefix) const
+    {
+      boost::mutex::scoped_lock lock (_mutex);
+      compact();
+
+      auto const begin (std::lower_bound (_entries.cbegin(), _entries.cend(), prefix));
+      auto const end
+        ( std::partition_point ( begin, _entries.cend()
+                               , [&] (entry const& name)
+                                 {
+                                   return name.starts_with (prefix);
+                                 }
+                               )
+        );
+
+      return range (begin, end);
+    }
+
+    listfile::range listfile::entries() const
+    {
+      boost::mutex::scoped_lock lock (_mutex);
+      compact();
+
+      return range (_entries.cbegin(), _entries.cend());
+    }
+
+    std::size_t listfile::size() const
+    {
+      boost::mutex::scoped_lock lock (_mutex);
+      return _entries.size();
+    }
+  }
+}
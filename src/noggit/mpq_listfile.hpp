@@ -0,0 +1,51 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <boost/range/iterator_range.hpp>
+#include <boost/thread.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace noggit
+{
+  namespace mpq
+  {
+    //! \brief The normalized filenames of all archives' listfiles.
+    //! Filenames are kept sorted and deduplicated in one contiguous pool
+    //! instead of one heap string each, which makes both exact and prefix
+    //! lookups binary searches.
+    class listfile
+    {
+    public:
+      using entry = boost::string_ref;
+      using range = boost::iterator_range<std::vector<entry>::const_iterator>;
+
+      //! \brief Add the raw contents of a (listfile), one name per line.
+      //! \note Parsing, normalizing and sorting happen on the calling
+      //! thread, only merging into the shared list is serialized.
+      void add (std::vector<char> contents);
+
+      //! \note All queries take normalized names, see normalized_filename().
+      //! Returned entries stay valid until the next add().
+      bool contains (entry filename) const;
+      range with_prefix (entry prefix) const;
+      range entries() const;
+      std::size_t size() const;
+
+    private:
+      //! \brief Copy all entries into a fresh pool and drop the per-archive
+      //! buffers they pointed into so far.
+      //! \note pre-cond: _mutex is held
+      void compact() const;
+
+      mutable std::vector<std::vector<char>> _buffers;
+      mutable std::vector<char> _pool;
+      mutable std::vector<entry> _entries;
+      mutable bool _compacted = true;
+      mutable boost::mutex _mutex;
+    };
+  }
+}
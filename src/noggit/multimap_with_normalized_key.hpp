@@ -3,72 +3,336 @@
 #pragma once
 
 #include <noggit/Log.h>
-#include <noggit/MPQ.h>
 
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
 #include <functional>
-#include <map>
+#include <list>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace noggit
 {
+  //! \brief Reference counted assets by normalized filename, in a single
+  //! open addressing table keyed by the hash of the normalized name.
+  //! \note Looking up an asset that is already loaded normalizes into a
+  //! reused buffer and doesn't allocate. Not thread safe, all users are on
+  //! the main thread.
+  //! \note Elements losing their last reference are kept in least recently
+  //! used order while their cost sums up to at most the unused budget, so
+  //! acquiring them again shortly after doesn't reload them.
   template<typename T>
     struct multimap_with_normalized_key
   {
-    multimap_with_normalized_key (std::function<std::string (std::string)> normalize = &mpq::normalized_filename)
+    //! \brief Writes the normalized form of the first argument into the
+    //! second, which is reused between calls.
+    using normalizer = std::function<void (boost::string_ref, std::string&)>;
+    //! \brief Approximate bytes an unused element keeps allocated, or
+    //! none if it may not be kept, e.g. as it is still being loaded.
+    using cost_function = std::function<boost::optional<std::size_t> (T const&)>;
+
+    //! \brief An element together with the number of references to it.
+    //! Entries are allocated once and never move, so references keep a
+    //! pointer to them and copying or comparing those is O(1).
+    struct entry
+    {
+      template<typename... Args>
+        entry (std::string key_, std::size_t hash_, Args&&... args)
+          : key (std::move (key_))
+          , hash (hash_)
+          , value (key, std::forward<Args> (args)...)
+      {}
+
+      entry (entry const&) = delete;
+      entry& operator= (entry const&) = delete;
+
+      std::string const key;
+      std::size_t const hash;
+      T value;
+      std::size_t references = 0;
+
+    private:
+      friend struct multimap_with_normalized_key;
+
+      bool _unused = false;
+      std::size_t _unused_cost = 0;
+      typename std::list<entry*>::iterator _unused_position;
+    };
+
+    //! \note without a cost function unused elements are destroyed at once
+    explicit multimap_with_normalized_key ( normalizer normalize
+                                          , cost_function cost = nullptr
+                                          )
       : _normalize (std::move (normalize))
+      , _cost (std::move (cost))
+      , _slots (initial_slots)
     {}
 
+    multimap_with_normalized_key (multimap_with_normalized_key const&) = delete;
+    multimap_with_normalized_key& operator= (multimap_with_normalized_key const&) = delete;
+
     ~multimap_with_normalized_key()
     {
-      apply ( [&] (std::string const& key, T const&)
-              {
-                LogDebug << key << ": " << _counts.at (key) << "\n";
-              }
-            );
+      for (slot const& s : _slots)
+      {
+        if (s.element)
+        {
+          LogDebug << s.element->key << ": " << s.element->references << "\n";
+          delete s.element;
+        }
+      }
     }
 
+    //! \brief Add a reference to the element for filename, constructing it
+    //! from the normalized filename and args if there is none yet.
     template<typename... Args>
-      T* emplace (std::string const& filename, Args&&... args)
+      entry* acquire (boost::string_ref filename, Args&&... args)
     {
-      std::string const normalized (_normalize (filename));
-      if (_counts[normalized]++ == 0)
+      std::size_t const hash (normalize (filename));
+      std::size_t index (find_slot (hash));
+
+      if (!_slots[index].element)
+      {
+        // constructing may load other assets and change the table or
+        // throw, so only look for a place once the element exists
+        std::unique_ptr<entry> element
+          (new entry (_key, hash, std::forward<Args> (args)...));
+
+        if ((_size + 1) * 2 > _slots.size())
+        {
+          rehash (_slots.size() * 2);
+        }
+
+        index = empty_slot (hash);
+        _slots[index] = {hash, element.release()};
+        ++_size;
+      }
+
+      entry* const element (_slots[index].element);
+
+      if (element->_unused)
       {
-        return &_elements.emplace ( std::piecewise_construct
-                                  , std::forward_as_tuple (normalized)
-                                  , std::forward_as_tuple (normalized, args...)
-                                  ).first->second;
+        _unused_bytes -= element->_unused_cost;
+        _unused.erase (element->_unused_position);
+        element->_unused = false;
+        ++_revives;
       }
-      return &_elements.at (normalized);
+
+      ++element->references;
+
+      return element;
+    }
+    void add_reference (entry* element)
+    {
+      ++element->references;
     }
-    void erase (std::string const& filename)
+    //! \brief Drop a reference. Without any left the element is kept as
+    //! unused if the budget and its cost allow, otherwise destroyed.
+    void release (entry* element)
     {
-      std::string const normalized (_normalize (filename));
-      if (--_counts.at (normalized) == 0)
+      if (--element->references != 0)
+      {
+        return;
+      }
+
+      boost::optional<std::size_t> const cost
+        (_cost && _unused_budget ? _cost (element->value) : boost::none);
+
+      if (!cost)
       {
-        _elements.erase (normalized);
-        _counts.erase (normalized);
+        destroy (element);
+        return;
       }
+
+      element->_unused = true;
+      element->_unused_cost = *cost;
+      element->_unused_position = _unused.insert (_unused.begin(), element);
+      _unused_bytes += element->_unused_cost;
+
+      evict_unused (_unused_budget);
     }
 
+    //! \brief Set the budget for unused elements, destroying the least
+    //! recently used ones until within.
+    void unused_budget (std::size_t bytes)
+    {
+      _unused_budget = bytes;
+      evict_unused (_unused_budget);
+    }
+    std::size_t unused_budget() const { return _unused_budget; }
+
+    //! \brief Destroy all unused elements, e.g. while their GL context
+    //! is still current.
+    void clear_unused()
+    {
+      evict_unused (0);
+    }
+
+    std::size_t unused_bytes() const { return _unused_bytes; }
+    std::size_t unused_elements() const { return _unused.size(); }
+    //! \brief number of unused elements acquired again
+    std::size_t revives() const { return _revives; }
+    //! \brief number of unused elements destroyed to stay within budget
+    std::size_t evictions() const { return _evictions; }
+
+    //! \return nullptr if nothing is stored for filename
+    T* find (boost::string_ref filename)
+    {
+      slot const& s (_slots[find_slot (normalize (filename))]);
+      return s.element ? &s.element->value : nullptr;
+    }
+
+    std::size_t size() const { return _size; }
+
     void apply (std::function<void (std::string const&, T&)> fun)
     {
-      for (auto& element : _elements)
+      for (slot const& s : _slots)
       {
-        fun (element.first, element.second);
+        if (s.element)
+        {
+          fun (s.element->key, s.element->value);
+        }
       }
     }
     void apply (std::function<void (std::string const&, T const&)> fun) const
     {
-      for (auto const& element : _elements)
+      for (slot const& s : _slots)
       {
-        fun (element.first, element.second);
+        if (s.element)
+        {
+          fun (s.element->key, s.element->value);
+        }
       }
     }
 
   private:
-    std::map<std::string, T> _elements;
-    std::unordered_map<std::string, std::size_t> _counts;
-    std::function<std::string (std::string)> _normalize;
+    struct slot
+    {
+      std::size_t hash;
+      entry* element;
+    };
+
+    static std::size_t const initial_slots = 64;
+
+    void evict_unused (std::size_t budget)
+    {
+      while (_unused_bytes > budget || (!budget && !_unused.empty()))
+      {
+        entry* const element (_unused.back());
+        _unused.pop_back();
+        _unused_bytes -= element->_unused_cost;
+        ++_evictions;
+
+        destroy (element);
+      }
+    }
+
+    //! \note the element is out of the table before its destructor runs,
+    //! which may release other elements
+    void destroy (entry* element)
+    {
+      std::size_t index (element->hash & mask());
+      while (_slots[index].element != element)
+      {
+        index = (index + 1) & mask();
+      }
+
+      erase_slot (index);
+      delete element;
+    }
+
+    std::size_t mask() const { return _slots.size() - 1; }
+
+    //! \brief Normalize filename into _key.
+    //! \return the hash of the normalized key
+    std::size_t normalize (boost::string_ref filename)
+    {
+      _normalize (filename, _key);
+      return std::hash<std::string>() (_key);
+    }
+
+    //! \return the slot holding _key or the empty slot ending its probe
+    std::size_t find_slot (std::size_t hash) const
+    {
+      std::size_t index (hash & mask());
+      while ( _slots[index].element
+           && (_slots[index].hash != hash || _slots[index].element->key != _key)
+            )
+      {
+        index = (index + 1) & mask();
+      }
+      return index;
+    }
+
+    std::size_t empty_slot (std::size_t hash) const
+    {
+      std::size_t index (hash & mask());
+      while (_slots[index].element)
+      {
+        index = (index + 1) & mask();
+      }
+      return index;
+    }
+
+    void rehash (std::size_t slot_count)
+    {
+      std::vector<slot> old (slot_count);
+      std::swap (old, _slots);
+
+      for (slot const& s : old)
+      {
+        if (s.element)
+        {
+          _slots[empty_slot (s.hash)] = s;
+        }
+      }
+    }
+
+    //! \brief Remove without tombstones by moving later elements of the
+    //! probe sequence back into the hole.
+    void erase_slot (std::size_t hole)
+    {
+      _slots[hole] = {0, nullptr};
+      --_size;
+
+      for ( std::size_t index ((hole + 1) & mask())
+          ; _slots[index].element
+          ; index = (index + 1) & mask()
+          )
+      {
+        std::size_t const home (_slots[index].hash & mask());
+
+        // the element can fill the hole if its home is not within
+        // (hole, index], cyclically
+        bool const movable
+          ( hole <= index ? (home <= hole || home > index)
+                          : (home <= hole && home > index)
+          );
+
+        if (movable)
+        {
+          _slots[hole] = _slots[index];
+          _slots[index] = {0, nullptr};
+          hole = index;
+        }
+      }
+    }
+
+    normalizer _normalize;
+    cost_function _cost;
+    std::string _key;
+    std::vector<slot> _slots;
+    std::size_t _size = 0;
+
+    // most recently released in front
+    std::list<entry*> _unused;
+    std::size_t _unused_budget = 0;
+    std::size_t _unused_bytes = 0;
+    std::size_t _revives = 0;
+    std::size_t _evictions = 0;
   };
 }
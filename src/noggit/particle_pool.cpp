@@ -0,0 +1,162 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/particle_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace noggit
+{
+  particle_pool::particle_pool (std::size_t max_particles)
+    : _max_particles (max_particles)
+  {}
+
+  bool particle_pool::spawn (Particle const& particle)
+  {
+    if (_size == _max_particles)
+    {
+      return false;
+    }
+
+    if (_size == capacity())
+    {
+      grow();
+    }
+
+    std::size_t const i (_size++);
+
+    pos.set (i, particle.pos);
+    speed.set (i, particle.speed);
+    down.set (i, particle.down);
+    dir.set (i, particle.dir);
+    origin.set (i, particle.origin);
+    std::copy (particle.corners, particle.corners + 4, corners[i].begin());
+    scale[i] = particle.size;
+    life[i] = particle.life;
+    maxlife[i] = particle.maxlife;
+    tile[i] = particle.tile;
+    r[i] = particle.color.x;
+    g[i] = particle.color.y;
+    b[i] = particle.color.z;
+    a[i] = particle.color.w;
+
+    return true;
+  }
+
+  void particle_pool::integrate ( float dt
+                                , float gravity
+                                , float deceleration
+                                , float slowdown
+                                , life_ramp const& ramp
+                                )
+  {
+    for (std::size_t i (0); i < _size; ++i)
+    {
+      speed.x[i] += down.x[i] * gravity * dt - dir.x[i] * deceleration * dt;
+      speed.y[i] += down.y[i] * gravity * dt - dir.y[i] * deceleration * dt;
+      speed.z[i] += down.z[i] * gravity * dt - dir.z[i] * deceleration * dt;
+    }
+
+    if (slowdown > 0.f)
+    {
+      for (std::size_t i (0); i < _size; ++i)
+      {
+        float const mspeed (std::exp (-1.0f * slowdown * life[i]));
+
+        pos.x[i] += speed.x[i] * mspeed * dt;
+        pos.y[i] += speed.y[i] * mspeed * dt;
+        pos.z[i] += speed.z[i] * mspeed * dt;
+      }
+    }
+    else
+    {
+      for (std::size_t i (0); i < _size; ++i)
+      {
+        pos.x[i] += speed.x[i] * dt;
+        pos.y[i] += speed.y[i] * dt;
+        pos.z[i] += speed.z[i] * dt;
+      }
+    }
+
+    float const mid (ramp.mid);
+    math::vector_4d const* const colors (ramp.colors);
+    float const* const sizes (ramp.sizes);
+
+    for (std::size_t i (0); i < _size; ++i)
+    {
+      life[i] += dt;
+
+      // same as interpolating between the first and second or the second
+      // and third key, but without branches so the loop vectorizes
+      float const rlife (life[i] / maxlife[i]);
+      bool const first_half (rlife <= mid);
+      float const t (first_half ? rlife / mid : (rlife - mid) / (1.0f - mid));
+      float const s (1.0f - t);
+      std::size_t const from (first_half ? 0 : 1);
+
+      scale[i] = sizes[from] * s + sizes[from + 1] * t;
+      r[i] = colors[from].x * s + colors[from + 1].x * t;
+      g[i] = colors[from].y * s + colors[from + 1].y * t;
+      b[i] = colors[from].z * s + colors[from + 1].z * t;
+      a[i] = colors[from].w * s + colors[from + 1].w * t;
+    }
+
+    for (std::size_t i (0); i < _size;)
+    {
+      if (life[i] / maxlife[i] >= 1.0f)
+      {
+        remove (i);
+      }
+      else
+      {
+        ++i;
+      }
+    }
+  }
+
+  void particle_pool::grow()
+  {
+    std::size_t const new_capacity
+      (std::min (_max_particles, std::max<std::size_t> (16, capacity() * 2)));
+
+    pos.resize (new_capacity);
+    speed.resize (new_capacity);
+    down.resize (new_capacity);
+    dir.resize (new_capacity);
+    origin.resize (new_capacity);
+    corners.resize (new_capacity);
+    scale.resize (new_capacity);
+    life.resize (new_capacity);
+    maxlife.resize (new_capacity);
+    tile.resize (new_capacity);
+    r.resize (new_capacity);
+    g.resize (new_capacity);
+    b.resize (new_capacity);
+    a.resize (new_capacity);
+  }
+
+  void particle_pool::remove (std::size_t i)
+  {
+    std::size_t const last (--_size);
+
+    if (i == last)
+    {
+      return;
+    }
+
+    pos.move (last, i);
+    speed.move (last, i);
+    down.move (last, i);
+    dir.move (last, i);
+    origin.move (last, i);
+    corners[i] = corners[last];
+    scale[i] = scale[last];
+    life[i] = life[last];
+    maxlife[i] = maxlife[last];
+    tile[i] = tile[last];
+    r[i] = r[last];
+    g[i] = g[last];
+    b[i] = b[last];
+    a[i] = a[last];
+  }
+}
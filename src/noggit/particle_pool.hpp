@@ -0,0 +1,112 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+#include <math/vector_4d.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+//! \brief A single particle as created by an emitter, the pool stores its
+//! fields in separate arrays.
+struct Particle {
+  math::vector_3d pos, speed, down, origin, dir;
+  math::vector_3d  corners[4];
+  //math::vector_3d tpos;
+  float size, life, maxlife;
+  unsigned int tile;
+  math::vector_4d color;
+};
+
+namespace noggit
+{
+  //! \brief Particles of one emitter kept as structure of arrays, so the
+  //! per tick integration runs over tightly packed floats instead of
+  //! chasing list nodes.
+  //! \note Storage grows up to the emitter's peak particle count and is
+  //! then reused, dead particles are replaced by the last live one.
+  class particle_pool
+  {
+  public:
+    struct vector_3d_array
+    {
+      std::vector<float> x, y, z;
+
+      math::vector_3d operator[] (std::size_t i) const
+      {
+        return {x[i], y[i], z[i]};
+      }
+
+      void set (std::size_t i, math::vector_3d const& value)
+      {
+        x[i] = value.x;
+        y[i] = value.y;
+        z[i] = value.z;
+      }
+
+      void move (std::size_t from, std::size_t to)
+      {
+        x[to] = x[from];
+        y[to] = y[from];
+        z[to] = z[from];
+      }
+
+      void resize (std::size_t size)
+      {
+        x.resize (size);
+        y.resize (size);
+        z.resize (size);
+      }
+    };
+
+    //! \brief size and colour over a particle's lifetime, interpolated
+    //! from the first to the second value until mid and on to the third
+    struct life_ramp
+    {
+      float mid;
+      float sizes[3];
+      math::vector_4d colors[3];
+    };
+
+    explicit particle_pool (std::size_t max_particles);
+
+    std::size_t size() const { return _size; }
+    std::size_t capacity() const { return life.size(); }
+    std::size_t max_particles() const { return _max_particles; }
+    std::size_t free() const { return _max_particles - _size; }
+
+    //! \return false when the pool is at max_particles already
+    bool spawn (Particle const&);
+    void clear() { _size = 0; }
+
+    //! \brief Accelerate, move and age all particles, update their size and
+    //! colour and remove the ones which outlived maxlife.
+    void integrate ( float dt
+                   , float gravity
+                   , float deceleration
+                   , float slowdown
+                   , life_ramp const&
+                   );
+
+    vector_3d_array pos;
+    vector_3d_array speed;
+    vector_3d_array down;
+    vector_3d_array dir;
+    vector_3d_array origin;
+    std::vector<std::array<math::vector_3d, 4>> corners;
+    std::vector<float> scale;
+    std::vector<float> life;
+    std::vector<float> maxlife;
+    std::vector<unsigned int> tile;
+    std::vector<float> r, g, b, a;
+
+  private:
+    void grow();
+    void remove (std::size_t i);
+
+    std::size_t _size = 0;
+    std::size_t _max_particles;
+  };
+}
@@ -0,0 +1,80 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/range_allocator.hpp>
+
+#include <cassert>
+#include <iterator>
+
+namespace noggit
+{
+  range_allocator::range_allocator (std::size_t capacity)
+    : _capacity (capacity)
+    , _used (0)
+  {
+    if (capacity)
+    {
+      _free.emplace (0, capacity);
+    }
+  }
+
+  boost::optional<std::size_t> range_allocator::allocate (std::size_t size, std::size_t alignment)
+  {
+    for (auto it (_free.begin()); it != _free.end(); ++it)
+    {
+      std::size_t const begin (it->first);
+      std::size_t const end (it->first + it->second);
+      std::size_t const aligned ((begin + alignment - 1) & ~(alignment - 1));
+
+      if (aligned + size > end)
+      {
+        continue;
+      }
+
+      _free.erase (it);
+
+      if (aligned != begin)
+      {
+        _free.emplace (begin, aligned - begin);
+      }
+      if (aligned + size != end)
+      {
+        _free.emplace (aligned + size, end - aligned - size);
+      }
+
+      _used += size;
+
+      return aligned;
+    }
+
+    return boost::none;
+  }
+
+  void range_allocator::free (std::size_t offset, std::size_t size)
+  {
+    assert (offset + size <= _capacity);
+
+    _used -= size;
+
+    auto it (_free.emplace (offset, size).first);
+
+    if (it != _free.begin())
+    {
+      auto const previous (std::prev (it));
+
+      if (previous->first + previous->second == offset)
+      {
+        previous->second += it->second;
+        _free.erase (it);
+        it = previous;
+      }
+    }
+
+    auto const next (std::next (it));
+
+    if (next != _free.end() && it->first + it->second == next->first)
+    {
+      it->second += next->second;
+      _free.erase (next);
+    }
+  }
+}
@@ -0,0 +1,34 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <map>
+
+namespace noggit
+{
+  //! \brief Hands out ranges of a fixed size block, e.g. a GL buffer.
+  //! Free ranges are kept sorted by offset and merged with their neighbours
+  //! when freed, allocation takes the first one that is large enough.
+  class range_allocator
+  {
+  public:
+    range_allocator (std::size_t capacity);
+
+    //! \note alignment has to be a power of two
+    boost::optional<std::size_t> allocate (std::size_t size, std::size_t alignment);
+    //! \note size has to be the one passed to allocate()
+    void free (std::size_t offset, std::size_t size);
+
+    std::size_t capacity() const { return _capacity; }
+    std::size_t used() const { return _used; }
+    bool empty() const { return _used == 0; }
+
+  private:
+    std::size_t _capacity;
+    std::size_t _used;
+    std::map<std::size_t, std::size_t> _free;
+  };
+}
@@ -0,0 +1,36 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/shader_registry.hpp>
+
+namespace noggit
+{
+  shader_registry* shader_registry::getInstance()
+  {
+    static shader_registry instance;
+    return &instance;
+  }
+
+  opengl::program const& shader_registry::program ( std::string const& name
+                                                  , char const* vertex_source
+                                                  , char const* fragment_source
+                                                  )
+  {
+    std::unique_ptr<opengl::program>& program (_programs[name]);
+
+    if (!program)
+    {
+      program.reset ( new opengl::program
+                        { {GL_VERTEX_SHADER, vertex_source}
+                        , {GL_FRAGMENT_SHADER, fragment_source}
+                        }
+                    );
+    }
+
+    return *program;
+  }
+
+  void shader_registry::clear()
+  {
+    _programs.clear();
+  }
+}
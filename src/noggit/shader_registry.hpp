@@ -0,0 +1,38 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <opengl/shader.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace noggit
+{
+  //! \brief Shader programs by name, compiled and linked on first use and
+  //! shared by everything drawing with them afterwards.
+  //! \note main thread only, like everything else touching GL. Programs
+  //! belong to the current context, clear() before it goes away.
+  class shader_registry
+  {
+  public:
+    static shader_registry* getInstance();
+
+    //! \brief The program called name, built from the sources if there is
+    //! none yet.
+    //! \note the sources are ignored once the program exists
+    opengl::program const& program ( std::string const& name
+                                   , char const* vertex_source
+                                   , char const* fragment_source
+                                   );
+
+    void clear();
+
+    std::size_t size() const { return _programs.size(); }
+
+  private:
+    std::unordered_map<std::string, std::unique_ptr<opengl::program>> _programs;
+  };
+}
@@ -0,0 +1,92 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/terrain_blur.hpp>
+
+#include <noggit/MapHeaders.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace noggit
+{
+  terrain_blur::terrain_blur ( math::vector_3d const& pos
+                             , float radius
+                             , std::function<float const* (float, float)> const& vertex_height
+                             )
+    : _radius (radius)
+  {
+    int const Rad = (int)(radius / UNITSIZE);
+
+    _rows.reserve (4 * Rad + 1);
+    _x.reserve ((4 * Rad + 1) * (2 * Rad + 1));
+    _height.reserve ((4 * Rad + 1) * (2 * Rad + 1));
+
+    // keep the lattice and the order of the samples of the per vertex
+    // implementation, so the sums are bit for bit the same
+    for (int j = -Rad * 2; j <= Rad * 2; ++j)
+    {
+      float tz = pos.z + j * UNITSIZE / 2;
+      std::size_t const begin (_x.size());
+
+      for (int k = -Rad; k <= Rad; ++k)
+      {
+        float tx = pos.x + k*UNITSIZE + (j % 2) * UNITSIZE / 2.0f;
+
+        // points without terrain never contributed anything
+        if (float const* height = vertex_height (tx, tz))
+        {
+          _x.push_back (tx);
+          _height.push_back (height);
+        }
+      }
+
+      if (begin != _x.size())
+      {
+        _rows.push_back ({tz, begin, _x.size()});
+      }
+    }
+  }
+
+  float terrain_blur::average (math::vector_3d const& vertex) const
+  {
+    float TotalHeight = 0;
+    float TotalWeight = 0;
+
+    for (row const& r : _rows)
+    {
+      float const zdiff (vertex.z - r.z);
+
+      // skip the points that can't be within the radius, the margin keeps
+      // the rounding of the distance below from ever mattering
+      float const reach (_radius * 1.001f);
+
+      if (std::abs (zdiff) > reach)
+      {
+        continue;
+      }
+
+      // the points of a row are sorted by x
+      auto const first (_x.begin() + r.begin);
+      auto const last (_x.begin() + r.end);
+
+      std::size_t const begin (std::lower_bound (first, last, vertex.x - reach) - _x.begin());
+      std::size_t const end (std::upper_bound (first, last, vertex.x + reach) - _x.begin());
+
+      for (std::size_t i (begin); i < end; ++i)
+      {
+        float const xdiff (vertex.x - _x[i]);
+        float const dist2 (std::sqrt (xdiff*xdiff + zdiff*zdiff));
+
+        if (dist2 > _radius)
+        {
+          continue;
+        }
+
+        TotalHeight += (1.0f - dist2 / _radius) * *_height[i];
+        TotalWeight += (1.0f - dist2 / _radius);
+      }
+    }
+
+    return TotalHeight / TotalWeight;
+  }
+}
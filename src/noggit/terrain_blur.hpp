@@ -0,0 +1,48 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace noggit
+{
+  //! \brief The heights a blur brush stroke averages over.
+  //! The brush samples a lattice of points around its center. Every point
+  //! snaps to a terrain vertex, which is looked up once per stroke instead of
+  //! once per blurred vertex. Points are kept as pointers to the vertex
+  //! heights, so vertices already blurred earlier in the same stroke are
+  //! read with their new height, in the same order as before.
+  class terrain_blur
+  {
+  public:
+    //! \param vertex_height returns the height of the vertex the point
+    //! (x, z) snaps to, or nullptr if there is no loaded terrain there
+    terrain_blur ( math::vector_3d const& pos
+                 , float radius
+                 , std::function<float const* (float, float)> const& vertex_height
+                 );
+
+    //! \brief Average of the sampled heights, each weighted by how close it
+    //! is to the vertex. Samples outside of the radius are ignored.
+    float average (math::vector_3d const& vertex) const;
+
+    std::size_t samples() const { return _x.size(); }
+
+  private:
+    struct row
+    {
+      float z;
+      std::size_t begin;
+      std::size_t end;
+    };
+
+    float _radius;
+    std::vector<row> _rows;
+    std::vector<float> _x;
+    std::vector<float const*> _height;
+  };
+}
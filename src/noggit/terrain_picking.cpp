@@ -0,0 +1,56 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/terrain_picking.hpp>
+
+namespace noggit
+{
+  namespace terrain_picking
+  {
+    void chunk_height_tree::update (math::vector_3d const* vertices)
+    {
+      // a cell spans two outer rows of 9 vertices with a row of 8 inner
+      // vertices in between, 17 vertices per row of cells
+      for (int row (0); row < cells; ++row)
+      {
+        for (int column (0); column < cells; ++column)
+        {
+          float const heights[] = { vertices[row * 17 + column].y
+                                  , vertices[row * 17 + column + 1].y
+                                  , vertices[row * 17 + 9 + column].y
+                                  , vertices[(row + 1) * 17 + column].y
+                                  , vertices[(row + 1) * 17 + column + 1].y
+                                  };
+
+          int const index (node_index (3, row, column));
+          _min[index] = *std::min_element (std::begin (heights), std::end (heights));
+          _max[index] = *std::max_element (std::begin (heights), std::end (heights));
+        }
+      }
+
+      for (int level (2); level >= 0; --level)
+      {
+        int const size (1 << level);
+
+        for (int row (0); row < size; ++row)
+        {
+          for (int column (0); column < size; ++column)
+          {
+            int const index (node_index (level, row, column));
+            _min[index] = std::numeric_limits<float>::max();
+            _max[index] = std::numeric_limits<float>::lowest();
+
+            for (int r (row * 2); r < row * 2 + 2; ++r)
+            {
+              for (int c (column * 2); c < column * 2 + 2; ++c)
+              {
+                int const child (node_index (level + 1, r, c));
+                _min[index] = std::min (_min[index], _min[child]);
+                _max[index] = std::max (_max[index], _max[child]);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,256 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/ray.hpp>
+#include <math/vector_3d.hpp>
+
+#include <boost/optional/optional.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace noggit
+{
+  namespace terrain_picking
+  {
+    //! \brief Visit the cells of a uniform grid on the XZ plane in the order
+    //! the ray passes them (2D DDA), starting at distance t_min.
+    //! \note fun (x, z, t_enter, t_exit) returns true to stop the walk.
+    template<typename Fun>
+      void walk_grid ( math::ray const& ray
+                     , math::vector_3d const& grid_origin
+                     , float cell_size
+                     , std::size_t cells_x
+                     , std::size_t cells_z
+                     , float t_min
+                     , float t_max
+                     , Fun&& fun
+                     )
+    {
+      float const infinity (std::numeric_limits<float>::infinity());
+
+      float const origin[2] = { ray.origin().x - grid_origin.x
+                              , ray.origin().z - grid_origin.z
+                              };
+      float const direction[2] = {ray.direction().x, ray.direction().z};
+      float const extent[2] = {cells_x * cell_size, cells_z * cell_size};
+      long const cells[2] = {static_cast<long> (cells_x), static_cast<long> (cells_z)};
+
+      // clip to the grid first, the ray may start outside of it
+      for (int axis (0); axis < 2; ++axis)
+      {
+        if (direction[axis] == 0.f)
+        {
+          if (origin[axis] < 0.f || origin[axis] > extent[axis])
+          {
+            return;
+          }
+          continue;
+        }
+
+        float const t0 (-origin[axis] / direction[axis]);
+        float const t1 ((extent[axis] - origin[axis]) / direction[axis]);
+
+        t_min = std::max (t_min, std::min (t0, t1));
+        t_max = std::min (t_max, std::max (t0, t1));
+      }
+
+      if (t_min > t_max)
+      {
+        return;
+      }
+
+      long cell[2];
+      long step[2];
+      float t_next[2];
+      float t_delta[2];
+
+      for (int axis (0); axis < 2; ++axis)
+      {
+        float const position (origin[axis] + direction[axis] * t_min);
+        cell[axis] = std::min ( cells[axis] - 1
+                              , std::max (0L, static_cast<long> (std::floor (position / cell_size)))
+                              );
+
+        if (direction[axis] > 0.f)
+        {
+          step[axis] = 1;
+          t_next[axis] = ((cell[axis] + 1) * cell_size - origin[axis]) / direction[axis];
+          t_delta[axis] = cell_size / direction[axis];
+        }
+        else if (direction[axis] < 0.f)
+        {
+          step[axis] = -1;
+          t_next[axis] = (cell[axis] * cell_size - origin[axis]) / direction[axis];
+          t_delta[axis] = -cell_size / direction[axis];
+        }
+        else
+        {
+          step[axis] = 0;
+          t_next[axis] = infinity;
+          t_delta[axis] = infinity;
+        }
+      }
+
+      float t (t_min);
+
+      for (;;)
+      {
+        int const axis (t_next[0] < t_next[1] ? 0 : 1);
+        float const t_exit (std::min (t_next[axis], t_max));
+
+        if (fun (static_cast<std::size_t> (cell[0]), static_cast<std::size_t> (cell[1]), t, t_exit))
+        {
+          return;
+        }
+
+        if (t_exit >= t_max)
+        {
+          return;
+        }
+
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= cells[axis])
+        {
+          return;
+        }
+
+        t = t_exit;
+        t_next[axis] += t_delta[axis];
+      }
+    }
+
+    //! \brief Minimum and maximum height of a chunk's 8x8 cells and of each
+    //! 2x2, 4x4 and 8x8 block of them, to skip most of the chunk when
+    //! intersecting a ray with its triangles.
+    class chunk_height_tree
+    {
+    public:
+      static int const cells = 8;
+
+      //! \brief Rebuild from the chunk's 9x9 + 8x8 interleaved vertices.
+      void update (math::vector_3d const* vertices);
+
+      //! \brief Nearest hit of the ray with the cells below the chunk's
+      //! min corner, in front to back order of the tree's boxes.
+      //! \note cell_hit (row, column) returns the distance the ray hits the
+      //! cell's triangles at, if any.
+      template<typename Fun>
+        boost::optional<float> intersect ( math::ray const& ray
+                                         , math::vector_3d const& min_corner
+                                         , float unit_size
+                                         , Fun&& cell_hit
+                                         ) const
+      {
+        math::vector_3d const max
+          (min_corner.x + cells * unit_size, _max[0], min_corner.z + cells * unit_size);
+        if (!ray.intersect_bounds ({min_corner.x, _min[0], min_corner.z}, max))
+        {
+          return boost::none;
+        }
+
+        float best (std::numeric_limits<float>::infinity());
+        intersect_node (ray, min_corner, unit_size, 0, 0, 0, best, cell_hit);
+
+        if (best == std::numeric_limits<float>::infinity())
+        {
+          return boost::none;
+        }
+        return best;
+      }
+
+      float min_height() const { return _min[0]; }
+      float max_height() const { return _max[0]; }
+
+    private:
+      // 1x1, 2x2, 4x4 and 8x8 nodes, row major
+      static int const node_count = 1 + 4 + 16 + 64;
+
+      static int node_index (int level, int row, int column)
+      {
+        static int const offsets[] = {0, 1, 5, 21};
+        return offsets[level] + row * (1 << level) + column;
+      }
+
+      template<typename Fun>
+        void intersect_node ( math::ray const& ray
+                            , math::vector_3d const& min_corner
+                            , float unit_size
+                            , int level
+                            , int row
+                            , int column
+                            , float& best
+                            , Fun& cell_hit
+                            ) const
+      {
+        if (level == 3)
+        {
+          if (auto distance = cell_hit (row, column))
+          {
+            best = std::min (best, *distance);
+          }
+          return;
+        }
+
+        struct child
+        {
+          float distance;
+          int row;
+          int column;
+        };
+
+        std::array<child, 4> children;
+        std::size_t count (0);
+
+        int const child_level (level + 1);
+        float const size (unit_size * (cells >> child_level));
+
+        for (int r (row * 2); r < row * 2 + 2; ++r)
+        {
+          for (int c (column * 2); c < column * 2 + 2; ++c)
+          {
+            int const index (node_index (child_level, r, c));
+            math::vector_3d const min ( min_corner.x + c * size
+                                      , _min[index]
+                                      , min_corner.z + r * size
+                                      );
+            math::vector_3d const max (min.x + size, _max[index], min.z + size);
+
+            auto const distance (ray.intersect_bounds (min, max));
+            if (!distance || *distance >= best)
+            {
+              continue;
+            }
+
+            // insertion sort, front to back
+            std::size_t i (count++);
+            for (; i > 0 && children[i - 1].distance > *distance; --i)
+            {
+              children[i] = children[i - 1];
+            }
+            children[i] = {*distance, r, c};
+          }
+        }
+
+        for (std::size_t i (0); i < count; ++i)
+        {
+          // a closer hit was found in an earlier child
+          if (children[i].distance > best)
+          {
+            return;
+          }
+
+          intersect_node
+            (ray, min_corner, unit_size, child_level, children[i].row, children[i].column, best, cell_hit);
+        }
+      }
+
+      std::array<float, node_count> _min;
+      std::array<float, node_count> _max;
+    };
+  }
+}
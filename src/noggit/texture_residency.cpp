@@ -0,0 +1,79 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/texture_residency.hpp>
+
+#include <iterator>
+
+namespace noggit
+{
+  texture_residency::texture_residency (std::size_t budget)
+    : _budget (budget)
+  {}
+
+  void texture_residency::touch (std::string const& texture)
+  {
+    auto const position (_positions.find (texture));
+
+    if (position != _positions.end())
+    {
+      _entries.splice (_entries.begin(), _entries, position->second);
+    }
+  }
+
+  void texture_residency::insert (std::string const& texture, std::size_t bytes)
+  {
+    auto const position (_positions.find (texture));
+
+    if (position != _positions.end())
+    {
+      _resident_bytes -= position->second->bytes;
+      position->second->bytes = bytes;
+      _entries.splice (_entries.begin(), _entries, position->second);
+    }
+    else
+    {
+      _entries.push_front ({texture, bytes});
+      _positions.emplace (texture, _entries.begin());
+    }
+
+    _resident_bytes += bytes;
+  }
+
+  void texture_residency::erase (std::string const& texture)
+  {
+    auto const position (_positions.find (texture));
+
+    if (position != _positions.end())
+    {
+      _resident_bytes -= position->second->bytes;
+      _entries.erase (position->second);
+      _positions.erase (position);
+    }
+  }
+
+  std::vector<std::string> texture_residency::evict
+    (std::function<bool (std::string const&)> is_pinned)
+  {
+    std::vector<std::string> evicted;
+
+    for ( auto it (_entries.rbegin())
+        ; it != _entries.rend() && _resident_bytes > _budget
+        ;
+        )
+    {
+      if (is_pinned (it->texture))
+      {
+        ++it;
+        continue;
+      }
+
+      evicted.push_back (it->texture);
+      _resident_bytes -= it->bytes;
+      _positions.erase (it->texture);
+      it = std::list<entry>::reverse_iterator (_entries.erase (std::next (it).base()));
+      ++_evictions;
+    }
+
+    return evicted;
+  }
+}
@@ -0,0 +1,61 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace noggit
+{
+  //! \brief Book keeping for which streamed textures have their full
+  //! resolution mip levels in video memory.
+  //! Textures are kept in least recently used order together with the
+  //! bytes of those levels. Once the sum exceeds the budget, the oldest
+  //! textures that are not pinned are handed out to drop back to their low
+  //! resolution placeholder.
+  class texture_residency
+  {
+  public:
+    texture_residency (std::size_t budget);
+
+    //! \brief Mark a resident texture as just used, no-op if not resident.
+    void touch (std::string const& texture);
+    //! \brief A texture's full resolution got uploaded.
+    void insert (std::string const& texture, std::size_t bytes);
+    //! \brief A texture was deleted or dropped for reasons other than eviction.
+    void erase (std::string const& texture);
+
+    //! \brief Remove the least recently used textures until within budget.
+    //! \note textures for which is_pinned is true are skipped, e.g. ones
+    //! used in the current frame, so the result may stay above budget
+    std::vector<std::string> evict (std::function<bool (std::string const&)> is_pinned);
+
+    void budget (std::size_t bytes) { _budget = bytes; }
+    std::size_t budget() const { return _budget; }
+    std::size_t resident_bytes() const { return _resident_bytes; }
+    std::size_t resident_textures() const { return _entries.size(); }
+    bool resident (std::string const& texture) const { return _positions.count (texture); }
+
+    std::size_t evictions() const { return _evictions; }
+
+  private:
+    struct entry
+    {
+      std::string texture;
+      std::size_t bytes;
+    };
+
+    // most recently used in front
+    std::list<entry> _entries;
+    std::unordered_map<std::string, std::list<entry>::iterator> _positions;
+
+    std::size_t _budget;
+    std::size_t _resident_bytes = 0;
+
+    std::size_t _evictions = 0;
+  };
+}
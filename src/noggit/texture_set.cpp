@@ -14,7 +14,7 @@
 
 #include <boost/utility/in_place_factory.hpp>
 
-void TextureSet::initTextures(MPQFile* f, MapTile* maintile, uint32_t size)
+void TextureSet::initTextures(MPQFile* f, uint32_t size)
 {
   // texture info
   nTextures = size / 16U;
@@ -25,6 +25,13 @@ void TextureSet::initTextures(MPQFile* f, MapTile* maintile, uint32_t size)
     f->read(&texFlags[i], 4);
     f->read(&MCALoffset[i], 4);
     f->read(&effectID[i], 4);
+  }
+}
+
+void TextureSet::loadTextures(MapTile* maintile)
+{
+  for (size_t i = 0; i<nTextures; ++i)
+  {
     textures.emplace_back (maintile->mTextureFilenames[tex[i]]);
   }
 }
@@ -47,6 +54,8 @@ void TextureSet::initAlphamaps(MPQFile* f, size_t nLayers, bool mBigAlpha, bool
   {
     convertToOldAlpha();
   }
+
+  _packed_alphamaps_changed = true;
 }
 
 int TextureSet::addTexture(scoped_blp_texture_reference texture)
@@ -65,6 +74,7 @@ int TextureSet::addTexture(scoped_blp_texture_reference texture)
     if (texLevel)
     {
       alphamaps[texLevel - 1] = boost::in_place();
+      _packed_alphamaps_changed = true;
     }
   }
 
@@ -141,6 +151,8 @@ void TextureSet::swapTexture(int id1, int id2)
         }
       }
     }
+
+    _packed_alphamaps_changed = true;
   }
 }
 
@@ -175,6 +187,8 @@ void TextureSet::eraseTexture(size_t id)
   textures.pop_back();
 
   nTextures--;
+
+  _packed_alphamaps_changed = true;
 }
 
 bool TextureSet::canPaintTexture(scoped_blp_texture_reference texture)
@@ -214,6 +228,69 @@ void TextureSet::bindTexture(size_t id, size_t activeTexture)
   textures[id]->bind();
 }
 
+void TextureSet::bind_alphamaps(size_t activeTexture)
+{
+  opengl::texture::set_active_texture (activeTexture);
+  _packed_alphamaps.bind();
+
+  if (!_packed_alphamaps_changed)
+  {
+    return;
+  }
+
+  std::vector<unsigned char> packed (64 * 64 * 3, 0);
+
+  for (size_t k = 0; k + 1 < nTextures; ++k)
+  {
+    const unsigned char* amap = alphamaps[k]->getAlpha();
+
+    for (size_t i = 0; i < 64 * 64; ++i)
+    {
+      packed[i * 3 + k] = amap[i];
+    }
+  }
+
+  gl.texImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 64, 64, 0, GL_RGB, GL_UNSIGNED_BYTE, packed.data());
+  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  _packed_alphamaps_changed = false;
+}
+
+blp_texture* TextureSet::layer_texture(size_t id) const
+{
+  return id < nTextures ? textures[id].get() : nullptr;
+}
+
+math::vector_2d TextureSet::animation_offset(size_t id, int animtime) const
+{
+  const int spd = (texFlags[id] >> 3) & 0x7;
+  const int dir = texFlags[id] & 0x7;
+  const float texanimxtab[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+  const float texanimytab[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+  const float fdx = -texanimxtab[dir], fdy = texanimytab[dir];
+  const int animspd = (const int)(200 * detail_size);
+  float f = ((static_cast<int>(animtime*(spd / 7.0f))) % animspd) / static_cast<float>(animspd);
+  return math::vector_2d(f*fdx, f*fdy);
+}
+
+std::vector<math::vector_2d> TextureSet::animation_offsets(int animtime) const
+{
+  std::vector<math::vector_2d> offsets(4);
+
+  for (size_t id = 0; id < nTextures; ++id)
+  {
+    if (is_animated(id))
+    {
+      offsets[id] = animation_offset(id, animtime);
+    }
+  }
+
+  return offsets;
+}
+
 void TextureSet::startAnim(int id, int animtime)
 {
   if (is_animated(id))
@@ -222,15 +299,8 @@ void TextureSet::startAnim(int id, int animtime)
     gl.matrixMode(GL_TEXTURE);
     gl.pushMatrix();
 
-    
-    const int spd = (texFlags[id] >> 3) & 0x7;
-    const int dir = texFlags[id] & 0x7;
-    const float texanimxtab[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
-    const float texanimytab[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
-    const float fdx = -texanimxtab[dir], fdy = texanimytab[dir];
-    const int animspd = (const int)(200 * detail_size);
-    float f = ((static_cast<int>(animtime*(spd / 7.0f))) % animspd) / static_cast<float>(animspd);
-    gl.translatef(f*fdx, f*fdy, 0);
+    math::vector_2d const offset (animation_offset(id, animtime));
+    gl.translatef(offset.x, offset.y, 0);
   }
 }
 
@@ -525,6 +595,8 @@ bool TextureSet::paintTexture(float xbase, float zbase, float x, float z, Brush*
     alphamaps[j]->loadTexture();
   }
 
+  _packed_alphamaps_changed = true;
+
   return changed;
 }
 
@@ -576,11 +648,13 @@ void TextureSet::change_texture_flag(scoped_blp_texture_reference tex, std::size
 void TextureSet::setAlpha(size_t id, size_t offset, unsigned char value)
 {
   alphamaps[id]->setAlpha(offset, value);
+  _packed_alphamaps_changed = true;
 }
 
 void TextureSet::setAlpha(size_t id, unsigned char *amap)
 {
   alphamaps[id]->setAlpha(amap);
+  _packed_alphamaps_changed = true;
 }
 
 unsigned char TextureSet::getAlpha(size_t id, size_t offset)
@@ -766,6 +840,8 @@ void TextureSet::convertToBigAlpha()
     alphamaps[k]->setAlpha(tab + 4096 * k);
     alphamaps[k]->loadTexture();
   }
+
+  _packed_alphamaps_changed = true;
 }
 
 void TextureSet::convertToOldAlpha()
@@ -816,6 +892,8 @@ void TextureSet::convertToOldAlpha()
     alphamaps[k]->setAlpha(tab[k]);
     alphamaps[k]->loadTexture();
   }
+
+  _packed_alphamaps_changed = true;
 }
 
 void TextureSet::mergeAlpha(size_t id1, size_t id2)
@@ -874,6 +952,8 @@ void TextureSet::mergeAlpha(size_t id1, size_t id2)
     alphamaps[k]->loadTexture();
   }
 
+  _packed_alphamaps_changed = true;
+
   eraseTexture(id2);
 }
 
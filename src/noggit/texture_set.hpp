@@ -2,11 +2,14 @@
 
 #pragma once
 
+#include <math/vector_2d.hpp>
 #include <noggit/MPQ.h>
 #include <noggit/alphamap.hpp>
+#include <opengl/texture.hpp>
 
 #include <cstdint>
 #include <array>
+#include <vector>
 
 class Brush;
 class MapTile;
@@ -14,14 +17,26 @@ class MapTile;
 class TextureSet
 {
 public:
-  void initTextures(MPQFile* f, MapTile *maintile, uint32_t size);
+  //! \note reading the layers doesn't touch GL or the TextureManager, so
+  //! may be done on a loader thread. loadTextures() then acquires them.
+  void initTextures(MPQFile* f, uint32_t size);
   void initAlphamaps(MPQFile* f, size_t nLayers, bool mBigAlpha, bool doNotFixAlpha);
+  void loadTextures(MapTile* maintile);
 
   void startAnim(int id, int animtime);
   void stopAnim(int id);
 
   void bindTexture(size_t id, size_t activeTexture);
   void bindAlphamap(size_t id, size_t activeTexture);
+  //! \brief Bind the alphamaps of the layers 1 to 3 packed into the red,
+  //! green and blue channel of a single texture, uploaded when changed.
+  void bind_alphamaps(size_t activeTexture);
+
+  //! \return nullptr if there is no such layer
+  blp_texture* layer_texture(size_t id) const;
+  //! \brief Texture coordinate offsets of all four layers, startAnim()
+  //! translates the texture matrix by the same.
+  std::vector<math::vector_2d> animation_offsets(int animtime) const;
 
   int addTexture(scoped_blp_texture_reference texture);
   void eraseTexture(size_t id);
@@ -59,6 +74,7 @@ public:
 
 private:
   void alphas_to_big_alpha(unsigned char* dest);
+  math::vector_2d animation_offset(size_t id, int animtime) const;
   std::vector<char> get_compressed_alpha(std::size_t id, unsigned char* alphas);
 
   std::vector<scoped_blp_texture_reference> textures;
@@ -70,4 +86,7 @@ private:
   unsigned int texFlags[4];
   unsigned int effectID[4];
   unsigned int MCALoffset[4];
+
+  opengl::texture _packed_alphamaps;
+  bool _packed_alphamaps_changed = true;
 };
@@ -0,0 +1,84 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/tile_cache.hpp>
+
+#include <iterator>
+
+namespace noggit
+{
+  tile_cache::tile_cache (std::size_t budget)
+    : _budget (budget)
+  {}
+
+  bool tile_cache::touch (tile_index const& tile)
+  {
+    auto const position (_positions.find (key (tile)));
+
+    if (position == _positions.end())
+    {
+      ++_misses;
+      return false;
+    }
+
+    _entries.splice (_entries.begin(), _entries, position->second);
+    ++_hits;
+    return true;
+  }
+
+  void tile_cache::insert (tile_index const& tile, std::size_t bytes)
+  {
+    auto const position (_positions.find (key (tile)));
+
+    if (position != _positions.end())
+    {
+      _resident_bytes -= position->second->bytes;
+      position->second->bytes = bytes;
+      _entries.splice (_entries.begin(), _entries, position->second);
+    }
+    else
+    {
+      _entries.push_front ({tile, bytes});
+      _positions.emplace (key (tile), _entries.begin());
+    }
+
+    _resident_bytes += bytes;
+  }
+
+  void tile_cache::erase (tile_index const& tile)
+  {
+    auto const position (_positions.find (key (tile)));
+
+    if (position != _positions.end())
+    {
+      _resident_bytes -= position->second->bytes;
+      _entries.erase (position->second);
+      _positions.erase (position);
+    }
+  }
+
+  std::vector<tile_index> tile_cache::evict
+    (std::function<bool (tile_index const&)> is_pinned)
+  {
+    std::vector<tile_index> evicted;
+
+    for ( auto it (_entries.rbegin())
+        ; it != _entries.rend() && _resident_bytes > _budget
+        ;
+        )
+    {
+      if (is_pinned (it->tile))
+      {
+        ++it;
+        continue;
+      }
+
+      evicted.push_back (it->tile);
+      _resident_bytes -= it->bytes;
+      _positions.erase (key (it->tile));
+      it = std::list<entry>::reverse_iterator (_entries.erase (std::next (it).base()));
+      ++_evictions;
+    }
+
+    return evicted;
+  }
+}
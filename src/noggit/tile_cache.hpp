@@ -0,0 +1,69 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/tile_index.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace noggit
+{
+  //! \brief Book keeping for which map tiles stay in memory.
+  //! Tiles are kept in least recently used order together with their
+  //! estimated size. Once the sum exceeds the budget, the oldest tiles that
+  //! are not pinned are handed out for unloading.
+  class tile_cache
+  {
+  public:
+    tile_cache (std::size_t budget);
+
+    //! \brief Mark a resident tile as just used.
+    //! \return false and counts a miss if the tile is not resident
+    bool touch (tile_index const& tile);
+    //! \brief A tile finished loading. Replaces the size if already known.
+    void insert (tile_index const& tile, std::size_t bytes);
+    //! \brief A tile was unloaded for reasons other than eviction.
+    void erase (tile_index const& tile);
+
+    //! \brief Remove the least recently used tiles until within budget.
+    //! \note tiles for which is_pinned is true are skipped, e.g. dirty
+    //! ones, so the result may stay above budget
+    std::vector<tile_index> evict (std::function<bool (tile_index const&)> is_pinned);
+
+    void budget (std::size_t bytes) { _budget = bytes; }
+    std::size_t budget() const { return _budget; }
+    std::size_t resident_bytes() const { return _resident_bytes; }
+    std::size_t resident_tiles() const { return _entries.size(); }
+
+    std::size_t hits() const { return _hits; }
+    std::size_t misses() const { return _misses; }
+    std::size_t evictions() const { return _evictions; }
+
+  private:
+    struct entry
+    {
+      tile_index tile;
+      std::size_t bytes;
+    };
+
+    static std::size_t key (tile_index const& tile)
+    {
+      return tile.z * 64 + tile.x;
+    }
+
+    // most recently used in front
+    std::list<entry> _entries;
+    std::unordered_map<std::size_t, std::list<entry>::iterator> _positions;
+
+    std::size_t _budget;
+    std::size_t _resident_bytes = 0;
+
+    std::size_t _hits = 0;
+    std::size_t _misses = 0;
+    std::size_t _evictions = 0;
+  };
+}
@@ -37,7 +37,7 @@ namespace noggit
                                  , object_paste_params* paste_params
                                  )
             : QWidget(nullptr)
-            , rotationEditor (new rotation_editor())
+            , rotationEditor (new rotation_editor (world))
             , _copy_model_stats (true)
             , selected()
             , pasteMode(PASTE_ON_TERRAIN)
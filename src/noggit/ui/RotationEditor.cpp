@@ -6,6 +6,7 @@
 #include <noggit/ModelInstance.h>
 #include <noggit/Selection.h>
 #include <noggit/WMOInstance.h>
+#include <noggit/World.h>
 #include <util/qt/overload.hpp>
 
 #include <QtWidgets/QFormLayout>
@@ -15,8 +16,9 @@ namespace noggit
 {
   namespace ui
   {
-    rotation_editor::rotation_editor()
+    rotation_editor::rotation_editor (World* world)
       : QWidget (nullptr)
+      , _world (world)
       , rotationVect(nullptr)
       , posVect(nullptr)
       , scale(nullptr)
@@ -73,51 +75,45 @@ namespace noggit
       connect ( _rotation_x, qOverload<double> (&QDoubleSpinBox::valueChanged)
               , [&] (double v)
                 {
-                  rotationVect->x = v;
-                  maybe_updateWMO();
+                  change_selection ([&] { rotationVect->x = v; });
                 }
               );
       connect ( _rotation_z, qOverload<double> (&QDoubleSpinBox::valueChanged)
               , [&] (double v)
                 {
-                  rotationVect->z = v;
-                  maybe_updateWMO();
+                  change_selection ([&] { rotationVect->z = v; });
                 }
               );
       connect ( _rotation_y, qOverload<double> (&QDoubleSpinBox::valueChanged)
               , [&] (double v)
                 {
-                  rotationVect->y = v;
-                  maybe_updateWMO();
+                  change_selection ([&] { rotationVect->y = v; });
                 }
               );
 
       connect ( _position_x, qOverload<double> (&QDoubleSpinBox::valueChanged)
               , [&] (double v)
                 {
-                  posVect->x = v;
-                  maybe_updateWMO();
+                  change_selection ([&] { posVect->x = v; });
                 }
               );
       connect ( _position_z, qOverload<double> (&QDoubleSpinBox::valueChanged)
               , [&] (double v)
                 {
-                  posVect->z = v;
-                  maybe_updateWMO();
+                  change_selection ([&] { posVect->z = v; });
                 }
               );
       connect ( _position_y, qOverload<double> (&QDoubleSpinBox::valueChanged)
               , [&] (double v)
                 {
-                  posVect->y = v;
-                  maybe_updateWMO();
+                  change_selection ([&] { posVect->y = v; });
                 }
               );
 
       connect ( _scale, qOverload<double> (&QDoubleSpinBox::valueChanged)
               , [&] (double v)
                 {
-                  *scale = v;
+                  change_selection ([&] { *scale = v; });
                 }
               );
     }
@@ -125,6 +121,7 @@ namespace noggit
     void rotation_editor::select(selection_type entry)
     {
       _selection = true;
+      _entry = entry;
 
       if (entry.which() == eEntry_Model)
       {
@@ -196,12 +193,28 @@ namespace noggit
       }
     }
 
-    void rotation_editor::maybe_updateWMO()
+    void rotation_editor::change_selection (std::function<void()> const& change)
     {
-      if (_wmoInstance)
+      if (!_selection)
       {
-        _wmoInstance->recalcExtents();
+        return;
       }
+
+      // the tiles the instance leaves have changed as well
+      _world->updateTilesEntry (_entry);
+
+      change();
+
+      if (_entry.which() == eEntry_WMO)
+      {
+        boost::get<selected_wmo_type> (_entry)->recalcExtents();
+      }
+      else
+      {
+        boost::get<selected_model_type> (_entry)->recalcExtents();
+      }
+
+      _world->updateTilesEntry (_entry);
     }
   }
 }
@@ -8,7 +8,10 @@
 #include <QtWidgets/QWidget>
 #include <QDockWidget>
 
+#include <functional>
+
 class WMOInstance;
+class World;
 
 namespace noggit
 {
@@ -17,7 +20,7 @@ namespace noggit
     class rotation_editor : public QWidget
     {
     public:
-      rotation_editor();
+      rotation_editor (World*);
 
       void select(selection_type entry);
       void updateValues();
@@ -26,7 +29,13 @@ namespace noggit
       bool hasFocus() const {return false;}
 
     private:
-      void maybe_updateWMO();
+      //! \brief Apply a change to the selected instance the way the object
+      //! tools do, so the changed tiles and the instance grid follow it.
+      void change_selection (std::function<void()> const& change);
+
+      World* _world;
+      selection_type _entry;
+
       math::vector_3d* rotationVect;
       math::vector_3d* posVect;
       float* scale;
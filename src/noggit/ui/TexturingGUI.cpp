@@ -73,11 +73,11 @@ namespace noggit
       std::vector<std::string> tilesets;
       std::unordered_set<std::string> tilesets_with_specular_variant;
 
-      for (auto const& entry : gListfile)
+      for (auto const& listfile_entry : gListfile.with_prefix ("tileset/"))
       {
-        if ( entry.find ("tileset") != std::string::npos
-          && entry.find (".blp") != std::string::npos
-           )
+        std::string const entry (listfile_entry.to_string());
+
+        if (entry.find (".blp") != std::string::npos)
         {
           auto suffix_pos (entry.find ("_s.blp"));
           if (suffix_pos == std::string::npos)
@@ -0,0 +1,118 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/worker_pool.hpp>
+
+#include <algorithm>
+
+namespace noggit
+{
+  worker_pool* worker_pool::getInstance()
+  {
+    static worker_pool instance
+      (std::max (1u, boost::thread::hardware_concurrency()) - 1);
+    return &instance;
+  }
+
+  worker_pool::worker_pool (std::size_t threads)
+  {
+    for (std::size_t i (0); i < threads; ++i)
+    {
+      _threads.add_thread (new boost::thread (&worker_pool::work, this));
+    }
+  }
+
+  worker_pool::~worker_pool()
+  {
+    {
+      boost::mutex::scoped_lock const lock (_mutex);
+      _stopped = true;
+    }
+
+    _work_available.notify_all();
+    _threads.join_all();
+  }
+
+  void worker_pool::for_each (std::size_t count, std::function<void (std::size_t)> const& job)
+  {
+    if (!count)
+    {
+      return;
+    }
+
+    {
+      boost::mutex::scoped_lock lock (_mutex);
+
+      // a worker that woke up late for the last job may still be checking
+      // for work, the counters can't be reset below its feet
+      _workers_idle.wait (lock, [this] { return _busy == 0; });
+
+      _job = &job;
+      _count = count;
+      _next = 0;
+      _error = nullptr;
+      ++_generation;
+    }
+
+    _work_available.notify_all();
+
+    run_jobs();
+
+    boost::mutex::scoped_lock lock (_mutex);
+    _workers_idle.wait (lock, [this] { return _busy == 0; });
+
+    _job = nullptr;
+
+    if (_error)
+    {
+      std::rethrow_exception (_error);
+    }
+  }
+
+  void worker_pool::run_jobs()
+  {
+    for (std::size_t i (_next++); i < _count; i = _next++)
+    {
+      try
+      {
+        (*_job) (i);
+      }
+      catch (...)
+      {
+        boost::mutex::scoped_lock const lock (_mutex);
+
+        if (!_error)
+        {
+          _error = std::current_exception();
+        }
+      }
+    }
+  }
+
+  void worker_pool::work()
+  {
+    std::size_t generation (0);
+
+    boost::mutex::scoped_lock lock (_mutex);
+
+    while (true)
+    {
+      _work_available.wait
+        (lock, [&] { return _stopped || _generation != generation; });
+
+      if (_stopped)
+      {
+        return;
+      }
+
+      generation = _generation;
+      ++_busy;
+
+      lock.unlock();
+      run_jobs();
+      lock.lock();
+
+      --_busy;
+      _workers_idle.notify_all();
+    }
+  }
+}
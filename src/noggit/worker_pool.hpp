@@ -0,0 +1,51 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+
+namespace noggit
+{
+  //! \brief Threads kept around to split per frame work like skinning over
+  //! all cores without starting threads every frame.
+  class worker_pool
+  {
+  public:
+    //! \brief the pool shared by everything running per frame work
+    static worker_pool* getInstance();
+
+    //! \note the calling thread works as well, so one thread less is started
+    worker_pool (std::size_t threads);
+    ~worker_pool();
+
+    //! \brief Run job for every index in [0, count) and wait for all of
+    //! them. The first exception thrown by a job is rethrown here.
+    //! \note not reentrant, jobs must not call for_each themselves
+    void for_each (std::size_t count, std::function<void (std::size_t)> const& job);
+
+    std::size_t threads() const { return _threads.size() + 1; }
+
+  private:
+    void work();
+    void run_jobs();
+
+    boost::mutex _mutex;
+    boost::condition_variable _work_available;
+    boost::condition_variable _workers_idle;
+
+    std::function<void (std::size_t)> const* _job = nullptr;
+    std::size_t _count = 0;
+    std::atomic<std::size_t> _next {0};
+    std::size_t _generation = 0;
+    std::size_t _busy = 0;
+    bool _stopped = false;
+    std::exception_ptr _error;
+
+    boost::thread_group _threads;
+  };
+}
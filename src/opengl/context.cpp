@@ -34,30 +34,58 @@ namespace opengl
       static constexpr char const* const name = "GL_ARB_vertex_program";
     };
 
+    context::validation current_validation = context::validation::none;
+    // calls left until the next glGetError() in sampled mode
+    std::size_t calls_until_error_check = 1;
+
     struct verify_context_and_check_for_gl_errors
     {
-      template<typename ExtraInfo> verify_context_and_check_for_gl_errors
-          (QOpenGLContext* current_context, char const* function, ExtraInfo&& extra_info)
+      //! \note extra_info is only called on error, so it has to outlive this
+      verify_context_and_check_for_gl_errors ( QOpenGLContext* current_context
+                                             , char const* function
+                                             , std::function<std::string()> const* extra_info = nullptr
+                                             )
         : _current_context (current_context)
         , _function (function)
         , _extra_info (extra_info)
       {
+#ifndef NOGGIT_DO_NOT_CHECK_FOR_OPENGL_ERRORS
+        if ( current_validation != context::validation::full
+          && current_validation != context::validation::sampled
+           )
+        {
+          return;
+        }
+
         if (!_current_context)
         {
-          throw std::runtime_error (_function + ": called without active OpenGL context: no context at all");
+          throw std::runtime_error (std::string (_function) + ": called without active OpenGL context: no context at all");
         }
         if (!_current_context->isValid())
         {
-          throw std::runtime_error (_function + ": called without active OpenGL context: invalid");
+          throw std::runtime_error (std::string (_function) + ": called without active OpenGL context: invalid");
         }
         if (QOpenGLContext::currentContext() != _current_context)
         {
-          throw std::runtime_error (_function + ": called without active OpenGL context: not current context");
+          throw std::runtime_error (std::string (_function) + ": called without active OpenGL context: not current context");
+        }
+
+        if (inside_gl_begin_end)
+        {
+          return;
         }
+
+        if (current_validation == context::validation::full)
+        {
+          _check_for_errors = true;
+        }
+        else if (--calls_until_error_check == 0)
+        {
+          calls_until_error_check = context::sampled_validation_interval;
+          _check_for_errors = true;
+        }
+#endif
       }
-      verify_context_and_check_for_gl_errors (QOpenGLContext* current_context, char const* function)
-        : verify_context_and_check_for_gl_errors (current_context, function, &verify_context_and_check_for_gl_errors::no_extra_info)
-      {}
 
       template<typename Functions>
         Functions* version_functions() const
@@ -65,7 +93,7 @@ namespace opengl
         Functions* f (_current_context->versionFunctions<Functions>());
         if (!f)
         {
-          throw std::runtime_error (_function + ": requires OpenGL functions for version " + typeid (Functions).name());
+          throw std::runtime_error (std::string (_function) + ": requires OpenGL functions for version " + typeid (Functions).name());
         }
         return f;
       }
@@ -74,7 +102,7 @@ namespace opengl
       {
         if (!_current_context->hasExtension (extension_traits<Extension>::name))
         {
-          throw std::runtime_error (_function + ": requires OpenGL extension " + extension_traits<Extension>::name);
+          throw std::runtime_error (std::string (_function) + ": requires OpenGL extension " + extension_traits<Extension>::name);
         }
         std::unique_ptr<Extension> functions (new Extension());
         functions->initializeOpenGLFunctions();
@@ -82,21 +110,22 @@ namespace opengl
       }
 
       QOpenGLContext* _current_context;
-      std::string _function;
-      static std::string no_extra_info() { return {}; }
-      std::function<std::string()> _extra_info;
+      char const* _function;
+      std::function<std::string()> const* _extra_info;
+      bool _check_for_errors = false;
 
       ~verify_context_and_check_for_gl_errors()
       {
 #ifndef NOGGIT_DO_NOT_CHECK_FOR_OPENGL_ERRORS
-        if (inside_gl_begin_end)
+        if (!_check_for_errors)
         {
           return;
         }
 
         std::string errors;
         std::size_t error_count = 0;
-        while (GLenum error = glGetError() && error_count < 10)
+        GLenum error;
+        while (error_count < 10 && (error = glGetError()) != GL_NO_ERROR)
         {
           switch (error)
           {
@@ -121,11 +150,20 @@ namespace opengl
 
         if (!errors.empty())
         {
-          errors += _extra_info();
+          if (_extra_info)
+          {
+            errors += (*_extra_info)();
+          }
+
+          std::string function (_function);
+          if (current_validation == context::validation::sampled)
+          {
+            function += " (or one of the calls since the last check)";
+          }
 #ifndef NOGGIT_DO_NOT_THROW_ON_OPENGL_ERRORS
-          LogError << _function + ":" + errors << "\n";
+          LogError << function + ":" + errors << "\n";
 #else
-          throw std::runtime_error (_function + ":" + errors);
+          throw std::runtime_error (function + ":" + errors);
 #endif
         }
 #endif
@@ -140,20 +178,45 @@ namespace opengl
 
   void context::enable (GLenum target)
   {
+    if (!_state.enable (target))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glEnable (target);
   }
   void context::disable (GLenum target)
   {
+    if (!_state.disable (target))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glDisable (target);
   }
   GLboolean context::isEnabled (GLenum target)
   {
+    if (auto const enabled = _state.is_enabled (target))
+    {
+      return *enabled ? GL_TRUE : GL_FALSE;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glIsEnabled (target);
   }
 
+  void context::validation_level (validation level)
+  {
+    current_validation = level;
+    calls_until_error_check = 1;
+  }
+  context::validation context::validation_level()
+  {
+    return current_validation;
+  }
+
   void context::begin (GLenum target)
   {
     ++inside_gl_begin_end;
@@ -318,11 +381,21 @@ namespace opengl
   }
   void context::depthMask (GLboolean mask)
   {
+    if (!_state.depth_mask (mask))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glDepthMask (mask);
   }
   void context::blendFunc (GLenum sfactor, GLenum dfactor)
   {
+    if (!_state.blend_func (sfactor, dfactor))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glBlendFunc (sfactor, dfactor);
   }
@@ -414,11 +487,17 @@ namespace opengl
   }
   void context::deleteTextures (GLuint count, GLuint* textures)
   {
+    _state.delete_textures (count, textures);
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glDeleteTextures (count, textures);
   }
   void context::bindTexture (GLenum target, GLuint texture)
   {
+    if (!_state.bind_texture (target, texture))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glBindTexture (target, texture);
   }
@@ -439,6 +518,11 @@ namespace opengl
   }
   void context::activeTexture (GLenum target)
   {
+    if (!_state.active_texture (target))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glActiveTexture (target);
   }
@@ -513,11 +597,17 @@ namespace opengl
   }
   void context::deleteBuffers (GLuint count, GLuint* buffers)
   {
+    _state.delete_buffers (count, buffers);
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glDeleteBuffers (count, buffers);
   }
   void context::bindBuffer (GLenum target, GLuint buffer)
   {
+    if (!_state.bind_buffer (target, buffer))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glBindBuffer (target, buffer);
   }
@@ -526,6 +616,11 @@ namespace opengl
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glBufferData (target, size, data, usage);
   }
+  void context::bufferSubData (GLenum target, GLintptr offset, GLsizeiptr size, GLvoid const* data)
+  {
+    verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
+    return _current_context->functions()->glBufferSubData (target, offset, size, data);
+  }
   GLvoid* context::mapBuffer (GLenum target, GLenum access)
   {
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
@@ -536,6 +631,11 @@ namespace opengl
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _.version_functions<QOpenGLFunctions_1_5>()->glUnmapBuffer (target);
   }
+  void context::drawArrays (GLenum mode, GLint first, GLsizei count)
+  {
+    verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
+    return _current_context->functions()->glDrawArrays (mode, first, count);
+  }
   void context::drawElements (GLenum mode, GLsizei count, GLenum type, GLvoid const* indices)
   {
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
@@ -580,16 +680,19 @@ namespace opengl
   }
   void context::newList (GLuint list, GLenum mode)
   {
+    _state.start_recording();
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _.version_functions<QOpenGLFunctions_1_0>()->glNewList (list, mode);
   }
   void context::endList()
   {
+    _state.end_recording();
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _.version_functions<QOpenGLFunctions_1_0>()->glEndList();
   }
   void context::callList (GLuint list)
   {
+    _state.invalidate();
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _.version_functions<QOpenGLFunctions_1_0>()->glCallList (list);
   }
@@ -611,16 +714,15 @@ namespace opengl
   }
   void context::programString (GLenum target, GLenum format, GLsizei len, GLvoid const* pointer)
   {
-    verify_context_and_check_for_gl_errors const _
-      ( _current_context
-      , BOOST_CURRENT_FUNCTION
-      , [this]
+    std::function<std::string()> const extra_info
+      ( [this]
         {
           GLint error_position;
           getIntegerv (GL_PROGRAM_ERROR_POSITION_ARB, &error_position);
           return " at " + std::to_string (error_position) + ": " + reinterpret_cast<char const*> (getString (GL_PROGRAM_ERROR_STRING_ARB));
         }
       );
+    verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION, &extra_info);
     return _.extension_functions<QOpenGLExtension_ARB_vertex_program>()->glProgramStringARB (target, format, len, pointer);
   }
   void context::getProgramiv (GLuint program, GLenum pname, GLint* params)
@@ -724,6 +826,15 @@ namespace opengl
 
   void context::getBooleanv (GLenum target, GLboolean* value)
   {
+    if (target == GL_DEPTH_WRITEMASK)
+    {
+      if (auto const mask = _state.depth_mask())
+      {
+        *value = *mask;
+        return;
+      }
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glGetBooleanv (target, value);
   }
@@ -739,6 +850,12 @@ namespace opengl
   }
   void context::getIntegerv (GLenum target, GLint* value)
   {
+    if (auto const buffer = _state.buffer_binding (target))
+    {
+      *value = static_cast<GLint> (*buffer);
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glGetIntegerv (target, value);
   }
@@ -821,6 +938,11 @@ namespace opengl
   }
   void context::useProgram (GLuint program)
   {
+    if (!_state.use_program (program))
+    {
+      return;
+    }
+
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glUseProgram (program);
   }
@@ -844,6 +966,11 @@ namespace opengl
     return params;
   }
 
+  void context::getActiveAttrib (GLuint program, GLuint index, GLsizei buf_size, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+  {
+    verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
+    return _current_context->functions()->glGetActiveAttrib (program, index, buf_size, length, size, type, name);
+  }
   GLint context::getAttribLocation (GLuint program, GLchar const* name)
   {
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
@@ -865,6 +992,11 @@ namespace opengl
     return _current_context->functions()->glDisableVertexAttribArray (index);
   }
 
+  void context::getActiveUniform (GLuint program, GLuint index, GLsizei buf_size, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+  {
+    verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
+    return _current_context->functions()->glGetActiveUniform (program, index, buf_size, length, size, type, name);
+  }
   GLint context::getUniformLocation (GLuint program, GLchar const* name)
   {
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
@@ -893,6 +1025,11 @@ namespace opengl
     return _current_context->functions()->glUniform1iv(location, count, value);
   }
 
+  void context::uniform2fv (GLint location, GLsizei count, GLfloat const* value)
+  {
+    verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
+    return _current_context->functions()->glUniform2fv (location, count, value);
+  }
   void context::uniform3fv (GLint location, GLsizei count, GLfloat const* value)
   {
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
@@ -943,6 +1080,7 @@ namespace opengl
   }
   void context::popAttrib()
   {
+    _state.invalidate();
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _.version_functions<QOpenGLFunctions_1_0>()->glPopAttrib();
   }
@@ -993,6 +1131,15 @@ namespace opengl
   template void context::bufferData<GL_ARRAY_BUFFER> (GLuint buffer, GLsizeiptr size, GLvoid const* data, GLenum usage);
   template void context::bufferData<GL_ELEMENT_ARRAY_BUFFER> (GLuint buffer, GLsizeiptr size, GLvoid const* data, GLenum usage);
 
+  template<GLenum target>
+    void context::bufferSubData (GLuint buffer, GLintptr offset, GLsizeiptr size, GLvoid const* data)
+  {
+    scoped::buffer_binder<target> const _ (buffer);
+    return bufferSubData (target, offset, size, data);
+  }
+  template void context::bufferSubData<GL_ARRAY_BUFFER> (GLuint buffer, GLintptr offset, GLsizeiptr size, GLvoid const* data);
+  template void context::bufferSubData<GL_ELEMENT_ARRAY_BUFFER> (GLuint buffer, GLintptr offset, GLsizeiptr size, GLvoid const* data);
+
   void context::vertexPointer (GLuint buffer, GLint size, GLenum type, GLsizei stride, GLvoid const* pointer)
   {
     scoped::buffer_binder<GL_ARRAY_BUFFER> const _ (buffer);
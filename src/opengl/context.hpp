@@ -2,8 +2,11 @@
 
 #pragma once
 
+#include <opengl/state_cache.hpp>
 #include <opengl/types.hpp>
 
+#include <cstddef>
+
 namespace opengl
 {
   struct context
@@ -15,10 +18,12 @@ namespace opengl
         , _old_context (_context._current_context)
       {
         _context._current_context = current_context;
+        _context._state.invalidate();
       }
       ~scoped_setter()
       {
         _context._current_context = _old_context;
+        _context._state.invalidate();
       }
 
       scoped_setter (scoped_setter const&) = delete;
@@ -65,6 +70,35 @@ namespace opengl
     };
 
     QOpenGLContext* _current_context = nullptr;
+    //! \brief State set through this wrapper, forgotten whenever the
+    //! current context is set, as Qt may have changed it in between.
+    state_cache _state;
+
+    //! \brief Calls dropped as redundant since the last reset.
+    state_cache::statistics const& state_statistics() const { return _state.stats(); }
+    void reset_state_statistics() { _state.reset_statistics(); }
+    //! \brief Call after changing state without this wrapper.
+    void invalidate_state_cache() { _state.invalidate(); }
+
+    //! \brief What every call checks. Defaults to none, which costs a
+    //! single branch per call.
+    //! \note NOGGIT_DO_NOT_CHECK_FOR_OPENGL_ERRORS compiles all checks out.
+    enum class validation
+    {
+      //! no checks
+      none,
+      //! current context on every call, glGetError() every
+      //! sampled_validation_interval calls
+      sampled,
+      //! current context and glGetError() on every call, forcing a sync
+      full,
+      //! no checks, the driver reports errors via a KHR_debug logger
+      debug_output,
+    };
+    static std::size_t const sampled_validation_interval = 256;
+
+    static void validation_level (validation);
+    static validation validation_level();
 
     void enable (GLenum);
     void disable (GLenum);
@@ -156,8 +190,10 @@ namespace opengl
     void deleteBuffers (GLuint, GLuint*);
     void bindBuffer (GLenum, GLuint);
     void bufferData (GLenum target, GLsizeiptr size, GLvoid const* data, GLenum usage);
+    void bufferSubData (GLenum target, GLintptr offset, GLsizeiptr size, GLvoid const* data);
     GLvoid* mapBuffer (GLenum target, GLenum access);
     GLboolean unmapBuffer (GLenum);
+    void drawArrays (GLenum mode, GLint first, GLsizei count);
     void drawElements (GLenum mode, GLsizei count, GLenum type, GLvoid const* indices);
     void drawRangeElements (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, GLvoid const* indices);
 
@@ -221,15 +257,18 @@ namespace opengl
     void validate_program (GLuint program);
     GLint get_program (GLuint program, GLenum pname);
 
+    void getActiveAttrib (GLuint program, GLuint index, GLsizei buf_size, GLsizei* length, GLint* size, GLenum* type, GLchar* name);
     GLint getAttribLocation (GLuint program, GLchar const* name);
     void vertexAttribPointer (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLvoid const* pointer);
     void enableVertexAttribArray (GLuint index);
     void disableVertexAttribArray (GLuint index);
 
+    void getActiveUniform (GLuint program, GLuint index, GLsizei buf_size, GLsizei* length, GLint* size, GLenum* type, GLchar* name);
     GLint getUniformLocation (GLuint program, GLchar const* name);
     void uniform1i (GLint location, GLint value);
     void uniform1f (GLint location, GLfloat value);
     void uniform1iv (GLint location, GLsizei count, GLint const* value);
+    void uniform2fv (GLint location, GLsizei count, GLfloat const* value);
     void uniform3fv (GLint location, GLsizei count, GLfloat const* value);
     void uniform4fv (GLint location, GLsizei count, GLfloat const* value);
     void uniformMatrix4fv (GLint location, GLsizei count, GLboolean transpose, GLfloat const* value);
@@ -255,6 +294,8 @@ namespace opengl
 
     template<GLenum target>
       void bufferData (GLuint buffer, GLsizeiptr size, GLvoid const* data, GLenum usage);
+    template<GLenum target>
+      void bufferSubData (GLuint buffer, GLintptr offset, GLsizeiptr size, GLvoid const* data);
 
     void vertexPointer (GLuint buffer, GLint size, GLenum type, GLsizei stride, GLvoid const* pointer);
     void colorPointer (GLuint buffer, GLint size, GLenum type, GLsizei stride, GLvoid const* pointer);
@@ -4,12 +4,15 @@
 #include <math/vector_2d.hpp>
 #include <math/vector_3d.hpp>
 #include <math/vector_4d.hpp>
+#include <noggit/Log.h>
 #include <opengl/context.hpp>
 #include <opengl/scoped.hpp>
 #include <opengl/shader.hpp>
 #include <opengl/texture.hpp>
 
+#include <algorithm>
 #include <list>
+#include <stdexcept>
 
 namespace opengl
 {
@@ -53,20 +56,103 @@ namespace opengl
 
     gl.link_program (_handle);
     gl.validate_program (_handle);
+
+    auto const name_of
+      ( [] (std::vector<GLchar> const& buffer, GLsizei length)
+        {
+          std::string name (buffer.data(), length);
+          // arrays are reported as their first element
+          if (name.size() > 3 && name.compare (name.size() - 3, 3, "[0]") == 0)
+          {
+            name.resize (name.size() - 3);
+          }
+          return name;
+        }
+      );
+
+    {
+      std::vector<GLchar> buffer (gl.get_program (_handle, GL_ACTIVE_UNIFORM_MAX_LENGTH) + 1);
+      GLint const count (gl.get_program (_handle, GL_ACTIVE_UNIFORMS));
+
+      for (GLint i (0); i < count; ++i)
+      {
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        gl.getActiveUniform (_handle, i, buffer.size(), &length, &size, &type, buffer.data());
+
+        std::string const name (name_of (buffer, length));
+
+        // built-in state has no location
+        if (name.compare (0, 3, "gl_") != 0)
+        {
+          _uniform_locations.emplace (name, gl.getUniformLocation (_handle, name.c_str()));
+        }
+      }
+    }
+
+    {
+      std::vector<GLchar> buffer (gl.get_program (_handle, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH) + 1);
+      GLint const count (gl.get_program (_handle, GL_ACTIVE_ATTRIBUTES));
+
+      for (GLint i (0); i < count; ++i)
+      {
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        gl.getActiveAttrib (_handle, i, buffer.size(), &length, &size, &type, buffer.data());
+
+        std::string const name (name_of (buffer, length));
+        GLint const location (gl.getAttribLocation (_handle, name.c_str()));
+
+        if (location != -1)
+        {
+          _attrib_locations.emplace (name, location);
+        }
+      }
+    }
   }
   program::~program()
   {
     gl.deleteProgram (_handle);
   }
 
-  //! \todo cache lookups?
-  GLuint program::uniform_location (std::string const& name) const
+  GLint program::uniform_location (std::string const& name) const
+  {
+    auto const location (_uniform_locations.emplace (name, -1));
+    if (location.second)
+    {
+      LogDebug << "shader program has no active uniform " << name << std::endl;
+    }
+    return location.first->second;
+  }
+  GLint program::attrib_location (std::string const& name) const
   {
-    return gl.getUniformLocation (_handle, name.c_str());
+    auto const location (_attrib_locations.emplace (name, -1));
+    if (location.second)
+    {
+      LogDebug << "shader program has no active attribute " << name << std::endl;
+    }
+    return location.first->second;
   }
-  GLuint program::attrib_location (std::string const& name) const
+
+  bool program::uniform_changed (GLint location, void const* data, std::size_t size) const
   {
-    return gl.getAttribLocation (_handle, name.c_str());
+    if (location == -1)
+    {
+      return false;
+    }
+
+    char const* const bytes (static_cast<char const*> (data));
+    std::vector<char>& value (_uniform_values[location]);
+
+    if (value.size() == size && std::equal (bytes, bytes + size, value.begin()))
+    {
+      return false;
+    }
+
+    value.assign (bytes, bytes + size);
+    return true;
   }
 
   namespace scoped
@@ -87,27 +173,87 @@ namespace opengl
 
     void use_program::uniform (std::string const& name, GLint value)
     {
-      gl.uniform1i (_program.uniform_location (name), value);
+      uniform (_program.uniform_location (name), value);
     }
     void use_program::uniform (std::string const& name, GLfloat value)
     {
-      gl.uniform1f (_program.uniform_location (name), value);
+      uniform (_program.uniform_location (name), value);
     }
     void use_program::uniform (std::string const& name, std::vector<int> const& value)
     {
-      gl.uniform1iv (_program.uniform_location(name), value.size(), value.data());
+      uniform (_program.uniform_location (name), value);
+    }
+    void use_program::uniform (std::string const& name, std::vector<math::vector_2d> const& value)
+    {
+      uniform (_program.uniform_location (name), value);
     }
     void use_program::uniform (std::string const& name, math::vector_3d const& value)
     {
-      gl.uniform3fv (_program.uniform_location (name), 1, value);
+      uniform (_program.uniform_location (name), value);
     }
     void use_program::uniform (std::string const& name, math::vector_4d const& value)
     {
-      gl.uniform4fv (_program.uniform_location (name), 1, value);
+      uniform (_program.uniform_location (name), value);
     }
     void use_program::uniform (std::string const& name, math::matrix_4x4 const& value)
     {
-      gl.uniformMatrix4fv (_program.uniform_location (name), 1, GL_FALSE, value);
+      uniform (_program.uniform_location (name), value);
+    }
+
+    void use_program::uniform (GLint location, GLint value)
+    {
+      if (_program.uniform_changed (location, &value, sizeof (value)))
+      {
+        gl.uniform1i (location, value);
+      }
+    }
+    void use_program::uniform (GLint location, GLfloat value)
+    {
+      if (_program.uniform_changed (location, &value, sizeof (value)))
+      {
+        gl.uniform1f (location, value);
+      }
+    }
+    void use_program::uniform (GLint location, std::vector<int> const& value)
+    {
+      if (_program.uniform_changed (location, value.data(), value.size() * sizeof (int)))
+      {
+        gl.uniform1iv (location, value.size(), value.data());
+      }
+    }
+    void use_program::uniform (GLint location, std::vector<math::vector_2d> const& value)
+    {
+      if (_program.uniform_changed (location, value.data(), value.size() * sizeof (math::vector_2d)))
+      {
+        gl.uniform2fv ( location
+                      , value.size()
+                      , reinterpret_cast<GLfloat const*> (value.data())
+                      );
+      }
+    }
+    void use_program::uniform (GLint location, math::vector_3d const& value)
+    {
+      GLfloat const* const data (value);
+      if (_program.uniform_changed (location, data, 3 * sizeof (GLfloat)))
+      {
+        gl.uniform3fv (location, 1, data);
+      }
+    }
+    void use_program::uniform (GLint location, math::vector_4d const& value)
+    {
+      GLfloat const* const data (value);
+      if (_program.uniform_changed (location, data, 4 * sizeof (GLfloat)))
+      {
+        gl.uniform4fv (location, 1, data);
+      }
+    }
+    void use_program::uniform (GLint location, math::matrix_4x4 const& value)
+    {
+      GLfloat const* const data (value);
+      if (_program.uniform_changed (location, data, 16 * sizeof (GLfloat)))
+      {
+        gl.uniformMatrix4fv (location, 1, GL_FALSE, data);
+      }
     }
 
     void use_program::sampler (std::string const& name, GLenum texture_slot, texture* tex)
@@ -117,48 +263,64 @@ namespace opengl
       tex->bind();
     }
 
+    GLint use_program::enable_attrib (std::string const& name)
+    {
+      GLint const location (_program.attrib_location (name));
+      if (location != -1 && _enabled_vertex_attrib_arrays.emplace (location).second)
+      {
+        gl.enableVertexAttribArray (location);
+      }
+      return location;
+    }
+
     void use_program::attrib (std::string const& name, std::vector<float> const& data)
     {
-      GLuint const location (_program.attrib_location (name));
-      gl.enableVertexAttribArray (location);
-      _enabled_vertex_attrib_arrays.emplace (location);
-      gl.vertexAttribPointer (location, 1, GL_FLOAT, GL_FALSE, 0, data.data());
+      GLint const location (enable_attrib (name));
+      if (location != -1)
+      {
+        gl.vertexAttribPointer (location, 1, GL_FLOAT, GL_FALSE, 0, data.data());
+      }
     }
     void use_program::attrib (std::string const& name, std::vector<math::vector_2d> const& data)
     {
-      GLuint const location (_program.attrib_location (name));
-      gl.enableVertexAttribArray (location);
-      _enabled_vertex_attrib_arrays.emplace (location);
-      gl.vertexAttribPointer (location, 2, GL_FLOAT, GL_FALSE, 0, data.data());
+      GLint const location (enable_attrib (name));
+      if (location != -1)
+      {
+        gl.vertexAttribPointer (location, 2, GL_FLOAT, GL_FALSE, 0, data.data());
+      }
     }
     void use_program::attrib (std::string const& name, std::vector<math::vector_3d> const& data)
     {
-      GLuint const location (_program.attrib_location (name));
-      gl.enableVertexAttribArray (location);
-      _enabled_vertex_attrib_arrays.emplace (location);
-      gl.vertexAttribPointer (location, 3, GL_FLOAT, GL_FALSE, 0, data.data());
+      GLint const location (enable_attrib (name));
+      if (location != -1)
+      {
+        gl.vertexAttribPointer (location, 3, GL_FLOAT, GL_FALSE, 0, data.data());
+      }
     }
     void use_program::attrib (std::string const& name, math::vector_3d const* data)
     {
-      GLuint const location (_program.attrib_location (name));
-      gl.enableVertexAttribArray (location);
-      _enabled_vertex_attrib_arrays.emplace (location);
-      gl.vertexAttribPointer (location, 3, GL_FLOAT, GL_FALSE, 0, data);
+      GLint const location (enable_attrib (name));
+      if (location != -1)
+      {
+        gl.vertexAttribPointer (location, 3, GL_FLOAT, GL_FALSE, 0, data);
+      }
     }
     void use_program::attrib (std::string const& name, GLsizei size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* data)
     {
-      GLuint const location (_program.attrib_location (name));
-      gl.enableVertexAttribArray (location);
-      _enabled_vertex_attrib_arrays.emplace (location);
-      gl.vertexAttribPointer (location, size, type, normalized, stride, data);
+      GLint const location (enable_attrib (name));
+      if (location != -1)
+      {
+        gl.vertexAttribPointer (location, size, type, normalized, stride, data);
+      }
     }
     void use_program::attrib (std::string const& name, GLuint buffer, GLsizei size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* data)
     {
-      GLuint const location (_program.attrib_location (name));
-      gl.enableVertexAttribArray (location);
-      _enabled_vertex_attrib_arrays.emplace (location);
-      scoped::buffer_binder<GL_ARRAY_BUFFER> const bind (buffer);
-      gl.vertexAttribPointer (location, size, type, normalized, stride, data);
+      GLint const location (enable_attrib (name));
+      if (location != -1)
+      {
+        scoped::buffer_binder<GL_ARRAY_BUFFER> const bind (buffer);
+        gl.vertexAttribPointer (location, size, type, normalized, stride, data);
+      }
     }
   }
 }
@@ -5,9 +5,11 @@
 #include <opengl/shader.fwd.hpp>
 #include <opengl/types.hpp>
 
+#include <cstddef>
 #include <initializer_list>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace math
@@ -20,6 +22,8 @@ namespace math
 
 namespace opengl
 {
+  class texture;
+
   struct shader
   {
     shader (GLenum type, std::string const& source);
@@ -46,13 +50,27 @@ namespace opengl
     program& operator= (program const&) = delete;
     program& operator= (program&&) = delete;
 
-  private:
-    GLuint uniform_location (std::string const& name) const;
-    GLuint attrib_location (std::string const& name) const;
+    //! \brief Locations of the active uniforms and attributes, looked up
+    //! once after linking. Arrays are found by their name without [0].
+    //! \note -1 for names the program doesn't use, e.g. because the driver
+    //! optimized them away. Setting them is a no-op, a debug line is logged
+    //! the first time such a name is asked for to spot typos.
+    GLint uniform_location (std::string const& name) const;
+    GLint attrib_location (std::string const& name) const;
 
+  private:
     friend struct scoped::use_program;
 
+    //! \brief Remember the value last uploaded to a uniform.
+    //! \return false if it already has that value
+    bool uniform_changed (GLint location, void const* data, std::size_t size) const;
+
     GLuint _handle;
+    // unknown names are cached as -1 on first use
+    mutable std::unordered_map<std::string, GLint> _uniform_locations;
+    mutable std::unordered_map<std::string, GLint> _attrib_locations;
+    // uniforms keep their values while the program isn't used
+    mutable std::unordered_map<GLint, std::vector<char>> _uniform_values;
   };
 
   namespace scoped
@@ -70,11 +88,23 @@ namespace opengl
       void uniform (std::string const& name, std::vector<int> const&);
       void uniform (std::string const& name, GLint);
       void uniform (std::string const& name, GLfloat);
+      void uniform (std::string const& name, std::vector<math::vector_2d> const&);
       void uniform (std::string const& name, math::vector_3d const&);
       void uniform (std::string const& name, math::vector_4d const&);
       void uniform (std::string const& name, math::matrix_4x4 const&);
       template<typename T> void uniform (std::string const&, T) = delete;
 
+      //! \note by location from program::uniform_location, which skips the
+      //! name lookup in loops
+      void uniform (GLint location, std::vector<int> const&);
+      void uniform (GLint location, GLint);
+      void uniform (GLint location, GLfloat);
+      void uniform (GLint location, std::vector<math::vector_2d> const&);
+      void uniform (GLint location, math::vector_3d const&);
+      void uniform (GLint location, math::vector_4d const&);
+      void uniform (GLint location, math::matrix_4x4 const&);
+      template<typename T> void uniform (GLint, T) = delete;
+
       void sampler (std::string const& name, GLenum texture_slot, texture*);
 
       void attrib (std::string const& name, std::vector<float> const&);
@@ -85,8 +115,10 @@ namespace opengl
       void attrib (std::string const& name, GLuint buffer, GLsizei size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* data);
 
     private:
+      GLint enable_attrib (std::string const& name);
+
       program const& _program;
-      std::set<GLuint> _enabled_vertex_attrib_arrays;
+      std::set<GLint> _enabled_vertex_attrib_arrays;
     };
   }
 }
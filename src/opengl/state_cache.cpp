@@ -0,0 +1,298 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <opengl/state_cache.hpp>
+
+#include <algorithm>
+
+namespace opengl
+{
+  std::size_t state_cache::statistics::dropped() const
+  {
+    return enable + disable + active_texture + bind_texture + bind_buffer
+      + use_program + blend_func + depth_mask;
+  }
+
+  bool state_cache::per_texture_unit (GLenum cap)
+  {
+    switch (cap)
+    {
+    case GL_TEXTURE_1D:
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_CUBE_MAP:
+    case GL_TEXTURE_GEN_S:
+    case GL_TEXTURE_GEN_T:
+    case GL_TEXTURE_GEN_R:
+    case GL_TEXTURE_GEN_Q:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  boost::optional<std::uint64_t> state_cache::key (GLenum cap) const
+  {
+    if (!per_texture_unit (cap))
+    {
+      return std::uint64_t (cap);
+    }
+    if (!_active_texture)
+    {
+      return boost::none;
+    }
+    return (std::uint64_t (*_active_texture) << 32) | cap;
+  }
+
+  bool state_cache::set_enabled (GLenum cap, bool enabled, std::size_t& dropped)
+  {
+    ++_statistics.calls;
+
+    if (_recording)
+    {
+      return true;
+    }
+
+    auto const k (key (cap));
+    if (!k)
+    {
+      return true;
+    }
+
+    auto const it (_enabled.find (*k));
+    if (it != _enabled.end() && it->second == enabled)
+    {
+      ++dropped;
+      return false;
+    }
+
+    _enabled[*k] = enabled;
+    return true;
+  }
+
+  bool state_cache::enable (GLenum cap)
+  {
+    return set_enabled (cap, true, _statistics.enable);
+  }
+  bool state_cache::disable (GLenum cap)
+  {
+    return set_enabled (cap, false, _statistics.disable);
+  }
+
+  bool state_cache::active_texture (GLenum unit)
+  {
+    ++_statistics.calls;
+
+    if (_recording)
+    {
+      return true;
+    }
+    if (_active_texture == unit)
+    {
+      ++_statistics.active_texture;
+      return false;
+    }
+
+    _active_texture = unit;
+    return true;
+  }
+
+  bool state_cache::bind_texture (GLenum target, GLuint texture)
+  {
+    ++_statistics.calls;
+
+    if (_recording)
+    {
+      return true;
+    }
+
+    auto const k (key (target));
+    if (!k)
+    {
+      return true;
+    }
+
+    auto const it (_textures.find (*k));
+    if (it != _textures.end() && it->second == texture)
+    {
+      ++_statistics.bind_texture;
+      return false;
+    }
+
+    _textures[*k] = texture;
+    return true;
+  }
+
+  bool state_cache::bind_buffer (GLenum target, GLuint buffer)
+  {
+    ++_statistics.calls;
+
+    if (_recording)
+    {
+      return true;
+    }
+
+    auto const it (_buffers.find (target));
+    if (it != _buffers.end() && it->second == buffer)
+    {
+      ++_statistics.bind_buffer;
+      return false;
+    }
+
+    _buffers[target] = buffer;
+    return true;
+  }
+
+  bool state_cache::use_program (GLuint program)
+  {
+    ++_statistics.calls;
+
+    if (_recording)
+    {
+      return true;
+    }
+    if (_program == program)
+    {
+      ++_statistics.use_program;
+      return false;
+    }
+
+    _program = program;
+    return true;
+  }
+
+  bool state_cache::blend_func (GLenum sfactor, GLenum dfactor)
+  {
+    ++_statistics.calls;
+
+    if (_recording)
+    {
+      return true;
+    }
+    if (_blend_func == std::make_pair (sfactor, dfactor))
+    {
+      ++_statistics.blend_func;
+      return false;
+    }
+
+    _blend_func = std::make_pair (sfactor, dfactor);
+    return true;
+  }
+
+  bool state_cache::depth_mask (GLboolean flag)
+  {
+    ++_statistics.calls;
+
+    if (_recording)
+    {
+      return true;
+    }
+    if (_depth_mask == flag)
+    {
+      ++_statistics.depth_mask;
+      return false;
+    }
+
+    _depth_mask = flag;
+    return true;
+  }
+
+  boost::optional<bool> state_cache::is_enabled (GLenum cap)
+  {
+    if (_recording)
+    {
+      return boost::none;
+    }
+
+    auto const k (key (cap));
+    if (!k)
+    {
+      return boost::none;
+    }
+
+    auto const it (_enabled.find (*k));
+    if (it == _enabled.end())
+    {
+      return boost::none;
+    }
+
+    ++_statistics.queries;
+    return it->second;
+  }
+
+  boost::optional<GLboolean> state_cache::depth_mask()
+  {
+    if (_recording || !_depth_mask)
+    {
+      return boost::none;
+    }
+
+    ++_statistics.queries;
+    return _depth_mask;
+  }
+
+  boost::optional<GLuint> state_cache::buffer_binding (GLenum binding)
+  {
+    if (_recording)
+    {
+      return boost::none;
+    }
+
+    GLenum const target
+      ( binding == GL_ARRAY_BUFFER_BINDING ? GL_ARRAY_BUFFER
+      : binding == GL_ELEMENT_ARRAY_BUFFER_BINDING ? GL_ELEMENT_ARRAY_BUFFER
+      : 0
+      );
+
+    auto const it (_buffers.find (target));
+    if (!target || it == _buffers.end())
+    {
+      return boost::none;
+    }
+
+    ++_statistics.queries;
+    return it->second;
+  }
+
+  void state_cache::delete_textures (GLsizei count, GLuint const* textures)
+  {
+    for (auto& bound : _textures)
+    {
+      if (std::find (textures, textures + count, bound.second) != textures + count)
+      {
+        bound.second = 0;
+      }
+    }
+  }
+
+  void state_cache::delete_buffers (GLsizei count, GLuint const* buffers)
+  {
+    for (auto& bound : _buffers)
+    {
+      if (std::find (buffers, buffers + count, bound.second) != buffers + count)
+      {
+        bound.second = 0;
+      }
+    }
+  }
+
+  void state_cache::start_recording()
+  {
+    _recording = true;
+  }
+  void state_cache::end_recording()
+  {
+    _recording = false;
+    invalidate();
+  }
+
+  void state_cache::invalidate()
+  {
+    _enabled.clear();
+    _textures.clear();
+    _buffers.clear();
+    _active_texture = boost::none;
+    _program = boost::none;
+    _blend_func = boost::none;
+    _depth_mask = boost::none;
+  }
+}
@@ -0,0 +1,95 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <opengl/types.hpp>
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+namespace opengl
+{
+  //! \brief Shadow copy of the state set via opengl::context, to drop
+  //! enable, disable, bind, blendFunc and depthMask calls that wouldn't
+  //! change anything and to answer queries for it without the driver.
+  //! \note Nothing is assumed about state that wasn't set through the
+  //! cache, so the first call after invalidate() always goes through.
+  class state_cache
+  {
+  public:
+    //! \brief Calls seen since the last reset and how many of each kind
+    //! were dropped.
+    struct statistics
+    {
+      std::size_t calls = 0;
+      std::size_t enable = 0;
+      std::size_t disable = 0;
+      std::size_t active_texture = 0;
+      std::size_t bind_texture = 0;
+      std::size_t bind_buffer = 0;
+      std::size_t use_program = 0;
+      std::size_t blend_func = 0;
+      std::size_t depth_mask = 0;
+      //! glIsEnabled() and glGet*() answered from the cache
+      std::size_t queries = 0;
+
+      std::size_t dropped() const;
+    };
+
+    //! \return false if the call can be dropped
+    bool enable (GLenum cap);
+    bool disable (GLenum cap);
+    bool active_texture (GLenum unit);
+    bool bind_texture (GLenum target, GLuint texture);
+    bool bind_buffer (GLenum target, GLuint buffer);
+    bool use_program (GLuint program);
+    bool blend_func (GLenum sfactor, GLenum dfactor);
+    bool depth_mask (GLboolean flag);
+
+    //! \return none if the driver has to be asked
+    boost::optional<bool> is_enabled (GLenum cap);
+    boost::optional<GLboolean> depth_mask();
+    //! \note binding is the query, e.g. GL_ARRAY_BUFFER_BINDING
+    boost::optional<GLuint> buffer_binding (GLenum binding);
+
+    //! \brief Deleting a bound object binds 0 in its place.
+    void delete_textures (GLsizei count, GLuint const* textures);
+    void delete_buffers (GLsizei count, GLuint const* buffers);
+
+    //! \brief Calls while recording a display list have to end up in the
+    //! list and may not be executed, so they all go through and the state
+    //! is unknown afterwards.
+    void start_recording();
+    void end_recording();
+
+    //! \brief Forget all state, e.g. after it changed behind the cache's
+    //! back via glPopAttrib(), glCallList() or Qt.
+    void invalidate();
+
+    statistics const& stats() const { return _statistics; }
+    void reset_statistics() { _statistics = {}; }
+
+  private:
+    //! \brief texture enables and bindings are per texture unit
+    static bool per_texture_unit (GLenum cap);
+    //! \return none if cap is per texture unit and the unit isn't known
+    boost::optional<std::uint64_t> key (GLenum cap) const;
+
+    bool set_enabled (GLenum cap, bool enabled, std::size_t& dropped);
+
+    std::unordered_map<std::uint64_t, bool> _enabled;
+    std::unordered_map<std::uint64_t, GLuint> _textures;
+    std::unordered_map<GLenum, GLuint> _buffers;
+    boost::optional<GLenum> _active_texture;
+    boost::optional<GLuint> _program;
+    boost::optional<std::pair<GLenum, GLenum>> _blend_func;
+    boost::optional<GLboolean> _depth_mask;
+
+    bool _recording = false;
+    statistics _statistics;
+  };
+}
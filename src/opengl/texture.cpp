@@ -8,13 +8,11 @@ namespace opengl
 {
   texture::texture()
     : _id (0)
-  {
-    gl.genTextures (1, &_id);
-  }
+  {}
 
   texture::~texture()
   {
-    if (_id != -1)
+    if (_id != 0 && _id != -1)
     {
       gl.deleteTextures (1, &_id);
     }
@@ -34,6 +32,11 @@ namespace opengl
 
   void texture::bind() const
   {
+    if (_id == 0)
+    {
+      gl.genTextures (1, &_id);
+    }
+
     gl.bindTexture (GL_TEXTURE_2D, _id);
   }
 
@@ -6,6 +6,8 @@
 
 namespace opengl
 {
+  //! \note The GL name is generated by the first bind(), so textures may
+  //! be created without a GL context, e.g. while parsing on a loader thread.
   class texture
   {
   public:
@@ -28,6 +30,6 @@ namespace opengl
   protected:
     typedef GLuint internal_type;
 
-    internal_type _id;
+    mutable internal_type _id;
   };
 }
@@ -0,0 +1,233 @@
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/AsyncLoader.h>
+#include <noggit/AsyncObject.h>
+#include <noggit/multimap_with_normalized_key.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+  struct counting_object : AsyncObject
+  {
+    counting_object (int id_, std::vector<int>& order_, boost::mutex& order_mutex_)
+      : id (id_), order (order_), order_mutex (order_mutex_)
+    {}
+
+    virtual void finishLoading() override
+    {
+      ++loads;
+      {
+        boost::mutex::scoped_lock lock (order_mutex);
+        order.push_back (id);
+      }
+      finished = true;
+    }
+
+    int const id;
+    std::vector<int>& order;
+    boost::mutex& order_mutex;
+    std::atomic<int> loads {0};
+  };
+
+  void wait_for (std::vector<std::unique_ptr<counting_object>> const& objects)
+  {
+    for (auto const& object : objects)
+    {
+      while (!object->finishedLoading())
+      {
+        boost::this_thread::yield();
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE (lower_priority_is_loaded_first)
+{
+  std::vector<int> order;
+  boost::mutex order_mutex;
+  std::vector<std::unique_ptr<counting_object>> objects;
+
+  AsyncLoader loader;
+
+  float const priorities[] = {5.f, 1.f, 3.f, 1.f, 0.f};
+  for (int i = 0; i < 5; ++i)
+  {
+    objects.emplace_back (std::make_unique<counting_object> (i, order, order_mutex));
+    loader.addObject (objects.back().get(), priorities[i]);
+  }
+
+  loader.start (1);
+  wait_for (objects);
+
+  // equal priorities keep their insertion order
+  std::vector<int> const expected {4, 1, 3, 2, 0};
+  BOOST_REQUIRE_EQUAL_COLLECTIONS
+    (order.begin(), order.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE (every_object_is_loaded_exactly_once)
+{
+  std::vector<int> order;
+  boost::mutex order_mutex;
+  std::vector<std::unique_ptr<counting_object>> objects;
+
+  AsyncLoader loader;
+  loader.start (8);
+
+  for (int i = 0; i < 2000; ++i)
+  {
+    objects.emplace_back (std::make_unique<counting_object> (i, order, order_mutex));
+    loader.addObject (objects.back().get(), static_cast<float> (i % 7));
+    // queueing twice must not load twice
+    loader.addObject (objects.back().get(), static_cast<float> (i % 3));
+  }
+
+  wait_for (objects);
+
+  for (auto const& object : objects)
+  {
+    BOOST_REQUIRE_EQUAL (object->loads, 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE (removed_objects_are_not_loaded)
+{
+  std::vector<int> order;
+  boost::mutex order_mutex;
+  counting_object object (0, order, order_mutex);
+
+  AsyncLoader loader;
+  loader.addObject (&object);
+  loader.removeObject (&object);
+  loader.start (2);
+  loader.stop();
+  loader.join();
+
+  BOOST_REQUIRE_EQUAL (object.loads, 0);
+}
+
+BOOST_AUTO_TEST_CASE (failed_objects_can_be_removed)
+{
+  struct throwing_object : AsyncObject
+  {
+    virtual void finishLoading() override
+    {
+      ++attempts;
+      throw std::runtime_error ("corrupt file");
+    }
+
+    std::atomic<int> attempts {0};
+  };
+
+  throwing_object object;
+
+  AsyncLoader loader;
+  loader.start (1);
+  loader.addObject (&object);
+
+  while (!object.attempts)
+  {
+    boost::this_thread::yield();
+  }
+
+  // must not wait for the failed load forever
+  loader.removeObject (&object);
+
+  // and the worker survived
+  std::vector<int> order;
+  boost::mutex order_mutex;
+  std::vector<std::unique_ptr<counting_object>> objects;
+  objects.emplace_back (std::make_unique<counting_object> (0, order, order_mutex));
+  loader.addObject (objects.back().get());
+  wait_for (objects);
+}
+
+BOOST_AUTO_TEST_CASE (streamed_objects_are_kept_unless_being_loaded)
+{
+  //! \brief like blp_texture: a placeholder until bound, the larger levels
+  //! are decoded by the loader and uploaded by the next bind
+  struct streamed_object : AsyncObject
+  {
+    streamed_object (std::string const&, AsyncLoader& loader_)
+      : loader (loader_)
+    {}
+    ~streamed_object()
+    {
+      loader.removeObject (this);
+    }
+
+    virtual void finishLoading() override
+    {
+      finished = true;
+    }
+
+    void upload()
+    {
+      bytes = 100;
+      finished = false;
+    }
+
+    AsyncLoader& loader;
+    std::size_t bytes = 10;
+  };
+
+  AsyncLoader loader;
+
+  noggit::multimap_with_normalized_key<streamed_object> map
+    ( [] (boost::string_ref filename, std::string& normalized)
+      {
+        normalized = filename.to_string();
+      }
+    , [] (streamed_object const& object) -> boost::optional<std::size_t>
+      {
+        if (object.loading())
+        {
+          return boost::none;
+        }
+        return object.bytes;
+      }
+    );
+  map.unused_budget (1000);
+
+  // a placeholder is kept
+  map.release (map.acquire ("placeholder", loader));
+  BOOST_REQUIRE_EQUAL (map.unused_elements(), 1);
+
+  auto object (map.acquire ("placeholder", loader));
+  BOOST_REQUIRE_EQUAL (map.revives(), 1);
+
+  loader.addObject (&object->value);
+  BOOST_REQUIRE (object->value.loading());
+
+  loader.start (1);
+  while (object->value.loading())
+  {
+    boost::this_thread::yield();
+  }
+
+  object->value.upload();
+
+  // uploaded, it is kept with its new cost and can be revived
+  map.release (object);
+  BOOST_REQUIRE_EQUAL (map.unused_elements(), 1);
+  BOOST_REQUIRE_EQUAL (map.unused_bytes(), 100);
+
+  object = map.acquire ("placeholder", loader);
+  BOOST_REQUIRE_EQUAL (map.revives(), 2);
+  BOOST_REQUIRE_EQUAL (object->value.bytes, 100);
+
+  // while queued it is destroyed, taking it out of the loader
+  loader.stop();
+  loader.join();
+  loader.addObject (&object->value);
+  BOOST_REQUIRE (object->value.loading());
+
+  map.release (object);
+  BOOST_REQUIRE_EQUAL (map.unused_elements(), 0);
+  BOOST_REQUIRE (!map.find ("placeholder"));
+}
@@ -0,0 +1,107 @@
+#include <boost/test/included/unit_test.hpp>
+
+#include <math/frustum.hpp>
+#include <math/matrix_4x4.hpp>
+#include <math/projection.hpp>
+#include <math/ray.hpp>
+#include <noggit/instance_grid.hpp>
+
+namespace noggit
+{
+  namespace
+  {
+    using uids = std::vector<instance_grid::uid>;
+
+    math::vector_3d point (float x, float y, float z)
+    {
+      return {x, y, z};
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (finds_overlapping_instances_sorted_and_once)
+  {
+    instance_grid grid;
+
+    grid.insert (7, point (10, 0, 10), point (20, 10, 20));
+    // spans many cells but must only be reported once
+    grid.insert (3, point (0, 0, 0), point (1000, 10, 1000));
+    grid.insert (5, point (5000, 0, 5000), point (5010, 10, 5010));
+
+    BOOST_REQUIRE (grid.overlapping (point (15, 0, 15), point (16, 0, 16)) == (uids {3, 7}));
+    BOOST_REQUIRE (grid.overlapping (point (4000, 0, 4000), point (6000, 0, 6000)) == (uids {5}));
+    BOOST_REQUIRE (grid.overlapping (point (30, 0, 30), point (40, 0, 40)) == (uids {3}));
+  }
+
+  BOOST_AUTO_TEST_CASE (moving_and_erasing_updates_the_cells)
+  {
+    instance_grid grid;
+
+    grid.insert (1, point (10, 0, 10), point (20, 10, 20));
+    grid.insert (1, point (3000, 0, 3000), point (3010, 10, 3010));
+
+    BOOST_REQUIRE_EQUAL (grid.size(), 1);
+    BOOST_REQUIRE (grid.overlapping (point (0, 0, 0), point (100, 0, 100)).empty());
+    BOOST_REQUIRE (grid.overlapping (point (3000, 0, 3000), point (3001, 0, 3001)) == (uids {1}));
+
+    grid.erase (1);
+    BOOST_REQUIRE_EQUAL (grid.size(), 0);
+    BOOST_REQUIRE (grid.overlapping (point (3000, 0, 3000), point (3001, 0, 3001)).empty());
+  }
+
+  BOOST_AUTO_TEST_CASE (ray_only_returns_instances_it_hits)
+  {
+    instance_grid grid;
+
+    grid.insert (1, point (10, 0, 10), point (20, 10, 20));
+    grid.insert (2, point (10, 0, 500), point (20, 10, 510));
+    grid.insert (3, point (2000, 0, 10), point (2010, 10, 20));
+
+    math::ray const ray (point (0, 5, 15), point (1, 0, 0.00001f));
+
+    BOOST_REQUIRE (grid.along (ray) == (uids {1, 3}));
+  }
+
+  BOOST_AUTO_TEST_CASE (frustum_only_returns_instances_inside)
+  {
+    instance_grid grid;
+
+    grid.insert (1, point (10, 0, 10), point (20, 10, 20));
+    grid.insert (2, point (5000, 0, 5000), point (5010, 10, 5010));
+
+    math::frustum const frustum
+      (math::matrix_4x4 (math::matrix_4x4::scale, 1.0f / 1000.0f));
+
+    BOOST_REQUIRE (grid.visible (frustum) == (uids {1}));
+  }
+
+  BOOST_AUTO_TEST_CASE (queries_find_instances_off_the_map)
+  {
+    instance_grid grid;
+
+    grid.insert (1, point (-500, 0, 10), point (-490, 10, 20));
+    grid.insert (2, point (40000, 0, 10), point (40010, 10, 20));
+    grid.insert (3, point (3000, 0, 10), point (3010, 10, 20));
+
+    math::ray const ray (point (-1000, 5, 15), point (1, 0, 0));
+    BOOST_REQUIRE (grid.along (ray) == (uids {1, 2, 3}));
+
+    // looking down -z from above the off map instance
+    math::matrix_4x4 const view
+      (math::look_at (point (-495, 500, 500), point (-495, 0, 0), point (0, 1, 0)));
+    math::matrix_4x4 const projection
+      (math::perspective (math::degrees (60.0f), 1.0f, 1.0f, 2000.0f));
+    // transposed like the OpenGL matrices World builds its frustum from
+    math::frustum const frustum ((projection * view).transposed());
+
+    BOOST_REQUIRE (grid.visible (frustum) == (uids {1}));
+  }
+
+  BOOST_AUTO_TEST_CASE (huge_boxes_do_not_explode)
+  {
+    instance_grid grid;
+
+    grid.insert (1, math::vector_3d::min(), math::vector_3d::max());
+
+    BOOST_REQUIRE (grid.overlapping (point (100, 0, 100), point (101, 0, 101)) == (uids {1}));
+  }
+}
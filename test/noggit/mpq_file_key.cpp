@@ -0,0 +1,39 @@
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/mpq_file_key.hpp>
+
+#include <cstring>
+
+namespace noggit
+{
+  namespace mpq
+  {
+    namespace
+    {
+      std::uint32_t hash (char const* string, hash_type type)
+      {
+        return hash_string (string, string + std::strlen (string), type);
+      }
+    }
+
+    BOOST_AUTO_TEST_CASE (matches_well_known_table_keys)
+    {
+      BOOST_REQUIRE_EQUAL (hash ("(hash table)", hash_type::file_key), 0xC3AF3770);
+      BOOST_REQUIRE_EQUAL (hash ("(block table)", hash_type::file_key), 0xEC83B3A3);
+    }
+
+    BOOST_AUTO_TEST_CASE (ignores_case_and_slash_direction)
+    {
+      BOOST_REQUIRE_EQUAL ( make_file_key (std::string ("World\\Maps\\Azeroth\\Azeroth.wdt"))
+                          , make_file_key (std::string ("world/maps/azeroth/azeroth.WDT"))
+                          );
+    }
+
+    BOOST_AUTO_TEST_CASE (distinguishes_names)
+    {
+      BOOST_REQUIRE_NE ( make_file_key (std::string ("world\\maps\\azeroth\\azeroth_32_48.adt"))
+                       , make_file_key (std::string ("world\\maps\\azeroth\\azeroth_48_32.adt"))
+                       );
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/mpq_listfile.hpp>
+
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  namespace mpq
+  {
+    namespace
+    {
+      std::vector<char> contents (std::string const& text)
+      {
+        return {text.begin(), text.end()};
+      }
+
+      std::vector<std::string> strings (listfile::range range)
+      {
+        std::vector<std::string> result;
+        for (listfile::entry const& entry : range)
+        {
+          result.emplace_back (entry.to_string());
+        }
+        return result;
+      }
+    }
+
+    BOOST_AUTO_TEST_CASE (normalizes_sorts_and_deduplicates)
+    {
+      listfile files;
+      files.add (contents ("Tileset\\B.blp\r\nTileset\\A.blp\r\n\r\nWorld\\X.wmo"));
+      files.add (contents ("tileset/a.blp\nCreature\\Y.m2\n"));
+
+      std::vector<std::string> const expected
+        {"creature/y.m2", "tileset/a.blp", "tileset/b.blp", "world/x.wmo"};
+      auto const actual (strings (files.entries()));
+
+      BOOST_REQUIRE_EQUAL_COLLECTIONS
+        (actual.begin(), actual.end(), expected.begin(), expected.end());
+      BOOST_REQUIRE_EQUAL (files.size(), 4);
+    }
+
+    BOOST_AUTO_TEST_CASE (finds_exact_names)
+    {
+      listfile files;
+      files.add (contents ("Tileset\\A.blp\nWorld\\X.wmo"));
+
+      BOOST_REQUIRE (files.contains ("tileset/a.blp"));
+      BOOST_REQUIRE (files.contains ("world/x.wmo"));
+      BOOST_REQUIRE (!files.contains ("tileset/a"));
+      BOOST_REQUIRE (!files.contains ("world/x.wmo2"));
+    }
+
+    BOOST_AUTO_TEST_CASE (finds_prefixes)
+    {
+      listfile files;
+      files.add (contents ("Tileset\\A.blp\nTileset\\Sub\\B.blp\nTilesetX.blp\nWorld\\X.wmo\nA.m2"));
+
+      std::vector<std::string> const expected {"tileset/a.blp", "tileset/sub/b.blp"};
+      auto const actual (strings (files.with_prefix ("tileset/")));
+
+      BOOST_REQUIRE_EQUAL_COLLECTIONS
+        (actual.begin(), actual.end(), expected.begin(), expected.end());
+      BOOST_REQUIRE (files.with_prefix ("creature/").empty());
+    }
+  }
+}
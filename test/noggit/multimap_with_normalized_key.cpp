@@ -0,0 +1,240 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/multimap_with_normalized_key.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    void lowercase (boost::string_ref filename, std::string& normalized)
+    {
+      normalized.assign (filename.begin(), filename.end());
+      std::transform ( normalized.begin(), normalized.end(), normalized.begin()
+                     , [] (char c) { return static_cast<char> (std::tolower (c)); }
+                     );
+    }
+
+    struct asset
+    {
+      asset (std::string const& filename_, int extra_ = 0)
+        : filename (filename_)
+        , extra (extra_)
+      {}
+
+      std::string filename;
+      int extra;
+    };
+
+    std::size_t extra_as_cost (asset const& a)
+    {
+      return a.extra;
+    }
+
+    //! \note negative extra stands in for an asset still being loaded
+    boost::optional<std::size_t> loaded_extra_as_cost (asset const& a)
+    {
+      if (a.extra < 0)
+      {
+        return boost::none;
+      }
+      return std::size_t (a.extra);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (counts_references_and_destroys_with_the_last)
+  {
+    multimap_with_normalized_key<asset> map (&lowercase);
+
+    auto a (map.acquire ("Foo.blp", 42));
+    BOOST_REQUIRE_EQUAL (a->references, 1);
+    BOOST_REQUIRE_EQUAL (a->value.filename, "foo.blp");
+    BOOST_REQUIRE_EQUAL (a->value.extra, 42);
+
+    auto b (map.acquire ("FOO.BLP"));
+    BOOST_REQUIRE_EQUAL (a, b);
+    BOOST_REQUIRE_EQUAL (a->references, 2);
+    BOOST_REQUIRE_EQUAL (a->value.extra, 42);
+
+    map.add_reference (a);
+    BOOST_REQUIRE_EQUAL (a->references, 3);
+
+    map.release (a);
+    map.release (b);
+    BOOST_REQUIRE_EQUAL (map.size(), 1);
+    BOOST_REQUIRE_EQUAL (map.find ("foo.BLP"), &a->value);
+
+    map.release (a);
+    BOOST_REQUIRE_EQUAL (map.size(), 0);
+    BOOST_REQUIRE (!map.find ("foo.blp"));
+  }
+
+  BOOST_AUTO_TEST_CASE (keeps_addresses_while_growing)
+  {
+    multimap_with_normalized_key<asset> map (&lowercase);
+
+    std::vector<multimap_with_normalized_key<asset>::entry*> entries;
+    for (int i (0); i < 1000; ++i)
+    {
+      entries.push_back (map.acquire ("file_" + std::to_string (i), i));
+    }
+
+    BOOST_REQUIRE_EQUAL (map.size(), 1000);
+
+    for (int i (0); i < 1000; ++i)
+    {
+      BOOST_REQUIRE_EQUAL (map.find ("FILE_" + std::to_string (i)), &entries[i]->value);
+      BOOST_REQUIRE_EQUAL (entries[i]->value.extra, i);
+    }
+
+    for (auto entry : entries)
+    {
+      map.release (entry);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (finds_the_remaining_elements_after_erasing)
+  {
+    multimap_with_normalized_key<asset> map (&lowercase);
+
+    std::vector<multimap_with_normalized_key<asset>::entry*> entries;
+    for (int i (0); i < 500; ++i)
+    {
+      entries.push_back (map.acquire (std::to_string (i), i));
+    }
+
+    for (int i (0); i < 500; i += 3)
+    {
+      map.release (entries[i]);
+    }
+
+    for (int i (0); i < 500; ++i)
+    {
+      if (i % 3)
+      {
+        BOOST_REQUIRE_EQUAL (map.find (std::to_string (i)), &entries[i]->value);
+      }
+      else
+      {
+        BOOST_REQUIRE (!map.find (std::to_string (i)));
+      }
+    }
+
+    int count (0);
+    map.apply ([&] (std::string const&, asset&) { ++count; });
+    BOOST_REQUIRE_EQUAL (count, map.size());
+
+    for (int i (1); i < 500; ++i)
+    {
+      if (i % 3)
+      {
+        map.release (entries[i]);
+      }
+    }
+
+    BOOST_REQUIRE_EQUAL (map.size(), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (uses_the_given_normalization)
+  {
+    multimap_with_normalized_key<asset> map
+      ( [] (boost::string_ref filename, std::string& normalized)
+        {
+          lowercase (filename, normalized);
+          std::replace (normalized.begin(), normalized.end(), '\\', '/');
+        }
+      );
+
+    auto a (map.acquire ("World\\Foo.wmo"));
+    BOOST_REQUIRE_EQUAL (a->key, "world/foo.wmo");
+    BOOST_REQUIRE_EQUAL (map.find ("world/FOO.wmo"), &a->value);
+    BOOST_REQUIRE (!map.find ("world/bar.wmo"));
+
+    map.release (a);
+  }
+
+  BOOST_AUTO_TEST_CASE (revives_unused_elements)
+  {
+    multimap_with_normalized_key<asset> map (&lowercase, &extra_as_cost);
+    map.unused_budget (100);
+
+    auto a (map.acquire ("a", 10));
+    map.release (a);
+
+    BOOST_REQUIRE_EQUAL (map.size(), 1);
+    BOOST_REQUIRE_EQUAL (map.unused_elements(), 1);
+    BOOST_REQUIRE_EQUAL (map.unused_bytes(), 10);
+
+    // the old extra shows it wasn't constructed again
+    auto b (map.acquire ("A", 20));
+    BOOST_REQUIRE_EQUAL (a, b);
+    BOOST_REQUIRE_EQUAL (b->value.extra, 10);
+    BOOST_REQUIRE_EQUAL (b->references, 1);
+    BOOST_REQUIRE_EQUAL (map.revives(), 1);
+    BOOST_REQUIRE_EQUAL (map.unused_elements(), 0);
+    BOOST_REQUIRE_EQUAL (map.unused_bytes(), 0);
+
+    map.release (b);
+    map.clear_unused();
+    BOOST_REQUIRE_EQUAL (map.size(), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (evicts_least_recently_released_over_budget)
+  {
+    multimap_with_normalized_key<asset> map (&lowercase, &extra_as_cost);
+    map.unused_budget (100);
+
+    auto a (map.acquire ("a", 40));
+    auto b (map.acquire ("b", 40));
+    auto c (map.acquire ("c", 40));
+
+    map.release (a);
+    map.release (b);
+    BOOST_REQUIRE_EQUAL (map.evictions(), 0);
+
+    map.release (c);
+    BOOST_REQUIRE_EQUAL (map.evictions(), 1);
+    BOOST_REQUIRE (!map.find ("a"));
+    BOOST_REQUIRE (map.find ("b"));
+    BOOST_REQUIRE (map.find ("c"));
+    BOOST_REQUIRE_EQUAL (map.unused_bytes(), 80);
+
+    map.unused_budget (50);
+    BOOST_REQUIRE_EQUAL (map.evictions(), 2);
+    BOOST_REQUIRE (!map.find ("b"));
+    BOOST_REQUIRE (map.find ("c"));
+
+    map.unused_budget (0);
+    BOOST_REQUIRE_EQUAL (map.size(), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (destroys_at_once_without_budget)
+  {
+    multimap_with_normalized_key<asset> map (&lowercase, &extra_as_cost);
+
+    map.release (map.acquire ("a", 1));
+
+    BOOST_REQUIRE_EQUAL (map.size(), 0);
+    BOOST_REQUIRE_EQUAL (map.unused_elements(), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (destroys_at_once_what_may_not_be_kept)
+  {
+    multimap_with_normalized_key<asset> map (&lowercase, &loaded_extra_as_cost);
+    map.unused_budget (100);
+
+    map.release (map.acquire ("loading", -1));
+    map.release (map.acquire ("loaded", 10));
+
+    BOOST_REQUIRE (!map.find ("loading"));
+    BOOST_REQUIRE (map.find ("loaded"));
+    BOOST_REQUIRE_EQUAL (map.unused_elements(), 1);
+    BOOST_REQUIRE_EQUAL (map.unused_bytes(), 10);
+  }
+}
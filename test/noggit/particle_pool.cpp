@@ -0,0 +1,153 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/particle_pool.hpp>
+
+#include <math/interpolation.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    Particle make_particle (float seed)
+    {
+      Particle p;
+      p.pos = {seed, 2.f * seed, -seed};
+      p.speed = {1.f, seed * 0.5f, 0.25f};
+      p.down = {0.f, -1.f, 0.f};
+      p.origin = p.pos;
+      p.dir = {0.5f, 0.f, -0.5f};
+      std::fill (p.corners, p.corners + 4, math::vector_3d (seed, 0.f, 1.f));
+      p.size = 1.f;
+      p.life = 0.f;
+      p.maxlife = 0.5f + seed;
+      p.tile = static_cast<unsigned int> (seed * 20.f + 0.5f);
+      p.color = {1.f, 1.f, 1.f, 1.f};
+      return p;
+    }
+
+    template<class T>
+      T lifeRamp (float life, float mid, const T &a, const T &b, const T &c)
+    {
+      if (life <= mid) return math::interpolation::linear (life / mid, a, b);
+      else return math::interpolation::linear ((life - mid) / (1.0f - mid), b, c);
+    }
+
+    particle_pool::life_ramp const ramp
+      { 0.4f
+      , {1.f, 3.f, 0.5f}
+      , { math::vector_4d (1.f, 0.f, 0.f, 1.f)
+        , math::vector_4d (0.f, 1.f, 0.f, 0.5f)
+        , math::vector_4d (0.f, 0.f, 1.f, 0.f)
+        }
+      };
+  }
+
+  BOOST_AUTO_TEST_CASE (integrates_like_the_particle_list)
+  {
+    float const dt (0.05f);
+    float const grav (2.f);
+    float const deaccel (0.5f);
+    float const slowdown (0.75f);
+
+    std::vector<Particle> reference;
+    particle_pool pool (100);
+
+    for (int i (0); i < 20; ++i)
+    {
+      reference.push_back (make_particle (i * 0.05f));
+      BOOST_REQUIRE (pool.spawn (reference.back()));
+    }
+
+    for (int frame (0); frame < 20; ++frame)
+    {
+      for (Particle& p : reference)
+      {
+        p.speed += p.down * grav * dt - p.dir * deaccel * dt;
+        p.pos += p.speed * std::exp (-1.0f * slowdown * p.life) * dt;
+        p.life += dt;
+        float const rlife (p.life / p.maxlife);
+        p.size = lifeRamp<float> (rlife, ramp.mid, ramp.sizes[0], ramp.sizes[1], ramp.sizes[2]);
+        p.color = lifeRamp<math::vector_4d> (rlife, ramp.mid, ramp.colors[0], ramp.colors[1], ramp.colors[2]);
+      }
+
+      reference.erase
+        ( std::remove_if ( reference.begin(), reference.end()
+                         , [] (Particle const& p) { return p.life / p.maxlife >= 1.0f; }
+                         )
+        , reference.end()
+        );
+
+      pool.integrate (dt, grav, deaccel, slowdown, ramp);
+
+      BOOST_REQUIRE_EQUAL (pool.size(), reference.size());
+
+      // removal swaps in the last particle, so match them up by tile
+      for (std::size_t i (0); i < pool.size(); ++i)
+      {
+        auto const p
+          ( std::find_if ( reference.begin(), reference.end()
+                         , [&] (Particle const& p) { return p.tile == pool.tile[i]; }
+                         )
+          );
+        BOOST_REQUIRE (p != reference.end());
+
+        BOOST_REQUIRE_EQUAL (pool.pos.x[i], p->pos.x);
+        BOOST_REQUIRE_EQUAL (pool.pos.y[i], p->pos.y);
+        BOOST_REQUIRE_EQUAL (pool.pos.z[i], p->pos.z);
+        BOOST_REQUIRE_EQUAL (pool.speed.y[i], p->speed.y);
+        BOOST_REQUIRE_EQUAL (pool.life[i], p->life);
+        BOOST_REQUIRE_EQUAL (pool.scale[i], p->size);
+        BOOST_REQUIRE_EQUAL (pool.r[i], p->color.x);
+        BOOST_REQUIRE_EQUAL (pool.g[i], p->color.y);
+        BOOST_REQUIRE_EQUAL (pool.b[i], p->color.z);
+        BOOST_REQUIRE_EQUAL (pool.a[i], p->color.w);
+      }
+    }
+
+    BOOST_REQUIRE_LT (pool.size(), 20);
+  }
+
+  BOOST_AUTO_TEST_CASE (stops_spawning_at_max_particles)
+  {
+    particle_pool pool (40);
+
+    for (int i (0); i < 40; ++i)
+    {
+      BOOST_REQUIRE (pool.spawn (make_particle (1.f)));
+    }
+
+    BOOST_REQUIRE (!pool.spawn (make_particle (1.f)));
+    BOOST_REQUIRE_EQUAL (pool.size(), 40);
+    BOOST_REQUIRE_EQUAL (pool.capacity(), 40);
+    BOOST_REQUIRE_EQUAL (pool.free(), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (keeps_storage_of_dead_particles)
+  {
+    particle_pool pool (1000);
+
+    for (int i (0); i < 100; ++i)
+    {
+      pool.spawn (make_particle (0.f));
+    }
+
+    std::size_t const capacity (pool.capacity());
+
+    pool.integrate (1.f, 0.f, 0.f, 0.f, ramp);
+    BOOST_REQUIRE_EQUAL (pool.size(), 0);
+
+    for (int i (0); i < 100; ++i)
+    {
+      pool.spawn (make_particle (0.f));
+    }
+
+    BOOST_REQUIRE_EQUAL (pool.size(), 100);
+    BOOST_REQUIRE_EQUAL (pool.capacity(), capacity);
+  }
+}
@@ -0,0 +1,48 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/range_allocator.hpp>
+
+namespace noggit
+{
+  BOOST_AUTO_TEST_CASE (allocates_aligned_ranges_first_fit)
+  {
+    range_allocator allocator (64);
+
+    BOOST_REQUIRE_EQUAL (allocator.allocate (10, 1).get(), 0);
+    BOOST_REQUIRE_EQUAL (allocator.allocate (8, 16).get(), 16);
+    // the gap left by aligning is used by later allocations
+    BOOST_REQUIRE_EQUAL (allocator.allocate (4, 2).get(), 10);
+
+    BOOST_REQUIRE_EQUAL (allocator.used(), 22);
+  }
+
+  BOOST_AUTO_TEST_CASE (fails_when_no_range_is_large_enough)
+  {
+    range_allocator allocator (32);
+
+    BOOST_REQUIRE (allocator.allocate (16, 1));
+    BOOST_REQUIRE (!allocator.allocate (17, 1));
+    BOOST_REQUIRE (!allocator.allocate (16, 32));
+    BOOST_REQUIRE_EQUAL (allocator.allocate (16, 16).get(), 16);
+    BOOST_REQUIRE (!allocator.allocate (1, 1));
+  }
+
+  BOOST_AUTO_TEST_CASE (merges_freed_neighbours)
+  {
+    range_allocator allocator (30);
+
+    std::size_t const a (allocator.allocate (10, 1).get());
+    std::size_t const b (allocator.allocate (10, 1).get());
+    std::size_t const c (allocator.allocate (10, 1).get());
+
+    allocator.free (a, 10);
+    allocator.free (c, 10);
+    BOOST_REQUIRE (!allocator.allocate (20, 1));
+
+    allocator.free (b, 10);
+    BOOST_REQUIRE (allocator.empty());
+    BOOST_REQUIRE_EQUAL (allocator.allocate (30, 1).get(), 0);
+  }
+}
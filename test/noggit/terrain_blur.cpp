@@ -0,0 +1,256 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/MapHeaders.h>
+#include <noggit/terrain_blur.hpp>
+
+#include <boost/optional.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    float dist (float x1, float z1, float x2, float z2)
+    {
+      float xdiff = x2 - x1, zdiff = z2 - z1;
+      return std::sqrt(xdiff*xdiff + zdiff*zdiff);
+    }
+
+    //! a square of chunks laid out like MapChunk's vertices
+    struct terrain
+    {
+      static int const chunks = 4;
+      static int const vertices = 9 * 9 + 8 * 8;
+
+      terrain()
+        : heights (chunks * chunks * vertices)
+      {
+        for (int cz (0); cz < chunks; ++cz)
+        {
+          for (int cx (0); cx < chunks; ++cx)
+          {
+            math::vector_3d* vertex (&heights[(cz * chunks + cx) * vertices]);
+
+            for (int row (0); row < 17; ++row)
+            {
+              for (int column (0); column < (row % 2 ? 8 : 9); ++column)
+              {
+                float const x (cx * CHUNKSIZE + column * UNITSIZE + (row % 2) * UNITSIZE * 0.5f);
+                float const z (cz * CHUNKSIZE + row * UNITSIZE * 0.5f);
+                *vertex++ = {x, 20.f * std::sin (x * 0.07f) + 15.f * std::cos (z * 0.11f) + std::fmod (x * z, 3.f), z};
+              }
+            }
+          }
+        }
+      }
+
+      math::vector_3d* chunk (int cx, int cz)
+      {
+        return &heights[(cz * chunks + cx) * vertices];
+      }
+
+      //! same lookup as MapTile::vertex_at and MapChunk::vertex_at
+      math::vector_3d* vertex_at (float x, float z)
+      {
+        int const cx ((int)(x / CHUNKSIZE));
+        int const cz ((int)(z / CHUNKSIZE));
+
+        if (x < 0.f || z < 0.f || cx >= chunks || cz >= chunks)
+        {
+          return nullptr;
+        }
+
+        const int row = static_cast<int>((z - cz * CHUNKSIZE) / (UNITSIZE * 0.5f) + 0.5f);
+        const int column = static_cast<int>(((x - cx * CHUNKSIZE) - UNITSIZE * 0.5f * (row % 2)) / UNITSIZE + 0.5f);
+        if ((row < 0) || (column < 0) || (row > 16) || (column >((row % 2) ? 8 : 9)))
+          return nullptr;
+
+        return &chunk (cx, cz)[17 * (row / 2) + ((row % 2) ? 9 : 0) + column];
+      }
+
+      std::vector<math::vector_3d> heights;
+    };
+
+    //! the implementation MapChunk::blurTerrain had before terrain_blur,
+    //! sampling every point through a std::function for every vertex
+    void blur_per_vertex ( terrain& world
+                         , math::vector_3d const& pos
+                         , float remain
+                         , float radius
+                         )
+    {
+      std::function<boost::optional<float> (float, float)> height
+        ( [&] (float x, float z) -> boost::optional<float>
+          {
+            math::vector_3d* vertex (world.vertex_at (x, z));
+            return boost::make_optional (!!vertex, vertex ? vertex->y : 0.f);
+          }
+        );
+
+      for (int c (0); c < terrain::chunks * terrain::chunks; ++c)
+      {
+        math::vector_3d* mVertices (world.chunk (c % terrain::chunks, c / terrain::chunks));
+
+        for (int i (0); i < terrain::vertices; ++i)
+        {
+          float const dist (noggit::dist (mVertices[i].x, mVertices[i].z, pos.x, pos.z));
+
+          if (dist >= radius)
+          {
+            continue;
+          }
+
+          int Rad = (int)(radius / UNITSIZE);
+          float TotalHeight = 0;
+          float TotalWeight = 0;
+          for (int j = -Rad * 2; j <= Rad * 2; ++j)
+          {
+            float tz = pos.z + j * UNITSIZE / 2;
+            for (int k = -Rad; k <= Rad; ++k)
+            {
+              float tx = pos.x + k*UNITSIZE + (j % 2) * UNITSIZE / 2.0f;
+              float dist2 = noggit::dist (tx, tz, mVertices[i].x, mVertices[i].z);
+              if (dist2 > radius)
+                continue;
+              auto h (height (tx, tz));
+              if (h)
+              {
+                TotalHeight += (1.0f - dist2 / radius) * h.get();
+                TotalWeight += (1.0f - dist2 / radius);
+              }
+            }
+          }
+
+          mVertices[i].y = mVertices[i].y * (1.0f - remain) + (TotalHeight / TotalWeight) * remain;
+        }
+      }
+    }
+
+    void blur_gathered ( terrain& world
+                       , math::vector_3d const& pos
+                       , float remain
+                       , float radius
+                       )
+    {
+      terrain_blur const blur
+        ( pos, radius
+        , [&] (float x, float z) -> float const*
+          {
+            math::vector_3d* vertex (world.vertex_at (x, z));
+            return vertex ? &vertex->y : nullptr;
+          }
+        );
+
+      for (int c (0); c < terrain::chunks * terrain::chunks; ++c)
+      {
+        math::vector_3d* mVertices (world.chunk (c % terrain::chunks, c / terrain::chunks));
+
+        for (int i (0); i < terrain::vertices; ++i)
+        {
+          float const dist (noggit::dist (mVertices[i].x, mVertices[i].z, pos.x, pos.z));
+
+          if (dist >= radius)
+          {
+            continue;
+          }
+
+          mVertices[i].y = mVertices[i].y * (1.0f - remain) + blur.average (mVertices[i]) * remain;
+        }
+      }
+    }
+
+    void require_identical (terrain const& lhs, terrain const& rhs)
+    {
+      BOOST_REQUIRE_EQUAL (lhs.heights.size(), rhs.heights.size());
+
+      for (std::size_t i (0); i < lhs.heights.size(); ++i)
+      {
+        BOOST_REQUIRE (!std::memcmp (&lhs.heights[i].y, &rhs.heights[i].y, sizeof (float)));
+      }
+    }
+
+    math::vector_3d const strokes[] = { {30.f, 0.f, 40.f}
+                                      , {CHUNKSIZE, 0.f, CHUNKSIZE}
+                                      , {2.f * CHUNKSIZE + 1.3f, 0.f, 1.5f * CHUNKSIZE - 0.7f}
+                                      , {0.f, 0.f, 0.f}
+                                      , {4.f * CHUNKSIZE - 2.f, 0.f, 3.f}
+                                      };
+  }
+
+  BOOST_AUTO_TEST_CASE (matches_per_vertex_sampling)
+  {
+    for (float radius : {3.f, 7.5f, 20.f, 45.f})
+    {
+      terrain expected;
+      terrain actual;
+
+      for (auto const& pos : strokes)
+      {
+        blur_per_vertex (expected, pos, 0.3f, radius);
+        blur_gathered (actual, pos, 0.3f, radius);
+      }
+
+      require_identical (expected, actual);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (ignores_points_without_terrain)
+  {
+    terrain world;
+
+    terrain_blur const blur
+      ( {-100.f, 0.f, -100.f}, 20.f
+      , [&] (float x, float z) -> float const*
+        {
+          math::vector_3d* vertex (world.vertex_at (x, z));
+          return vertex ? &vertex->y : nullptr;
+        }
+      );
+
+    BOOST_REQUIRE_EQUAL (blur.samples(), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (benchmark_against_per_vertex_sampling)
+  {
+    using clock = std::chrono::high_resolution_clock;
+
+    int const repetitions (20);
+    float const radius (40.f);
+
+    terrain expected;
+    terrain actual;
+
+    auto const time
+      ( [&] (terrain& world, void (*blur) (terrain&, math::vector_3d const&, float, float))
+        {
+          auto const start (clock::now());
+
+          for (int i (0); i < repetitions; ++i)
+          {
+            for (auto const& pos : strokes)
+            {
+              blur (world, pos, 0.1f, radius);
+            }
+          }
+
+          return std::chrono::duration_cast<std::chrono::microseconds> (clock::now() - start).count();
+        }
+      );
+
+    auto const per_vertex (time (expected, &blur_per_vertex));
+    auto const gathered (time (actual, &blur_gathered));
+
+    BOOST_TEST_MESSAGE ( "blur, radius " << radius << ": per vertex sampling "
+                       << per_vertex << " us, gathered " << gathered << " us"
+                       );
+
+    require_identical (expected, actual);
+  }
+}
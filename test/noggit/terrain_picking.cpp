@@ -0,0 +1,222 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <math/ray.hpp>
+#include <noggit/terrain_picking.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  namespace terrain_picking
+  {
+    namespace
+    {
+      float const unit_size (4.f);
+
+      // same layout as MapChunk: rows of 9 outer and 8 inner vertices
+      std::vector<math::vector_3d> random_chunk (std::mt19937& engine, math::vector_3d const& corner)
+      {
+        std::uniform_real_distribution<float> height (-20.f, 20.f);
+        std::vector<math::vector_3d> vertices;
+
+        for (int j (0); j < 17; ++j)
+        {
+          for (int i (0); i < ((j % 2) ? 8 : 9); ++i)
+          {
+            float const x (i * unit_size + ((j % 2) ? unit_size * 0.5f : 0.f));
+            float const z (j * 0.5f * unit_size);
+            vertices.emplace_back (corner.x + x, corner.y + height (engine), corner.z + z);
+          }
+        }
+
+        return vertices;
+      }
+
+      std::vector<math::vector_3d> cell_triangles
+        (std::vector<math::vector_3d> const& vertices, int row, int column)
+      {
+        math::vector_3d const& center (vertices[row * 17 + 9 + column]);
+        math::vector_3d const& a (vertices[row * 17 + column]);
+        math::vector_3d const& b (vertices[row * 17 + column + 1]);
+        math::vector_3d const& c (vertices[(row + 1) * 17 + column + 1]);
+        math::vector_3d const& d (vertices[(row + 1) * 17 + column]);
+
+        return {center, a, d, center, d, c, center, c, b, center, b, a};
+      }
+
+      boost::optional<float> cell_hit
+        (math::ray const& ray, std::vector<math::vector_3d> const& vertices, int row, int column)
+      {
+        std::vector<math::vector_3d> const triangles (cell_triangles (vertices, row, column));
+        boost::optional<float> nearest;
+
+        for (std::size_t i (0); i < triangles.size(); i += 3)
+        {
+          auto const hit (ray.intersect_triangle (triangles[i], triangles[i + 1], triangles[i + 2]));
+          if (hit && (!nearest || *hit < *nearest))
+          {
+            nearest = hit;
+          }
+        }
+
+        return nearest;
+      }
+    }
+
+    BOOST_AUTO_TEST_CASE (walks_cells_in_order_of_the_ray)
+    {
+      math::ray const ray ({-5.f, 0.f, 2.f}, {1.f, 0.f, 0.5f});
+
+      std::vector<std::pair<std::size_t, std::size_t>> cells;
+      float last_exit (0.f);
+
+      walk_grid ( ray, {0.f, 0.f, 0.f}, 10.f, 4, 4, 0.f, 1000.f
+                , [&] (std::size_t x, std::size_t z, float t_enter, float t_exit)
+                  {
+                    BOOST_REQUIRE_LE (t_enter, t_exit);
+                    BOOST_REQUIRE_GE (t_enter, last_exit - 0.001f);
+                    last_exit = t_exit;
+
+                    // the middle of the part of the ray within the cell
+                    math::vector_3d const middle (ray.position ((t_enter + t_exit) * 0.5f));
+                    BOOST_REQUIRE_EQUAL (std::size_t (middle.x / 10.f), x);
+                    BOOST_REQUIRE_EQUAL (std::size_t (middle.z / 10.f), z);
+
+                    cells.emplace_back (x, z);
+                    return false;
+                  }
+                );
+
+      std::vector<std::pair<std::size_t, std::size_t>> const expected
+        {{0, 0}, {1, 0}, {1, 1}, {2, 1}, {3, 1}, {3, 2}};
+      BOOST_REQUIRE (cells == expected);
+    }
+
+    BOOST_AUTO_TEST_CASE (stops_walking_when_asked)
+    {
+      math::ray const ray ({0.5f, 100.f, 0.5f}, {1.f, -0.1f, 1.f});
+
+      std::size_t visited (0);
+      walk_grid ( ray, {0.f, 0.f, 0.f}, 1.f, 64, 64, 0.f, 1000.f
+                , [&] (std::size_t, std::size_t, float, float)
+                  {
+                    return ++visited == 3;
+                  }
+                );
+
+      BOOST_REQUIRE_EQUAL (visited, 3);
+    }
+
+    BOOST_AUTO_TEST_CASE (vertical_rays_visit_a_single_cell)
+    {
+      math::ray const ray ({25.f, 100.f, 35.f}, {0.f, -1.f, 0.f});
+
+      std::vector<std::pair<std::size_t, std::size_t>> cells;
+      walk_grid ( ray, {0.f, 0.f, 0.f}, 10.f, 64, 64, 0.f, 1000.f
+                , [&] (std::size_t x, std::size_t z, float, float)
+                  {
+                    cells.emplace_back (x, z);
+                    return false;
+                  }
+                );
+
+      BOOST_REQUIRE (cells == (std::vector<std::pair<std::size_t, std::size_t>> {{2, 3}}));
+
+      std::size_t visited (0);
+      walk_grid ( math::ray ({-25.f, 100.f, 35.f}, {0.f, -1.f, 0.f})
+                , {0.f, 0.f, 0.f}, 10.f, 64, 64, 0.f, 1000.f
+                , [&] (std::size_t, std::size_t, float, float) { return ++visited != 0; }
+                );
+      BOOST_REQUIRE_EQUAL (visited, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE (height_tree_finds_the_nearest_triangle)
+    {
+      std::mt19937 engine (42);
+      std::uniform_real_distribution<float> coordinate (-8.f, 40.f);
+      std::uniform_real_distribution<float> slope (-1.f, 1.f);
+
+      math::vector_3d const corner (100.f, 0.f, 200.f);
+
+      for (int chunk (0); chunk < 20; ++chunk)
+      {
+        std::vector<math::vector_3d> const vertices (random_chunk (engine, corner));
+
+        chunk_height_tree tree;
+        tree.update (vertices.data());
+
+        for (int i (0); i < 200; ++i)
+        {
+          math::ray const ray
+            ( { corner.x + coordinate (engine)
+              , 60.f
+              , corner.z + coordinate (engine)
+              }
+            , {slope (engine), -1.f, slope (engine)}
+            );
+
+          boost::optional<float> expected;
+          for (int row (0); row < 8; ++row)
+          {
+            for (int column (0); column < 8; ++column)
+            {
+              auto const hit (cell_hit (ray, vertices, row, column));
+              if (hit && (!expected || *hit < *expected))
+              {
+                expected = hit;
+              }
+            }
+          }
+
+          auto const hit
+            ( tree.intersect ( ray, corner, unit_size
+                             , [&] (int row, int column)
+                               {
+                                 return cell_hit (ray, vertices, row, column);
+                               }
+                             )
+            );
+
+          BOOST_REQUIRE_EQUAL (!!hit, !!expected);
+          if (hit)
+          {
+            BOOST_REQUIRE_EQUAL (*hit, *expected);
+          }
+        }
+      }
+    }
+
+    BOOST_AUTO_TEST_CASE (height_tree_skips_cells_the_ray_passes_above)
+    {
+      std::mt19937 engine (7);
+      math::vector_3d const corner (0.f, 0.f, 0.f);
+      std::vector<math::vector_3d> vertices (random_chunk (engine, corner));
+
+      chunk_height_tree tree;
+      tree.update (vertices.data());
+
+      BOOST_REQUIRE_LE (tree.max_height(), 20.f);
+      BOOST_REQUIRE_GE (tree.min_height(), -20.f);
+
+      std::size_t tested (0);
+      math::ray const ray ({16.f, 100.f, 16.f}, {0.f, -1.f, 0.f});
+
+      tree.intersect ( ray, corner, unit_size
+                     , [&] (int row, int column)
+                       {
+                         ++tested;
+                         return cell_hit (ray, vertices, row, column);
+                       }
+                     );
+
+      // the ray hits the shared corner of four cells
+      BOOST_REQUIRE_LE (tested, 4);
+    }
+  }
+}
@@ -0,0 +1,69 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/texture_residency.hpp>
+
+namespace noggit
+{
+  namespace
+  {
+    bool never_pinned (std::string const&)
+    {
+      return false;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (sums_resident_bytes)
+  {
+    texture_residency residency (100);
+
+    residency.insert ("a.blp", 10);
+    residency.insert ("b.blp", 20);
+    residency.insert ("a.blp", 30);
+
+    BOOST_REQUIRE_EQUAL (residency.resident_bytes(), 50);
+    BOOST_REQUIRE_EQUAL (residency.resident_textures(), 2);
+
+    residency.erase ("b.blp");
+    residency.erase ("unknown.blp");
+
+    BOOST_REQUIRE_EQUAL (residency.resident_bytes(), 30);
+    BOOST_REQUIRE (residency.resident ("a.blp"));
+    BOOST_REQUIRE (!residency.resident ("b.blp"));
+  }
+
+  BOOST_AUTO_TEST_CASE (evicts_least_recently_used_first)
+  {
+    texture_residency residency (20);
+
+    residency.insert ("a.blp", 10);
+    residency.insert ("b.blp", 10);
+    residency.insert ("c.blp", 10);
+    residency.touch ("a.blp");
+
+    auto const evicted (residency.evict (&never_pinned));
+
+    BOOST_REQUIRE_EQUAL (evicted.size(), 1);
+    BOOST_REQUIRE_EQUAL (evicted[0], "b.blp");
+    BOOST_REQUIRE_EQUAL (residency.resident_bytes(), 20);
+    BOOST_REQUIRE_EQUAL (residency.evictions(), 1);
+  }
+
+  BOOST_AUTO_TEST_CASE (keeps_pinned_textures_over_budget)
+  {
+    texture_residency residency (10);
+
+    residency.insert ("a.blp", 10);
+    residency.insert ("b.blp", 10);
+    residency.insert ("c.blp", 10);
+
+    auto const evicted
+      (residency.evict ([] (std::string const& texture) { return texture != "c.blp"; }));
+
+    BOOST_REQUIRE_EQUAL (evicted.size(), 1);
+    BOOST_REQUIRE_EQUAL (evicted[0], "c.blp");
+    BOOST_REQUIRE_EQUAL (residency.resident_bytes(), 20);
+    BOOST_REQUIRE (residency.evict (&never_pinned).size() == 1);
+  }
+}
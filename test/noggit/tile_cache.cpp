@@ -0,0 +1,75 @@
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/tile_cache.hpp>
+
+namespace noggit
+{
+  namespace
+  {
+    bool never_pinned (tile_index const&)
+    {
+      return false;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (counts_hits_and_misses)
+  {
+    tile_cache cache (100);
+
+    BOOST_REQUIRE (!cache.touch ({1, 1}));
+    cache.insert ({1, 1}, 10);
+    BOOST_REQUIRE (cache.touch ({1, 1}));
+
+    BOOST_REQUIRE_EQUAL (cache.hits(), 1);
+    BOOST_REQUIRE_EQUAL (cache.misses(), 1);
+    BOOST_REQUIRE_EQUAL (cache.resident_bytes(), 10);
+  }
+
+  BOOST_AUTO_TEST_CASE (evicts_least_recently_used_first)
+  {
+    tile_cache cache (20);
+
+    cache.insert ({0, 0}, 10);
+    cache.insert ({1, 0}, 10);
+    cache.insert ({2, 0}, 10);
+    cache.touch ({0, 0});
+
+    auto const evicted (cache.evict (&never_pinned));
+
+    BOOST_REQUIRE_EQUAL (evicted.size(), 1);
+    BOOST_REQUIRE (evicted[0] == tile_index (1, 0));
+    BOOST_REQUIRE_EQUAL (cache.resident_bytes(), 20);
+    BOOST_REQUIRE_EQUAL (cache.evictions(), 1);
+    BOOST_REQUIRE (!cache.touch ({1, 0}));
+  }
+
+  BOOST_AUTO_TEST_CASE (keeps_pinned_tiles_even_over_budget)
+  {
+    tile_cache cache (5);
+
+    cache.insert ({0, 0}, 10);
+    cache.insert ({1, 0}, 10);
+
+    auto const evicted
+      (cache.evict ([] (tile_index const& tile) { return tile.x == 0; }));
+
+    BOOST_REQUIRE_EQUAL (evicted.size(), 1);
+    BOOST_REQUIRE (evicted[0] == tile_index (1, 0));
+    BOOST_REQUIRE_EQUAL (cache.resident_bytes(), 10);
+    BOOST_REQUIRE_EQUAL (cache.resident_tiles(), 1);
+  }
+
+  BOOST_AUTO_TEST_CASE (insert_of_resident_tile_updates_size)
+  {
+    tile_cache cache (100);
+
+    cache.insert ({3, 4}, 10);
+    cache.insert ({3, 4}, 30);
+    BOOST_REQUIRE_EQUAL (cache.resident_bytes(), 30);
+    BOOST_REQUIRE_EQUAL (cache.resident_tiles(), 1);
+
+    cache.erase ({3, 4});
+    BOOST_REQUIRE_EQUAL (cache.resident_bytes(), 0);
+    BOOST_REQUIRE (cache.evict (&never_pinned).empty());
+  }
+}
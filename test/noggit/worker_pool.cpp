@@ -0,0 +1,65 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <noggit/worker_pool.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace noggit
+{
+  BOOST_AUTO_TEST_CASE (runs_every_index_once)
+  {
+    worker_pool pool (3);
+
+    for (std::size_t count : {0, 1, 7, 1000})
+    {
+      std::vector<std::atomic<int>> runs (count);
+      for (auto& run : runs)
+      {
+        run = 0;
+      }
+
+      pool.for_each (count, [&] (std::size_t i) { ++runs[i]; });
+
+      for (auto const& run : runs)
+      {
+        BOOST_REQUIRE_EQUAL (run.load(), 1);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (works_without_extra_threads)
+  {
+    worker_pool pool (0);
+
+    std::size_t sum (0);
+    pool.for_each (10, [&] (std::size_t i) { sum += i; });
+
+    BOOST_REQUIRE_EQUAL (sum, 45);
+  }
+
+  BOOST_AUTO_TEST_CASE (rethrows_a_failed_job)
+  {
+    worker_pool pool (2);
+
+    BOOST_REQUIRE_THROW
+      ( pool.for_each ( 100
+                      , [] (std::size_t i)
+                        {
+                          if (i == 42)
+                          {
+                            throw std::runtime_error ("job failed");
+                          }
+                        }
+                      )
+      , std::runtime_error
+      );
+
+    std::atomic<int> runs (0);
+    pool.for_each (5, [&] (std::size_t) { ++runs; });
+    BOOST_REQUIRE_EQUAL (runs.load(), 5);
+  }
+}
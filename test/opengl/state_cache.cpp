@@ -0,0 +1,121 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <opengl/state_cache.hpp>
+
+namespace opengl
+{
+  BOOST_AUTO_TEST_CASE (drops_repeated_state_changes)
+  {
+    state_cache cache;
+
+    BOOST_REQUIRE (cache.enable (GL_BLEND));
+    BOOST_REQUIRE (!cache.enable (GL_BLEND));
+    BOOST_REQUIRE (cache.disable (GL_BLEND));
+    BOOST_REQUIRE (!cache.disable (GL_BLEND));
+
+    BOOST_REQUIRE (cache.blend_func (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    BOOST_REQUIRE (!cache.blend_func (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    BOOST_REQUIRE (cache.blend_func (GL_SRC_ALPHA, GL_ONE));
+
+    BOOST_REQUIRE (cache.depth_mask (GL_FALSE));
+    BOOST_REQUIRE (!cache.depth_mask (GL_FALSE));
+
+    BOOST_REQUIRE (cache.bind_buffer (GL_ARRAY_BUFFER, 3));
+    BOOST_REQUIRE (!cache.bind_buffer (GL_ARRAY_BUFFER, 3));
+    BOOST_REQUIRE (cache.bind_buffer (GL_ELEMENT_ARRAY_BUFFER, 3));
+
+    BOOST_REQUIRE (cache.use_program (7));
+    BOOST_REQUIRE (!cache.use_program (7));
+    BOOST_REQUIRE (cache.use_program (0));
+
+    state_cache::statistics const& stats (cache.stats());
+    BOOST_REQUIRE_EQUAL (stats.calls, 15);
+    BOOST_REQUIRE_EQUAL (stats.dropped(), 6);
+    BOOST_REQUIRE_EQUAL (stats.enable, 1);
+    BOOST_REQUIRE_EQUAL (stats.disable, 1);
+
+    cache.reset_statistics();
+    BOOST_REQUIRE_EQUAL (cache.stats().calls, 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (keeps_texture_state_per_unit)
+  {
+    state_cache cache;
+
+    // the unit isn't known yet, so nothing can be dropped
+    BOOST_REQUIRE (cache.enable (GL_TEXTURE_2D));
+    BOOST_REQUIRE (cache.enable (GL_TEXTURE_2D));
+    BOOST_REQUIRE (!cache.is_enabled (GL_TEXTURE_2D));
+
+    BOOST_REQUIRE (cache.active_texture (GL_TEXTURE0));
+    BOOST_REQUIRE (cache.enable (GL_TEXTURE_2D));
+    BOOST_REQUIRE (cache.bind_texture (GL_TEXTURE_2D, 1));
+    BOOST_REQUIRE (!cache.bind_texture (GL_TEXTURE_2D, 1));
+
+    BOOST_REQUIRE (cache.active_texture (GL_TEXTURE1));
+    BOOST_REQUIRE (!cache.active_texture (GL_TEXTURE1));
+    BOOST_REQUIRE (cache.enable (GL_TEXTURE_2D));
+    BOOST_REQUIRE (cache.bind_texture (GL_TEXTURE_2D, 1));
+    BOOST_REQUIRE (cache.disable (GL_TEXTURE_2D));
+
+    BOOST_REQUIRE (cache.active_texture (GL_TEXTURE0));
+    BOOST_REQUIRE (!cache.enable (GL_TEXTURE_2D));
+    BOOST_REQUIRE (*cache.is_enabled (GL_TEXTURE_2D));
+  }
+
+  BOOST_AUTO_TEST_CASE (answers_queries_for_known_state)
+  {
+    state_cache cache;
+
+    BOOST_REQUIRE (!cache.is_enabled (GL_DEPTH_TEST));
+    BOOST_REQUIRE (!cache.depth_mask());
+    BOOST_REQUIRE (!cache.buffer_binding (GL_ARRAY_BUFFER_BINDING));
+
+    cache.disable (GL_DEPTH_TEST);
+    cache.depth_mask (GL_TRUE);
+    cache.bind_buffer (GL_ARRAY_BUFFER, 5);
+
+    BOOST_REQUIRE (!*cache.is_enabled (GL_DEPTH_TEST));
+    BOOST_REQUIRE_EQUAL (*cache.depth_mask(), GL_TRUE);
+    BOOST_REQUIRE_EQUAL (*cache.buffer_binding (GL_ARRAY_BUFFER_BINDING), 5);
+    BOOST_REQUIRE (!cache.buffer_binding (GL_ELEMENT_ARRAY_BUFFER_BINDING));
+    BOOST_REQUIRE_EQUAL (cache.stats().queries, 3);
+  }
+
+  BOOST_AUTO_TEST_CASE (deleting_bound_objects_binds_zero)
+  {
+    state_cache cache;
+
+    GLuint const textures[] = {4, 5};
+    cache.active_texture (GL_TEXTURE0);
+    cache.bind_texture (GL_TEXTURE_2D, 5);
+    cache.delete_textures (2, textures);
+    BOOST_REQUIRE (!cache.bind_texture (GL_TEXTURE_2D, 0));
+    // the name may be reused by a new texture
+    BOOST_REQUIRE (cache.bind_texture (GL_TEXTURE_2D, 5));
+
+    GLuint const buffer (9);
+    cache.bind_buffer (GL_ARRAY_BUFFER, buffer);
+    cache.delete_buffers (1, &buffer);
+    BOOST_REQUIRE_EQUAL (*cache.buffer_binding (GL_ARRAY_BUFFER_BINDING), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (forgets_state_when_invalidated_or_recording)
+  {
+    state_cache cache;
+
+    cache.enable (GL_CULL_FACE);
+    cache.invalidate();
+    BOOST_REQUIRE (cache.enable (GL_CULL_FACE));
+
+    cache.start_recording();
+    BOOST_REQUIRE (cache.enable (GL_CULL_FACE));
+    BOOST_REQUIRE (!cache.is_enabled (GL_CULL_FACE));
+    cache.end_recording();
+
+    BOOST_REQUIRE (cache.enable (GL_CULL_FACE));
+    BOOST_REQUIRE (!cache.enable (GL_CULL_FACE));
+  }
+}